@@ -17,11 +17,142 @@ FMMTT = pyfmm.travel_time_source(
     srcloc,
     xarr, yarr, zarr, slw)
 
+# FMM解，使用桶队列
+FMMTT_bucket = pyfmm.travel_time_source(
+    srcloc,
+    xarr, yarr, zarr, slw, FMMqueue='bucket')
+
+# FMM解，使用d叉堆，两种堆在走时相等时都按节点索引决定先后，结果应与二叉堆完全相同
+FMMTT_dheap = pyfmm.travel_time_source(
+    srcloc,
+    xarr, yarr, zarr, slw, FMMqueue='dheap')
+
+# FMM解，多个线程共用multiqueue
+FMMTT_multi = pyfmm.travel_time_source(
+    srcloc,
+    xarr, yarr, zarr, slw, FMMqueue='multi')
+
+# FMM解，分组推进(Group Marching Method)
+FMMTT_group = pyfmm.travel_time_source(
+    srcloc,
+    xarr, yarr, zarr, slw, FMMqueue='group')
+
+# FMM解，区域分解并行，使用多个线程
+pyfmm.set_fsm_num_threads(4)
+FMMTT_dd = pyfmm.travel_time_source(
+    srcloc,
+    xarr, yarr, zarr, slw, FMMparallel=True)
+
+# 同一进程中先后计算小网格和大网格，分别使用32位整型和长整型版本的C库。
+# 临时调低阈值，使大网格不需要超过32位整型范围的内存即可切换到长整型版本
+INT32_MAX = pyfmm.c_interfaces.INT32_MAX
+pyfmm.c_interfaces.INT32_MAX = len(xarr)*len(yarr)*len(zarr) - 1
+FMMTT_small = pyfmm.travel_time_source(
+    srcloc,
+    xarr[::10], yarr[::10], zarr, slw[::10, ::10])
+small_use_long = pyfmm.c_interfaces.USE_LONG
+FMMTT_large = pyfmm.travel_time_source(
+    srcloc,
+    xarr, yarr, zarr, slw)
+large_use_long = pyfmm.c_interfaces.USE_LONG
+FMMTT_small2 = pyfmm.travel_time_source(
+    srcloc,
+    xarr[::10], yarr[::10], zarr, slw[::10, ::10])
+small2_use_long = pyfmm.c_interfaces.USE_LONG
+pyfmm.c_interfaces.INT32_MAX = INT32_MAX
+
+# FMM解，多个源点批量计算
+FMMTT_batch = pyfmm.travel_time_sources(
+    [srcloc, [60, 30, 0.0]],
+    xarr, yarr, zarr, slw)
+
+# FMM解，只计算到接收点
+rcvlocs = np.array([[12.3, 21.7, 0.0], [5.01, 17.44, 0.0], [30.0, 20.0, 0.0]])
+FMMTT_rcv = pyfmm.travel_time_receivers(
+    srcloc, rcvlocs,
+    xarr, yarr, zarr, slw)
+
+# FMM解，伴随状态法计算接收点走时之和对慢度场的梯度。
+# 走时是慢度的一次齐次函数，梯度与慢度的内积应等于走时之和
+rcvTT_adj, grad_adj = pyfmm.travel_time_gradient(
+    srcloc, rcvlocs,
+    xarr, yarr, zarr, slw)
+
+# 多个接收点批量射线追踪，结果应与逐个追踪相同
+ray_travt, ray_status, ray_offsets, rays = pyfmm.raytracing_batch(
+    FMMTT, srcloc, rcvlocs, xarr, yarr, zarr, 0.1, slw=slw)
+
+# FMM解，先计算到指定走时，再继续计算全局走时场
+FMMstate = pyfmm.travel_time_source_bounded(
+    srcloc, 15.0,
+    xarr, yarr, zarr, slw)
+FMMTT_bounded = FMMstate.TT.copy()
+FMMstate.resume()
+
+# FMM解，使用可重复使用的求解器
+solver = pyfmm.FMMSolver(xarr, yarr, zarr, slw)
+FMMTT_solver = solver.travel_time_source(srcloc)
+
 # FSM解
 FSMTT = pyfmm.travel_time_source(
     srcloc,
     xarr, yarr, zarr, slw, useFSM=True, FSMparallel=True)
 
+# FSM解，锁定扫描，结果应与普通扫描完全相同
+FSMTT_locking = pyfmm.travel_time_source(
+    srcloc,
+    xarr, yarr, zarr, slw, useFSM=True, FSMmaxLoops=2, FSMlocking=True)
+FSMTT_nolocking = pyfmm.travel_time_source(
+    srcloc,
+    xarr, yarr, zarr, slw, useFSM=True, FSMmaxLoops=2)
+
+# 非均匀模型，各阶差分，超平面和分块并行、锁定扫描的结果都应与串行FSM完全相同
+rng = np.random.default_rng(1)
+het_xarr, het_yarr, het_zarr = np.arange(41.0), np.arange(37.0), np.arange(33.0)
+het_slw = 0.5 + rng.random((41, 37, 33))
+het_srcloc = [3.31, 4.17, 5.23]
+het_FSMTT = {}
+for maxodr in (1, 2, 3):
+    for FSMparallel in (False, 'plane', 'tiles'):
+        for FSMlocking in (False, True):
+            het_FSMTT[maxodr, FSMparallel, FSMlocking] = pyfmm.travel_time_source(
+                het_srcloc, het_xarr, het_yarr, het_zarr, het_slw, maxodr=maxodr,
+                useFSM=True, FSMmaxLoops=2, FSMparallel=FSMparallel, FSMlocking=FSMlocking)
+
+# 非均匀模型，各维度节点数不是4的倍数，分块排布的FMM结果应与行优先排布完全相同
+het_FMMTT = pyfmm.travel_time_source(
+    het_srcloc, het_xarr, het_yarr, het_zarr, het_slw, maxodr=2)
+het_FMMTT_brick = pyfmm.travel_time_source(
+    het_srcloc, het_xarr, het_yarr, het_zarr, het_slw, maxodr=2, FMMbrick=True)
+
+# FSM解，同一超平面上的节点并行更新
+FSMTT_plane = pyfmm.travel_time_source(
+    srcloc,
+    xarr, yarr, zarr, slw, useFSM=True, FSMparallel='plane')
+
+# FSM解，按块并行扫描，结果应与超平面并行完全相同
+FSMTT_tiles = pyfmm.travel_time_source(
+    srcloc,
+    xarr, yarr, zarr, slw, useFSM=True, FSMparallel='tiles')
+
+# FMM解，局部改变慢度后增量更新，结果应与重新计算完全相同
+slw_upd = slw.copy()
+changed = np.zeros(slw.shape, dtype=bool)
+changed[500:560, 400:460] = True
+slw_upd[changed] = 0.6
+FMMTT_upd = pyfmm.travel_time_update(FMMTT, changed, xarr, yarr, zarr, slw_upd)
+FMMTT_resolve = pyfmm.travel_time_source(srcloc, xarr, yarr, zarr, slw_upd)
+
+# FIM解
+FIMTT = pyfmm.travel_time_source(
+    srcloc,
+    xarr, yarr, zarr, slw, method='fim')
+
+# 迎风差分模板得到的走时梯度场，模长应等于慢度；源点为接收点时，由互易性得到的出射方位角指向源点
+FMMgrad = pyfmm.get_traveltime_gradient(FMMTT, xarr, yarr, zarr)
+FSMgrad = pyfmm.get_traveltime_gradient(FSMTT, xarr, yarr, zarr)
+takeoff_az, takeoff_inc = pyfmm.get_takeoff_angles(FMMTT, rcvlocs, xarr, yarr, zarr, gradT=FMMgrad)
+
 # 真实解
 xx, yy, zz = srcloc
 real_TT = np.sqrt(((xarr-xx)**2)[:,None,None] + ((yarr-yy)**2)[None,:,None] + ((zarr-zz)**2)[None,None,:])
@@ -29,12 +160,88 @@ real_TT = np.sqrt(((xarr-xx)**2)[:,None,None] + ((yarr-yy)**2)[None,:,None] + ((
 # 误差 
 FMM_error = np.mean(np.abs(FMMTT - real_TT))
 FSM_error = np.mean(np.abs(FSMTT - real_TT))
+FMM_bucket_error = np.mean(np.abs(FMMTT_bucket - real_TT))
+FMM_multi_error = np.mean(np.abs(FMMTT_multi - real_TT))
+FSM_plane_error = np.mean(np.abs(FSMTT_plane - real_TT))
+FMM_group_error = np.mean(np.abs(FMMTT_group - real_TT))
+FIM_error = np.mean(np.abs(FIMTT - real_TT))
+FMM_dd_error = np.mean(np.abs(FMMTT_dd - real_TT))
+FMM_small_error = np.mean(np.abs(FMMTT_small - real_TT[::10, ::10]))
 print("FMM_error = ", FMM_error)
 print("FSM_error = ", FSM_error)
+print("FMM_bucket_error = ", FMM_bucket_error)
+print("FMM_multi_error = ", FMM_multi_error)
+print("FSM_plane_error = ", FSM_plane_error)
+print("FMM_group_error = ", FMM_group_error)
+print("FIM_error = ", FIM_error)
+print("FMM_dd_error = ", FMM_dd_error)
+print("FMM_small_error = ", FMM_small_error)
 
 tol = 0.1
 
 if FMM_error > tol:
     raise ValueError(f"FMM_error({FMM_error}) > tol({tol})")
 if FSM_error > tol:
-    raise ValueError(f"FMM_error({FSM_error}) > tol({tol})")
\ No newline at end of file
+    raise ValueError(f"FMM_error({FSM_error}) > tol({tol})")
+if FMM_bucket_error > tol:
+    raise ValueError(f"FMM_bucket_error({FMM_bucket_error}) > tol({tol})")
+if FMM_multi_error > tol:
+    raise ValueError(f"FMM_multi_error({FMM_multi_error}) > tol({tol})")
+if FSM_plane_error > tol:
+    raise ValueError(f"FSM_plane_error({FSM_plane_error}) > tol({tol})")
+if FMM_group_error > tol:
+    raise ValueError(f"FMM_group_error({FMM_group_error}) > tol({tol})")
+if FIM_error > tol:
+    raise ValueError(f"FIM_error({FIM_error}) > tol({tol})")
+if FMM_dd_error > tol:
+    raise ValueError(f"FMM_dd_error({FMM_dd_error}) > tol({tol})")
+if FMM_small_error > tol:
+    raise ValueError(f"FMM_small_error({FMM_small_error}) > tol({tol})")
+if not np.array_equal(FSMTT_locking, FSMTT_nolocking):
+    raise ValueError("FSM with locking differs from FSM without locking.")
+for (maxodr, FSMparallel, FSMlocking), het_TT in het_FSMTT.items():
+    if not np.array_equal(het_TT, het_FSMTT[maxodr, False, False]):
+        raise ValueError(f"FSM differs from sequential FSM on a heterogeneous model (maxodr={maxodr}, FSMparallel={FSMparallel}, FSMlocking={FSMlocking}).")
+if not np.array_equal(FSMTT_tiles, FSMTT_plane):
+    raise ValueError("FSM with tiles differs from FSM with hyperplanes.")
+if not np.array_equal(FMMTT_dheap, FMMTT):
+    raise ValueError("FMM with d-ary heap differs from FMM with binary heap.")
+if not np.array_equal(het_FMMTT_brick, het_FMMTT):
+    raise ValueError("FMM with brick layout differs from FMM with row-major layout.")
+group_rtol = 0.05
+group_rerr = np.max(np.abs(FMMTT_group - FMMTT)[FMMTT > 0] / FMMTT[FMMTT > 0])
+if group_rerr > group_rtol:
+    raise ValueError(f"Group marching differs from FMM by {group_rerr} > {group_rtol} (relative).")
+if small_use_long or not large_use_long or small2_use_long:
+    raise ValueError("C library integer version is not switched by grid size.")
+if not np.array_equal(FMMTT_large, FMMTT):
+    raise ValueError("FMM result with long integer library differs from 32-bit integer library.")
+if not np.array_equal(FMMTT_small, FMMTT_small2):
+    raise ValueError("FMM result on small grid changes after solving a large grid.")
+if not np.array_equal(FMMTT_batch[0], FMMTT):
+    raise ValueError("Batch FMM result differs from single-source FMM result.")
+if not np.array_equal(FMMTT_upd, FMMTT_resolve):
+    raise ValueError("Updated FMM result differs from recomputed FMM result.")
+if not np.array_equal(FMMTT_solver, FMMTT):
+    raise ValueError("FMMSolver result differs from single-source FMM result.")
+if not np.array_equal(FMMTT_bounded[FMMTT <= 15.0], FMMTT[FMMTT <= 15.0]):
+    raise ValueError("Bounded FMM result differs from full FMM result.")
+if not (FMMstate.finished and np.array_equal(FMMstate.TT, FMMTT)):
+    raise ValueError("Resumed FMM result differs from full FMM result.")
+if not np.allclose(rcvTT_adj, FMMTT_rcv, rtol=1e-10):
+    raise ValueError("Receiver traveltimes of the adjoint solver differ from the FMM result.")
+if not np.isclose(np.sum(grad_adj*slw), np.sum(rcvTT_adj), rtol=1e-6):
+    raise ValueError("Adjoint gradient is inconsistent with the receiver traveltimes.")
+for grad, name in zip((FMMgrad, FSMgrad), ('FMM', 'FSM')):
+    if not np.allclose(np.linalg.norm(grad, axis=-1)[real_TT > 0.5], slw[real_TT > 0.5], rtol=1e-6):
+        raise ValueError(f"Norm of the {name} traveltime gradient differs from the slowness.")
+takeoff_ref = np.rad2deg(np.arctan2(srcloc[1] - rcvlocs[:,1], srcloc[0] - rcvlocs[:,0])) % 360.0
+if not (np.allclose(takeoff_az, takeoff_ref, atol=0.5) and np.allclose(takeoff_inc, 90.0)):
+    raise ValueError(f"Takeoff angles {takeoff_az} differ from the source directions {takeoff_ref}.")
+for i, rcvloc in enumerate(rcvlocs):
+    travt, ray = pyfmm.raytracing(FMMTT, srcloc, rcvloc, xarr, yarr, zarr, 0.1, slw=slw)
+    if ray_status[i] != 0 or travt != ray_travt[i] or not np.array_equal(ray, rays[ray_offsets[i]:ray_offsets[i+1]]):
+        raise ValueError(f"Batch ray tracing result at {rcvloc} differs from single ray tracing.")
+for rcvloc, travt in zip(rcvlocs, FMMTT_rcv):
+    if not np.isclose(travt, pyfmm.get_traveltime(FMMTT, rcvloc, xarr, yarr, zarr), rtol=1e-10):
+        raise ValueError(f"Receiver traveltime at {rcvloc} differs from the full FMM result.")
\ No newline at end of file
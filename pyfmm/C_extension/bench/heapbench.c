@@ -0,0 +1,157 @@
+/**
+ * @file   heapbench.c
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ * 
+ *    比较二叉堆 (HeapPush/HeapPop) 与缓存行对齐的d叉堆 (DHeapPush/DHeapPop) 的性能。
+ * 
+ *    以 n*n*n 网格上的 Dijkstra 式波前传播模拟 Fast Marching 的堆操作序列：
+ *    每次弹出最小走时节点，再以 t0 + h*s 更新6个邻点，
+ *    波前（堆）大小约为 O(n^2)，与真实FMM的窄带规模一致。
+ *    慢度为随机值，使走时更新包含大量的 decrease-key 操作。
+ * 
+ *    用法： ./heapbench [n1 n2 ...]
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <sys/time.h>
+
+#include "const.h"
+#include "heapsort.h"
+#include "index.h"
+#include "mallocfree.h"
+
+#define FAR -1
+#define CLS 0
+#define ALV 1
+
+static double walltime(){
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec + t.tv_usec/1e6;
+}
+
+/**
+ * 运行一次波前传播，返回耗时，并记录最大堆大小和走时之和（用于校验）
+ * 
+ * @param   mode   0: 二叉堆;  1: d叉堆+NroIdx原位调整;  2: d叉堆+惰性删除
+ */
+static double run(MYINT n, const MYREAL *Slw, MYREAL *TT, char *stat, MYINT *NroIdx, int mode, 
+                  MYINT *pmaxsize, double *psum)
+{
+    static const int xr[6] = {-1, 1,  0, 0,  0, 0};
+    static const int xt[6] = { 0, 0, -1, 1,  0, 0};
+    static const int xp[6] = { 0, 0,  0, 0, -1, 1};
+    MYINT ntp = n*n, nrtp = n*ntp;
+
+    for(MYINT i=0; i<nrtp; ++i){
+        TT[i] = 9.9e30;
+        stat[i] = FAR;
+    }
+
+    MYINT size=0, cap=8;
+    HEAP_DATA *heap = (HEAP_DATA *)malloc1d(cap, sizeof(HEAP_DATA));
+    DARY_HEAP *dh = DHeap_create(cap);
+    MYINT *pos = (mode==2)? NULL : NroIdx;
+
+    MYINT src;
+    ravel_index(&src, ntp, n, n/3, n/2, n/2);
+    TT[src] = 0.0;
+    stat[src] = CLS;
+    if(mode==0) heap = HeapPush(heap, &size, &cap, src, pos, TT);
+    else        DHeapPush(dh, src, 0.0, pos);
+
+    MYINT maxsize = 0;
+    double t0 = walltime();
+    while((mode==0)? size > 0 : dh->size > 0){
+        MYINT idx0;
+        if(mode==0){
+            idx0 = HeapPop(heap, &size, pos, TT);
+        } else {
+            idx0 = DHeapPop(dh, NULL, pos);
+            if(stat[idx0]==ALV) continue;
+        }
+        stat[idx0] = ALV;
+
+        MYINT ir0, it0, ip0;
+        unravel_index(idx0, ntp, n, &ir0, &it0, &ip0);
+        for(int k=0; k<6; ++k){
+            MYINT ir=ir0+xr[k], it=it0+xt[k], ip=ip0+xp[k];
+            if(ir<0 || ir>n-1 || it<0 || it>n-1 || ip<0 || ip>n-1) continue;
+            MYINT idx;
+            ravel_index(&idx, ntp, n, ir, it, ip);
+            if(stat[idx]==ALV) continue;
+
+            MYREAL travt = TT[idx0] + 0.5*(Slw[idx] + Slw[idx0]);
+            if(travt >= TT[idx]) continue;
+            TT[idx] = travt;
+
+            if(stat[idx]==FAR){
+                stat[idx] = CLS;
+                if(mode==0) heap = HeapPush(heap, &size, &cap, idx, pos, TT);
+                else        DHeapPush(dh, idx, travt, pos);
+            } else {
+                if(mode==0)      MinHeap_AdjustUp(heap, pos[idx], pos, TT);
+                else if(mode==1) DHeap_DecreaseKey(dh, pos[idx], travt, pos);
+                else             DHeapPush(dh, idx, travt, NULL);
+            }
+        }
+        MYINT cursize = (mode==0)? size : dh->size;
+        if(maxsize < cursize) maxsize = cursize;
+    }
+    double t1 = walltime();
+
+    double sum = 0.0;
+    for(MYINT i=0; i<nrtp; ++i)  sum += TT[i];
+
+    free(heap);
+    DHeap_free(dh);
+    *pmaxsize = maxsize;
+    *psum = sum;
+    return t1 - t0;
+}
+
+
+int main(int argc, char **argv){
+    MYINT nlist[8] = {50, 100, 200, 300};
+    int nn = 4;
+    if(argc > 1){
+        nn = 0;
+        for(int i=1; i<argc && nn<8; ++i)  nlist[nn++] = atol(argv[i]);
+    }
+
+    const char *names[3] = {"binary heap (NroIdx)", "d-ary heap (NroIdx)", "d-ary heap (lazy)"};
+    printf("d-ary heap: D=%ld, sizeof(DHEAP_NODE)=%ld\n", (long)DHEAP_D, (long)sizeof(DHEAP_NODE));
+
+    for(int in=0; in<nn; ++in){
+        MYINT n = nlist[in];
+        MYINT nrtp = n*n*n;
+        MYREAL *Slw = (MYREAL *)malloc1d(nrtp, sizeof(MYREAL));
+        MYREAL *TT = (MYREAL *)malloc1d(nrtp, sizeof(MYREAL));
+        char *stat = (char *)malloc1d(nrtp, sizeof(char));
+        MYINT *NroIdx = (MYINT *)malloc1d(nrtp, sizeof(MYINT));
+        srand(42);
+        for(MYINT i=0; i<nrtp; ++i)  Slw[i] = 0.2 + 0.1*rand()/(double)RAND_MAX;
+
+        printf("\nn=%ld (%ld nodes)\n", (long)n, (long)nrtp);
+        double tref = 0.0;
+        for(int mode=0; mode<3; ++mode){
+            MYINT maxsize;
+            double sum;
+            double t = run(n, Slw, TT, stat, NroIdx, mode, &maxsize, &sum);
+            if(mode==0) tref = t;
+            printf("  %-22s  %8.3f s  speedup %5.2fx  max front %9ld  checksum %.6e\n", 
+                   names[mode], t, tref/t, (long)maxsize, sum);
+        }
+
+        free(Slw);
+        free(TT);
+        free(stat);
+        free(NroIdx);
+    }
+
+    return 0;
+}
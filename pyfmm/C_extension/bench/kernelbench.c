@@ -0,0 +1,112 @@
+/**
+ * @file   kernelbench.c
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+ *    比较通用的邻点走时更新函数 get_neighbour_travt_trial 与
+ *    按差分阶数特化的版本 (get_neighbour_travt_func) 的性能。
+ *
+ *    先用FMM计算 n*n*n 随机慢度网格的走时场，将所有节点置为alive，
+ *    再以各节点自身走时为 t0 对全部节点调用更新函数若干遍，
+ *    统计平均每次调用的耗时，并检查两者结果逐位相同。
+ *    最后给出使用特化版本后整个FMM求解的耗时。
+ *
+ *    用法： ./kernelbench [n1 n2 ...]
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "const.h"
+#include "fmm.h"
+#include "layout.h"
+#include "nodestat.h"
+#include "mallocfree.h"
+
+#define NREPEAT 5
+
+static double walltime(){
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec + t.tv_usec/1e6;
+}
+
+/**
+ * 对全部节点调用一遍更新函数 NREPEAT 次，返回耗时，结果写入out
+ */
+static double run(NEIGHBOUR_TRAVT_FUNC func, const GRID_LAYOUT *lay, MYINT maxodr,
+                  const MYREAL *Slw, const MYREAL *TT, const NODE_STAT *stat, double h, MYREAL *out)
+{
+    MYINT n = lay->nr;
+    double t0 = walltime();
+    for(int rep=0; rep<NREPEAT; ++rep){
+        MYINT idx = 0;
+        for(MYINT ir=0; ir<n; ++ir){
+        for(MYINT it=0; it<n; ++it){
+        for(MYINT ip=0; ip<n; ++ip){
+            out[idx] = func(lay, ir, it, ip, idx, maxodr, TT, stat, Slw[idx], h, h, h, TT[idx], NULL);
+            idx++;
+        }}}
+    }
+    return walltime() - t0;
+}
+
+
+int main(int argc, char **argv){
+    MYINT nlist[8] = {50, 100};
+    int nn = 2;
+    if(argc > 1){
+        nn = 0;
+        for(int i=1; i<argc && nn<8; ++i)  nlist[nn++] = atol(argv[i]);
+    }
+
+    for(int in=0; in<nn; ++in){
+        MYINT n = nlist[in];
+        MYINT nrtp = n*n*n;
+        double h = 1.0/(n-1);
+        double *xs = (double *)malloc1d(n, sizeof(double));
+        for(MYINT i=0; i<n; ++i)  xs[i] = i*h;
+
+        MYREAL *Slw = (MYREAL *)malloc1d(nrtp, sizeof(MYREAL));
+        MYREAL *TT = (MYREAL *)malloc1d(nrtp, sizeof(MYREAL));
+        MYREAL *out0 = (MYREAL *)malloc1d(nrtp, sizeof(MYREAL));
+        MYREAL *out1 = (MYREAL *)malloc1d(nrtp, sizeof(MYREAL));
+        srand(42);
+        for(MYINT i=0; i<nrtp; ++i)  Slw[i] = 0.2 + 0.1*rand()/(double)RAND_MAX;
+
+        GRID_LAYOUT lay;
+        grid_layout_init(&lay, n, n, n, false, 0);
+        NODE_STAT *stat = nodestat_alloc(nrtp);
+        nodestat_fill(stat, nrtp, FMM_ALV);
+
+        printf("\nn=%ld (%ld nodes, %d passes)\n", (long)n, (long)nrtp, NREPEAT);
+        for(MYINT maxodr=1; maxodr<=3; ++maxodr){
+            double t = walltime();
+            FastMarching(xs, n, xs, n, xs, n, xs[n/3], xs[n/2], xs[n/2], maxodr, Slw, TT, false,
+                         0, 0, false, FMM_QUEUE_HEAP, false, false, NULL, 0, NULL);
+            t = walltime() - t;
+
+            double tg = run(get_neighbour_travt_trial, &lay, maxodr, Slw, TT, stat, h, out0);
+            double ts = run(get_neighbour_travt_func(maxodr, false), &lay, maxodr, Slw, TT, stat, h, out1);
+            bool same = (memcmp(out0, out1, sizeof(MYREAL)*nrtp) == 0);
+
+            double ncall = (double)nrtp * NREPEAT;
+            printf("  maxodr=%ld  generic %7.2f ns/call  specialized %7.2f ns/call  speedup %5.2fx  %s  FMM %8.3f s\n",
+                   (long)maxodr, tg/ncall*1e9, ts/ncall*1e9, tg/ts, (same)? "identical" : "DIFFERENT", t);
+        }
+
+        grid_layout_free(&lay);
+        free(stat);
+        free(xs);
+        free(Slw);
+        free(TT);
+        free(out0);
+        free(out1);
+    }
+
+    return 0;
+}
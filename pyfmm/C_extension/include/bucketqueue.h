@@ -0,0 +1,87 @@
+/**
+ * @file   bucketqueue.h
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+ *       untidy 桶队列 (Yatziv et al., 2006)，作为二叉堆的替代。
+ *       按走时将节点量化到宽度为 width 的环形桶中，入队、出队均为 O(1) 均摊复杂度。
+ *       同一个桶内的节点按先进先出顺序弹出，不再严格按走时排序，
+ *       由此引入的走时误差不超过一个桶宽。
+ *
+ *       队列采用惰性删除：节点走时减小时直接重复入队，
+ *       弹出后由调用者根据节点状态跳过已确定的节点。
+ *
+*/
+
+#pragma once
+
+#include "const.h"
+#include "heapsort.h"
+
+
+/**
+ * 环形桶队列
+ */
+typedef struct {
+    MYINT nbkt;         ///< 桶个数
+    double width;       ///< 桶宽（走时）
+    double tbase;       ///< 当前桶的走时下界
+    MYINT cur;          ///< 当前桶在环中的索引
+    MYINT size;         ///< 队列中元素总数（包括重复入队的元素）
+    HEAP_DATA **data;   ///< 每个桶的元素数组
+    MYINT *bhead;       ///< 每个桶的队首位置
+    MYINT *bsize;       ///< 每个桶的队尾位置
+    MYINT *bcap;        ///< 每个桶的容量
+} BUCKET_QUEUE;
+
+
+/**
+ * 创建桶队列
+ *
+ * @param      width     (in)桶宽，即允许的最大乱序走时
+ * @param      tspan     (in)队列中走时的预计跨度，用于确定桶个数，不足时会自动扩充
+ * @param      tmin      (in)初始的走时下界
+ *
+ * @return     桶队列指针
+ */
+BUCKET_QUEUE * BucketQueue_create(double width, double tspan, double tmin);
+
+
+/**
+ * 释放桶队列
+ *
+ * @param      bq        (inout)桶队列指针
+ */
+void BucketQueue_free(BUCKET_QUEUE *bq);
+
+
+/**
+ * 计算某个走时在环中对应的桶索引，早于当前桶的走时归入当前桶
+ *
+ * @param      bq        (in)桶队列指针
+ * @param      travt     (in)走时
+ *
+ * @return     桶索引，若超出环的范围则返回-1
+ */
+MYINT BucketQueue_index(const BUCKET_QUEUE *bq, MYREAL travt);
+
+
+/**
+ * 压入元素，按元素对应的走时放入相应的桶
+ *
+ * @param      bq        (inout)桶队列指针
+ * @param      newdata   (in)新元素
+ * @param      TT        (in)一维指针，记录每个节点的走时
+ *
+ */
+void BucketPush(BUCKET_QUEUE *bq, HEAP_DATA newdata, const MYREAL *TT);
+
+
+/**
+ * 弹出当前最早的非空桶中的队首元素，调用前需保证 bq->size > 0
+ *
+ * @param      bq        (inout)桶队列指针
+ *
+ * @return     元素
+ */
+HEAP_DATA BucketPop(BUCKET_QUEUE *bq);
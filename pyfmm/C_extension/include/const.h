@@ -21,4 +21,15 @@ typedef float MYREAL;   ///< 单精度 or 双精度
 typedef double MYREAL;
 #endif
 
-typedef long int MYINT; ///< 长整型，以存储更大体积的网格量
\ No newline at end of file
+#ifdef USE_INT32
+typedef int MYINT;      ///< 32位整型，网格点数小于 2^31 时使用，减少堆和索引数组的内存与带宽
+#else
+typedef long int MYINT; ///< 长整型，以存储更大体积的网格量
+#endif
+
+// 在支持函数多版本的平台上同时生成AVX-512、AVX2和通用版本，加载时按CPU选择
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define SIMD_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define SIMD_CLONES
+#endif
@@ -3,10 +3,16 @@
  * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
  * @date   2023-03
  * 
+ *      差分函数在邻点走时计算中被频繁调用，定义为内联函数，
+ *      使其能在各差分阶数的特化版本中展开，见 fmm.h 中的 get_neighbour_travt_func 。
+ * 
 */
 
 #pragma once
 
+#include <stdio.h>
+#include <stdlib.h>
+
 #include "const.h"
 
 
@@ -19,7 +25,13 @@
  * @param    bcoef   (out)系数结果b
  * @param    diff    (out) \f$ aT-b \f$ 值
  */
-void get_diff_odr1(const MYREAL *pt, double h, double *acoef, double *bcoef, double *diff);
+inline void get_diff_odr1(const MYREAL *pt, double h, double *acoef, double *bcoef, double *diff){
+    MYREAL a = 1.0/h;
+    MYREAL b = pt[1]/h;
+    if(acoef!=NULL) *acoef = a;
+    if(bcoef!=NULL) *bcoef = b;
+    if(diff!=NULL)  *diff = a*pt[0] - b;
+}
 
 
 /**
@@ -31,7 +43,13 @@ void get_diff_odr1(const MYREAL *pt, double h, double *acoef, double *bcoef, dou
  * @param    bcoef   (out)系数结果b
  * @param    diff    (out) \f$ aT-b \f$ 值
  */
-void get_diff_odr2(const MYREAL *pt, double h, double *acoef, double *bcoef, double *diff);
+inline void get_diff_odr2(const MYREAL *pt, double h, double *acoef, double *bcoef, double *diff){
+    MYREAL a =  3.0/(2.0*h);
+    MYREAL b =  (4.0*pt[1] - pt[2])/(2.0*h);
+    if(acoef!=NULL) *acoef = a;
+    if(bcoef!=NULL) *bcoef = b;
+    if(diff!=NULL)  *diff = a*pt[0] - b;
+}
 
 
 /**
@@ -43,7 +61,13 @@ void get_diff_odr2(const MYREAL *pt, double h, double *acoef, double *bcoef, dou
  * @param    bcoef   (out)系数结果b
  * @param    diff    (out) \f$ aT-b \f$ 值
  */
-void get_diff_odr3(const MYREAL *pt, double h, double *acoef, double *bcoef, double *diff);
+inline void get_diff_odr3(const MYREAL *pt, double h, double *acoef, double *bcoef, double *diff){
+    MYREAL a =  11.0/(6.0*h);
+    MYREAL b =  (18.0*pt[1] - 9.0*pt[2] + 2.0*pt[3])/(6.0*h);
+    if(acoef!=NULL) *acoef = a;
+    if(bcoef!=NULL) *bcoef = b;
+    if(diff!=NULL)  *diff = a*pt[0] - b;
+}
 
 
 /**
@@ -56,4 +80,20 @@ void get_diff_odr3(const MYREAL *pt, double h, double *acoef, double *bcoef, dou
  * @param    bcoef   (out)系数结果b
  * @param    diff    (out) \f$ aT-b \f$ 值
  */
-void get_diff_odr123(MYINT odr, const MYREAL *pt, double h, double *acoef, double *bcoef, double *diff);
\ No newline at end of file
+inline void get_diff_odr123(MYINT odr, const MYREAL *pt, double h, double *acoef, double *bcoef, double *diff){
+    if(odr==0){
+        if(acoef!=NULL) *acoef = 0.0;
+        if(bcoef!=NULL) *bcoef = 0.0;
+        if(diff!=NULL)  *diff = 0.0;
+    }
+    else if(odr==1){
+        get_diff_odr1(pt, h, acoef, bcoef, diff);
+    } else if(odr==2){
+        get_diff_odr2(pt, h, acoef, bcoef, diff);
+    } else if(odr==3){
+        get_diff_odr3(pt, h, acoef, bcoef, diff);
+    } else {
+        fprintf(stderr, "WRONG DIFFERENCE ORDER (%d)\n", odr);
+        exit(EXIT_FAILURE);
+    }
+}
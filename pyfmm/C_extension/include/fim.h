@@ -0,0 +1,87 @@
+/**
+ * @file   fim.h
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+ *       Fast Iterative Method (Jeong and Whitaker, 2008)。
+ *
+ *       维护一个活动节点列表，每次迭代以Jacobi方式并行更新列表中的所有节点，
+ *       即所有节点都基于迭代开始时的走时场计算新走时，再一起写回。
+ *       走时减小量不超过eps的节点视为收敛，移出列表，并检查其邻点，
+ *       邻点走时能够减小时加入列表。列表为空时结束。
+ *
+ *       局部更新与FSM相同，先取6个邻点中的最小走时得到走时上限，再调用差分格式。
+ *       由于是Jacobi迭代，结果与线程数及列表中节点的顺序无关。
+ *       直接在调用者的走时、慢度和状态数组上计算，此外只需要两个节点索引列表、一个走时列表和每节点1比特的标记，
+ *       列表容量随活动节点数按倍数增长，至多为未收敛节点数的7倍。
+ *
+*/
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "const.h"
+#include "nodestat.h"
+
+
+/**
+ * 使用Fast Iterative Method计算全局走时场
+ *
+ * @param     rs     (in)维度1坐标数组
+ * @param     nr     (in)rs长度
+ * @param     ts     (in)维度2坐标数组
+ * @param     nt     (in)ts长度
+ * @param     ps     (in)维度2坐标数组
+ * @param     np     (in)ps长度
+ * @param     rr     (in)源点维度1坐标
+ * @param     tt     (in)源点维度2坐标
+ * @param     pp     (in)源点维度3坐标
+ * @param     maxodr (in)使用的最大差分阶数
+ * @param     Slw    (in)展平的三维慢度场
+ * @param     TT     (inout)展平的三维走时场，非零值视为已知走时，全为零时在源点附近初始化
+ * @param     sphcoord  (in)是否使用球坐标
+ * @param     rfgfac    (in)对源点附近区域的加密倍数
+ * @param     rfgn      (in)对源点附近区域的加密网格数
+ * @param     printbar  (in)是否打印运行时间
+ * @param     eps       (in)走时减小量不超过该值的节点视为收敛
+ *
+ * @return    迭代次数
+ */
+MYINT FastIterative(
+    const double *rs, MYINT nr,
+    const double *ts, MYINT nt,
+    const double *ps, MYINT np,
+    double rr,  double tt, double pp,
+    MYINT maxodr,  const MYREAL *Slw,
+    MYREAL *TT, bool sphcoord,
+    MYINT rfgfac, MYINT rfgn, bool printbar, double eps);
+
+
+
+/**
+ * 在源点附近初始化完成后，使用Fast Iterative Method计算全局走时场
+ *
+ * @param     rs     (in)维度1坐标数组
+ * @param     nr     (in)rs长度
+ * @param     ts     (in)维度2坐标数组
+ * @param     nt     (in)ts长度
+ * @param     ps     (in)维度2坐标数组
+ * @param     np     (in)ps长度
+ * @param     maxodr (in)使用的最大差分阶数
+ * @param     Slw    (in)展平的三维慢度场
+ * @param     TT     (inout)展平的三维走时场，未计算的节点为9.9e30
+ * @param     FMM_stat  (inout)每个节点的状态，非far的节点构成初始活动列表，
+ *                      结束时到达的节点为alive，其余为far
+ * @param     sphcoord  (in)是否使用球坐标
+ * @param     printbar  (in)是否打印迭代次数
+ * @param     eps       (in)走时减小量不超过该值的节点视为收敛
+ *
+ * @return    迭代次数
+ */
+MYINT FastIterative_with_initial(
+    const double *rs, MYINT nr,
+    const double *ts, MYINT nt,
+    const double *ps, MYINT np,
+    MYINT maxodr,  const MYREAL *Slw, MYREAL *TT,
+    NODE_STAT *FMM_stat, bool sphcoord, bool printbar, double eps);
@@ -9,13 +9,27 @@
 
 #include "const.h"
 #include "heapsort.h"
+#include "layout.h"
+#include "nodestat.h"
 
 #define _PRINT_ODR_BUG_ 0
 
-#define FMM_FAR -1   ///< 波前还未触及的区域
-#define FMM_CLS 0    ///< 波前面
-#define FMM_ALV 1    ///< 波前已完全扫过的区域，走时已确定
+#define FMM_QUEUE_HEAP   0   ///< 使用二叉最小堆管理波前，严格按走时顺序确定节点
+#define FMM_QUEUE_BUCKET 1   ///< 使用untidy桶队列管理波前，节点确定顺序的乱序不超过一个桶宽，详见 bucketqueue.h
+#define FMM_QUEUE_DHEAP  2   ///< 使用按缓存行对齐的d叉堆管理波前，走时与节点索引连续存放，采用惰性删除，详见 heapsort.h
+#define FMM_QUEUE_MULTI  3   ///< 多个线程共用多个带锁的d叉堆(multiqueue)，节点近似按走时顺序确定，乱序由重新入堆修正，详见 fmmmq.h 。
+                             ///< 结果与串行FMM不逐位一致，二阶以上差分时最大相对差别约1e-2，强非均匀介质中可达3e-2
+#define FMM_QUEUE_GROUP  4   ///< 不使用堆，每步将走时相近的一组波前节点同时确定，组内并行更新(Group Marching Method)，详见 fmmgm.h 。
+                             ///< 测试(uniform.py)要求均匀介质中与 FMM_QUEUE_HEAP 的最大相对差别不超过0.05(实际约1e-4)；
+                             ///< 非均匀介质中源点附近的相对差别较大，二阶差分时可达0.07，三阶差分且慢度反差很大时可达0.1
 
+#define FMM_REOPEN_RTOL  1e-6   ///< 重新打开已确定节点所需的最小相对走时减小量，避免舍入误差导致反复入堆
+#define FMM_GHOST_LAYERS 1      ///< 工作空间内部排布四周的幽灵层数。差分模板遇到第一个幽灵节点即停止，一层即可
+
+#define FMM_RAY_OK        0   ///< 射线追踪到源点附近
+#define FMM_RAY_TRUNCATED 1   ///< 射线点数达到上限，截断后直接连接源点
+#define FMM_RAY_OUTSIDE   2   ///< 接收点在网格外，射线为空
+#define FMM_RAY_UNREACHED 3   ///< 接收点处走时未计算(9.9e30)，射线为空
 
 
 /**
@@ -37,6 +51,21 @@
  * @param     rfgfac    (in)对于源点附近的格点间加密倍数，>1
  * @param     rfgn      (in)对于源点附近的格点间加密处理的辐射半径，>=1
  * @param     printbar  (in)是否打印进度条
+ * @param     fmmqueue  (in)波前优先队列类型，FMM_QUEUE_HEAP, FMM_QUEUE_BUCKET, FMM_QUEUE_DHEAP, FMM_QUEUE_MULTI 或 FMM_QUEUE_GROUP 。
+ *                      使用 FMM_QUEUE_MULTI 或 FMM_QUEUE_GROUP 时源点附近初始化后并行计算，线程数为OpenMP当前设置的线程数
+ * @param     bricklayout  (in)是否在内部使用 4x4x4 分块排布的慢度、走时和状态数组，详见 layout.h 。
+ *                         为false且不使用 FMM_QUEUE_GROUP 时直接在Slw和TT上计算，除每节点2比特的状态数组、
+ *                         堆及二叉堆的位置索引外不需要额外内存；否则内部数组带有 FMM_GHOST_LAYERS 层幽灵节点，
+ *                         源点附近初始化后转换数组，结束时再转回，需要额外一份慢度、走时和状态数组，
+ *                         单精度时每节点约多8.25字节(双精度约16.25字节)
+ * @param     isparallel   (in)源点附近初始化后是否使用区域分解的并行FMM，详见 fmmdd.h 。
+ *                         此时固定使用二叉堆和行优先排布，忽略fmmqueue和bricklayout；网格太小或只有一个线程时仍为串行
+ * @param     rcvs      (in)形状为(nrcv, 3)的接收点坐标数组，为NULL时计算全局走时场。
+ *                      非NULL时，各接收点三次线性插值所需的8个节点均确定后即结束计算，
+ *                      此时TT中未确定节点的走时无意义(未到达的节点为9.9e30)。
+ *                      并行计算(isparallel、 FMM_QUEUE_MULTI 或 FMM_QUEUE_GROUP )时已确定的节点可能被修正，不提前结束，仍计算全局走时场
+ * @param     nrcv      (in)接收点个数
+ * @param     rcvTT     (out)长度为nrcv的接收点走时，rcvs为NULL时不使用
  * 
  * 
  */
@@ -47,7 +76,184 @@ void FastMarching(
     double rr,  double tt, double pp,
     MYINT maxodr,  const MYREAL *Slw, 
     MYREAL *TT, bool sphcoord, 
-    MYINT rfgfac, MYINT rfgn, bool printbar);
+    MYINT rfgfac, MYINT rfgn, bool printbar, MYINT fmmqueue, bool bricklayout, bool isparallel,
+    const double *rcvs, MYINT nrcv, MYREAL *rcvTT);
+
+
+/**
+ * 多个源点的批量计算，每个源点的计算过程同 FastMarching 。
+ * 源点之间使用OpenMP动态调度并行计算，每个线程的状态数组、堆等内存在其分到的源点间重复使用。
+ * 
+ * @param     rs     (in)维度1坐标数组
+ * @param     nr     (in)rs长度
+ * @param     ts     (in)维度2坐标数组
+ * @param     nt     (in)ts长度
+ * @param     ps     (in)维度2坐标数组
+ * @param     np     (in)ps长度
+ * @param     srcs   (in)形状为(nsrc, 3)的源点坐标数组，为NULL时要求每个走时场都有非零初始值
+ * @param     nsrc   (in)源点个数
+ * @param     maxodr (in)使用的最大差分阶数
+ * @param     Slw    (in)展平的三维慢度场，各源点共用
+ * @param     TTs    (inout)nsrc个依次存放的展平三维走时场，每个走时场的初始值含义同 FastMarching
+ * @param     sphcoord  (in)是否使用球坐标
+ * @param     rfgfac    (in)对于源点附近的格点间加密倍数，>1
+ * @param     rfgn      (in)对于源点附近的格点间加密处理的辐射半径，>=1
+ * @param     printbar  (in)是否打印进度条，按完成的源点个数计
+ * @param     fmmqueue  (in)波前优先队列类型，FMM_QUEUE_HEAP, FMM_QUEUE_BUCKET 或 FMM_QUEUE_DHEAP ，
+ *                      源点间已经并行， FMM_QUEUE_MULTI 和 FMM_QUEUE_GROUP 按 FMM_QUEUE_DHEAP 处理
+ * @param     bricklayout  (in)是否在内部使用 4x4x4 分块排布的数组
+ * @param     nthreads  (in)线程数，<=0时使用OpenMP当前设置的线程数
+ * 
+ */
+void FastMarching_batch(
+    const double *rs, MYINT nr, 
+    const double *ts, MYINT nt, 
+    const double *ps, MYINT np,
+    const double *srcs, MYINT nsrc,
+    MYINT maxodr,  const MYREAL *Slw, 
+    MYREAL *TTs, bool sphcoord, 
+    MYINT rfgfac, MYINT rfgn, bool printbar, MYINT fmmqueue, bool bricklayout,
+    MYINT nthreads);
+
+
+/**
+ * FastMarching 计算一个走时场所需的内存，多次计算时可重复使用
+ */
+typedef struct {
+    MYINT fmmqueue;            ///< 波前优先队列类型
+    bool bricklayout;          ///< 是否分块排布
+    bool inplace;              ///< 是否直接在调用者的行优先慢度场和走时场上计算，见 fmm_workspace_inplace
+    GRID_LAYOUT lay;           ///< 网格排布，inplace时为不带幽灵层的行优先排布
+    NODE_STAT *FMM_stat;       ///< 行优先排布的状态数组，用于源点附近初始化，inplace时也用于之后的计算
+    NODE_STAT *FMM_stat_lay;   ///< 内部排布（带幽灵层，可分块）的状态数组，inplace时为NULL
+    MYREAL *TT_lay;            ///< 内部排布的走时场，inplace时为NULL
+    HEAP_DATA *FMM_data;       ///< 堆，计算中可能扩容
+    MYINT heapcap;             ///< 堆的容量
+    MYINT *NroIdx;             ///< 节点在堆中的位置，仅使用二叉堆时分配
+    MYINT heapsize;            ///< 堆中的节点数，即计算结束时波前面的节点数
+    MYINT Ndots;               ///< 未计算的节点数
+    MYINT *order;              ///< 非NULL时记录节点的确定顺序（内部排布的索引），由调用者分配，不随工作空间释放
+    MYINT norder;              ///< order中已记录的节点数
+} FMM_WORKSPACE;
+
+
+/**
+ * 工作空间能否直接在调用者的行优先数组上计算。分块排布需要转换数组，
+ * 分组推进(FMM_QUEUE_GROUP)依赖幽灵层省去索引检查，这两种情况下使用带幽灵层的内部数组
+ * 
+ * @param     fmmqueue  (in)波前优先队列类型
+ * @param     bricklayout  (in)是否分块排布
+ * 
+ * @return    是否可以直接计算
+ */
+bool fmm_workspace_inplace(MYINT fmmqueue, bool bricklayout);
+
+
+/**
+ * 申请工作空间
+ * 
+ * @param     ws        (out)工作空间
+ * @param     nr        (in)维度1长度
+ * @param     nt        (in)维度2长度
+ * @param     np        (in)维度3长度
+ * @param     fmmqueue  (in)波前优先队列类型
+ * @param     bricklayout  (in)是否分块排布
+ * @param     inplace   (in)是否尽量直接在调用者的数组上计算，见 fmm_workspace_inplace 。
+ *                      计算结束后仍需使用内部走时场和状态数组时(如保留计算状态)应为false
+ */
+void fmm_workspace_init(FMM_WORKSPACE *ws, MYINT nr, MYINT nt, MYINT np, MYINT fmmqueue, bool bricklayout, bool inplace);
+
+
+/**
+ * 释放工作空间
+ * 
+ * @param     ws        (inout)工作空间
+ */
+void fmm_workspace_free(FMM_WORKSPACE *ws);
+
+
+/**
+ * 使用工作空间中的数组计算一个全局走时场，其余参数见 FastMarching 。
+ * 
+ * @param     ws       (inout)工作空间
+ * @param     Slw_lay  (in)按工作空间的排布(ws->lay)转换后的慢度场，ws->inplace时即为Slw
+ * @param     isparallel  (in)初始化后是否使用区域分解的并行FMM，此时直接使用行优先排布的Slw和TT
+ * @param     tstop    (in)>0时只确定走时不超过tstop的节点，波前留在工作空间中，见 FastMarching_with_initial
+ * @param     rcvs     (in)形状为(nrcv, 3)的接收点坐标数组，非NULL时在接收点插值所需的节点均确定后提前结束
+ * @param     nrcv     (in)接收点个数
+ * @param     rcvTT    (out)接收点走时，rcvs为NULL时不使用
+ * @param     useseeds (in)是否将TT中的非零值作为初始走时。为false时不检查TT，直接使用源点
+ */
+void FastMarching_ws(
+    FMM_WORKSPACE *ws,
+    const double *rs, MYINT nr, 
+    const double *ts, MYINT nt, 
+    const double *ps, MYINT np,
+    double rr,  double tt, double pp,
+    MYINT maxodr,  const MYREAL *Slw, const MYREAL *Slw_lay,
+    MYREAL *TT, bool sphcoord, 
+    MYINT rfgfac, MYINT rfgn, bool printbar, bool isparallel, double tstop,
+    const double *rcvs, MYINT nrcv, MYREAL *rcvTT, bool useseeds);
+
+
+/**
+ * 限定最大走时的FMM计算状态，可继续计算到更大的走时。
+ * 保留网格坐标、慢度场、走时场、节点状态和堆，由 FastMarching_bounded 创建，
+ * FastMarching_resume 继续计算，FastMarching_state_free 释放
+ */
+typedef struct {
+    FMM_WORKSPACE ws;          ///< 工作空间，含状态数组和堆
+    MYINT nr, nt, np;          ///< 各维度网格点数
+    double *rs, *ts, *ps;      ///< 各维度坐标数组
+    MYINT maxodr;              ///< 使用的最大差分阶数
+    bool sphcoord;             ///< 是否使用球坐标
+    MYREAL *Slw_lay;           ///< 按工作空间排布的慢度场，走时场保留在 ws.TT_lay 中
+} FMM_STATE;
+
+
+/**
+ * 使用Fast Marching Method计算走时不超过tmax的节点，返回计算状态，之后可调用 FastMarching_resume 继续计算。
+ * 参数含义同 FastMarching ，不支持区域分解的并行FMM， FMM_QUEUE_MULTI 和 FMM_QUEUE_GROUP 按 FMM_QUEUE_DHEAP 处理
+ * 
+ * @param     TT        (inout)展平的三维走时场，初始值含义同 FastMarching 。
+ *                      结束时已确定节点为最终走时，波前面节点为临时走时，未到达的节点为9.9e30
+ * @param     tmax      (in)最大走时，<=0时计算全局走时场
+ * @param     pnfront   (out)结束时波前面的节点数，为0时表示全局走时场已计算完成
+ * 
+ * @return    计算状态，需使用 FastMarching_state_free 释放
+ */
+FMM_STATE * FastMarching_bounded(
+    const double *rs, MYINT nr, 
+    const double *ts, MYINT nt, 
+    const double *ps, MYINT np,
+    double rr,  double tt, double pp,
+    MYINT maxodr,  const MYREAL *Slw, 
+    MYREAL *TT, bool sphcoord, 
+    MYINT rfgfac, MYINT rfgn, bool printbar, MYINT fmmqueue, bool bricklayout,
+    double tmax, MYINT *pnfront);
+
+
+/**
+ * 从上次结束的波前继续计算到更大的走时。使用二叉堆或d叉堆时结果与一次计算到该走时相同，
+ * 使用桶队列时重新分桶，节点确定的乱序与一次计算不同，差别在桶宽引入的误差范围内
+ * 
+ * @param     st        (inout)计算状态
+ * @param     tmax      (in)最大走时，<=0时计算全局走时场
+ * @param     TT        (out)行优先排布的展平三维走时场，含义同 FastMarching_bounded
+ * @param     printbar  (in)是否打印进度条
+ * 
+ * @return    结束时波前面的节点数，为0时表示全局走时场已计算完成
+ */
+MYINT FastMarching_resume(FMM_STATE *st, double tmax, MYREAL *TT, bool printbar);
+
+
+/**
+ * 释放计算状态
+ * 
+ * @param     st        (inout)计算状态
+ */
+void FastMarching_state_free(FMM_STATE *st);
+
 
 
 /**
@@ -62,15 +268,30 @@ void FastMarching(
  * @param     maxodr (in)使用的最大差分阶数
  * @param     Slw    (in)展平的三维慢度场
  * @param     TT     (inout)展平的三维走时场
- * @param     FMM_stat  (out)记录每个节点的状态(alive, close, far)
+ * @param     FMM_stat  (out)记录每个节点的状态(alive, close, far)，紧凑存储，详见 nodestat.h
  * @param     sphcoord  (in)是否使用球坐标
  * @param     edgeStop  (in)是否在波前传播到6个边界面时提前结束计算
  * @param     printbar  (in)是否打印进度条
  * @param     FMM_data  (inout)堆首指针
  * @param     psize     (inout)堆大小，会被调整大小
  * @param     pcap      (inout)堆最大容量，视情况会被调整大小
- * @param     NroIdx    (out)一维指针，用于在节点索引位置处填上堆中的索引值
+ * @param     NroIdx    (out)一维指针，用于在节点索引位置处填上堆中的索引值，
+ *                      使用桶队列或d叉堆时不需要，可为NULL
  * @param     pNdots    (inout)记录还剩下多少节点的走时未计算
+ * @param     fmmqueue  (in)波前优先队列类型。使用桶队列或d叉堆时，堆中已有的节点会先移入其中，
+ *                      结束时未确定的节点再移回堆中
+ * @param     lay       (in)慢度、走时、状态数组以及堆中节点索引的排布方式，NULL表示行优先排布
+ *                      有幽灵层时，幽灵节点须为走时9.9e30的alive节点
+ * @param     tstop     (in)>0时只确定走时不超过tstop的节点，其余节点留在堆中，可再次调用继续计算；<=0时不限制。
+ *                      使用桶队列时在起始走时超过tstop的桶处结束，确定的节点可能超过tstop不到一个桶宽
+ * @param     reopen    (in)是否允许重新打开已确定的节点，用于部分节点走时偏大、之后才得到修正的情况(如子区域间交换边界走时)。
+ *                      状态为 FMM_RCL 的节点弹出后，若算得已确定邻点的走时明显更小(相对差超过 FMM_REOPEN_RTOL)，
+ *                      将其改回波前面并入堆；被其更新的邻点也标记为 FMM_RCL ，修正由此继续传播，且不强制因果性。
+ *                      其余节点的计算与不允许重新打开时相同
+ * @param     stopmask  (in)非NULL时，标记的节点均确定后提前结束，其余节点留在堆中，可再次调用继续计算
+ * @param     pNstop    (inout)标记的节点中未确定的节点数，每确定一个标记节点减1，stopmask为NULL时不使用
+ * @param     order     (out)非NULL时按确定的先后记录节点索引，长度至少为lay->size，用于伴随状态法反向求解
+ * @param     pnorder   (inout)order中已记录的节点数，order为NULL时不使用
  * 
  */
 HEAP_DATA * FastMarching_with_initial(
@@ -78,8 +299,10 @@ HEAP_DATA * FastMarching_with_initial(
     const double *ts, MYINT nt, 
     const double *ps, MYINT np,
     MYINT maxodr,  const MYREAL *Slw, MYREAL *TT, 
-    char *FMM_stat, bool sphcoord, bool *edgeStop, bool printbar,
-    HEAP_DATA *FMM_data, MYINT *psize, MYINT *pcap, MYINT *NroIdx, MYINT *pNdots);
+    NODE_STAT *FMM_stat, bool sphcoord, bool *edgeStop, bool printbar,
+    HEAP_DATA *FMM_data, MYINT *psize, MYINT *pcap, MYINT *NroIdx, MYINT *pNdots,
+    MYINT fmmqueue, const GRID_LAYOUT *lay, double tstop, bool reopen,
+    const NODE_MASK *stopmask, MYINT *pNstop, MYINT *order, MYINT *pnorder);
 
 
 
@@ -97,7 +320,7 @@ HEAP_DATA * FastMarching_with_initial(
  * @param     pp     (in)源点维度3坐标
  * @param     Slw    (in)展平的三维慢度场
  * @param     TT     (inout)展平的三维走时场
- * @param     FMM_stat  (out)记录每个节点的状态(alive, close, far)
+ * @param     FMM_stat  (out)记录每个节点的状态(alive, close, far)，紧凑存储，详见 nodestat.h
  * @param     sphcoord  (in)是否使用球坐标
  * @param     FMM_data  (inout)堆首指针
  * @param     psize     (inout)堆大小，会被调整大小
@@ -114,7 +337,7 @@ HEAP_DATA * init_source_TT(
     const double *ps, MYINT np,
     double rr, double tt, double pp,
     const MYREAL *Slw, MYREAL *TT, 
-    char *FMM_stat, bool sphcoord,
+    NODE_STAT *FMM_stat, bool sphcoord,
     HEAP_DATA *FMM_data, MYINT *psize, MYINT *pcap, MYINT *NroIdx, MYINT *pNdots);
 
 
@@ -134,7 +357,7 @@ HEAP_DATA * init_source_TT(
  * @param     maxodr (in)使用的最大差分阶数
  * @param     Slw    (in)展平的三维慢度场
  * @param     TT     (inout)展平的三维走时场
- * @param     FMM_stat  (out)记录每个节点的状态(alive, close, far)
+ * @param     FMM_stat  (out)记录每个节点的状态(alive, close, far)，紧凑存储，详见 nodestat.h
  * @param     sphcoord  (in)是否使用球坐标
  * @param     rfgfac    (in)对于源点附近的格点间加密倍数，>1
  * @param     rfgn      (in)对于源点附近的格点间加密处理的辐射半径，>=1
@@ -144,6 +367,7 @@ HEAP_DATA * init_source_TT(
  * @param     pcap      (inout)堆最大容量，视情况会被调整大小
  * @param     NroIdx    (out)一维指针，用于在节点索引位置处填上堆中的索引值
  * @param     pNdots    (inout)记录还剩下多少节点的走时未计算
+ * @param     fmmqueue  (in)加密网格中计算走时使用的波前优先队列类型
  * 
  * @return    堆首指针
  */
@@ -153,27 +377,25 @@ HEAP_DATA * init_source_TT_refinegrid(
     const double *ps, MYINT np,
     double rr, double tt, double pp, 
     MYINT maxodr,  const MYREAL *Slw, MYREAL *TT, 
-    char *FMM_stat, bool sphcoord,
+    NODE_STAT *FMM_stat, bool sphcoord,
     MYINT rfgfac, MYINT rfgn, // refine grid factor and number of grids
     bool printbar,
-    HEAP_DATA *FMM_data, MYINT *psize, MYINT *pcap, MYINT *NroIdx, MYINT *pNdots);
+    HEAP_DATA *FMM_data, MYINT *psize, MYINT *pcap, MYINT *NroIdx, MYINT *pNdots,
+    MYINT fmmqueue);
 
 
 
 /**
  * 依据邻近的节点走时，以解一元二次方程的形式求解某点的走时
  * 
- * @param      nr      (in)维度1长度
- * @param      nt      (in)维度2长度
- * @param      np      (in)维度3长度
- * @param      ntp     (in)nt*np
+ * @param      lay     (in)网格排布
  * @param      ir      (in)某点的维度1索引
  * @param      it      (in)某点的维度2索引
  * @param      ip      (in)某点的维度3索引
  * @param      idx     (in)某点的三维展开索引
  * @param      maxodr  (in)使用的最大差分阶数
  * @param      TT      (inout)展平的三维走时场
- * @param      FMM_stat  (out)记录每个节点的状态(alive, close, far)
+ * @param      FMM_stat  (in)记录每个节点的状态(alive, close, far)，紧凑存储，详见 nodestat.h
  * @param      s         (in)某点的慢度
  * @param      dr        (in)维度1坐标间隔
  * @param      dt        (in)维度2坐标间隔
@@ -184,14 +406,118 @@ HEAP_DATA * init_source_TT_refinegrid(
  * 
  */
 MYREAL get_neighbour_travt(
-    MYINT nr, MYINT nt, MYINT np, MYINT ntp,
+    const GRID_LAYOUT *lay,
     MYINT ir, MYINT it, MYINT ip, MYINT idx,
     MYINT maxodr, MYREAL *TT,
-    char *FMM_stat,  double s,
+    const NODE_STAT *FMM_stat,  double s,
     double dr, double dt, double dp, 
     char *stat);
 
 
+/**
+ * 同 get_neighbour_travt ，但不读写某点自身的走时，而是以试探走时t0代替，
+ * 只使用走时小于t0的邻点。可用于多个线程同时更新同一走时场
+ * 
+ * @param      t0      (in)某点的试探走时
+ * 
+ * 其余参数见 get_neighbour_travt
+ * 
+ * @return     走时结果
+ */
+MYREAL get_neighbour_travt_trial(
+    const GRID_LAYOUT *lay,
+    MYINT ir, MYINT it, MYINT ip, MYINT idx,
+    MYINT maxodr, const MYREAL *TT,
+    const NODE_STAT *FMM_stat,  double s,
+    double dr, double dt, double dp, 
+    MYREAL t0, char *stat);
+
+
+/**
+ * get_neighbour_travt_trial 的函数类型
+ */
+typedef MYREAL (*NEIGHBOUR_TRAVT_FUNC)(
+    const GRID_LAYOUT *lay,
+    MYINT ir, MYINT it, MYINT ip, MYINT idx,
+    MYINT maxodr, const MYREAL *TT,
+    const NODE_STAT *FMM_stat,  double s,
+    double dr, double dt, double dp,
+    MYREAL t0, char *stat);
+
+
+/**
+ * 返回差分阶数固定为maxodr的 get_neighbour_travt_trial 特化版本，每次计算开始时选择一次。
+ * 特化版本中各方向的循环次数为常量，差分函数完全展开，没有阶数判断；
+ * 结果与 get_neighbour_travt_trial 相同。maxodr不为1、2、3时返回 get_neighbour_travt_trial
+ * 
+ * @param      maxodr    (in)使用的最大差分阶数
+ * @param      padded    (in)网格是否有幽灵层（见 layout.h ）。为真时返回的版本不检查索引范围，
+ *                           要求幽灵节点不是alive，或其走时不小于试探走时t0
+ * 
+ * @return     函数指针
+ */
+NEIGHBOUR_TRAVT_FUNC get_neighbour_travt_func(MYINT maxodr, bool padded);
+
+
+/**
+ * 只收集差分模板，不求解。get_neighbour_travt_trial 的前半部分，
+ * 得到走时二次方程 A*T^2 - B*T + C = 0 的系数，与 solve_travt_batch 配合，
+ * 先收集多个节点的系数再一起求解
+ *
+ * @param      pA        (out)二次项系数
+ * @param      pB        (out)一次项系数（取负）
+ * @param      pC        (out)常数项
+ *
+ * 其余参数同 get_neighbour_travt_trial
+ */
+void get_neighbour_travt_coef(
+    const GRID_LAYOUT *lay,
+    MYINT ir, MYINT it, MYINT ip, MYINT idx,
+    MYINT maxodr, const MYREAL *TT,
+    const NODE_STAT *FMM_stat,  double s,
+    double dr, double dt, double dp,
+    MYREAL t0, double *pA, double *pB, double *pC);
+
+
+/**
+ * get_neighbour_travt_coef 的函数类型
+ */
+typedef void (*NEIGHBOUR_COEF_FUNC)(
+    const GRID_LAYOUT *lay,
+    MYINT ir, MYINT it, MYINT ip, MYINT idx,
+    MYINT maxodr, const MYREAL *TT,
+    const NODE_STAT *FMM_stat,  double s,
+    double dr, double dt, double dp,
+    MYREAL t0, double *pA, double *pB, double *pC);
+
+
+/**
+ * 返回差分阶数固定为maxodr的 get_neighbour_travt_coef 特化版本，同 get_neighbour_travt_func
+ *
+ * @param      maxodr    (in)使用的最大差分阶数
+ * @param      padded    (in)网格是否有幽灵层
+ *
+ * @return     函数指针
+ */
+NEIGHBOUR_COEF_FUNC get_neighbour_coef_func(MYINT maxodr, bool padded);
+
+
+/**
+ * 同时求解n个走时二次方程。循环体没有分支，可以向量化，在x86-64 Linux上
+ * 另外生成AVX2和AVX-512版本，运行时按CPU选择。结果与 get_neighbour_travt_trial 逐位相同，
+ * 系数退化（求解失败）时为-1
+ *
+ * @param      n         (in)方程个数
+ * @param      Acoef     (in)二次项系数
+ * @param      Bcoef     (in)一次项系数（取负）
+ * @param      Ccoef     (in)常数项
+ * @param      travt     (out)走时
+ */
+void solve_travt_batch(
+    MYINT n, const double *restrict Acoef, const double *restrict Bcoef,
+    const double *restrict Ccoef, double *restrict travt);
+
+
 
 /**
  * 根据梯度下降，从走时场中提取初至射线
@@ -226,4 +552,53 @@ MYREAL FMM_raytracing(
     double r0, double t0, double p0,
     double rr, double tt, double pp, double seglen, double segfac,
     const MYREAL *Slw, const MYREAL *TT, bool sphcoord,
-    double *rays, MYINT *N);
\ No newline at end of file
+    double *rays, MYINT *N);
+
+
+
+/**
+ * 使用同一个走时场，对多个接收点并行做射线追踪，方法同 FMM_raytracing 。
+ * 射线点数组按需扩容，所有射线按接收点顺序拼接为一个数组，第i条射线为第offsets[i]到offsets[i+1]-1个点
+ * 
+ * @param     rs     (in)维度1坐标数组
+ * @param     nr     (in)rs长度
+ * @param     ts     (in)维度2坐标数组
+ * @param     nt     (in)ts长度
+ * @param     ps     (in)维度2坐标数组
+ * @param     np     (in)ps长度
+ * @param     r0     (in)源点维度1坐标
+ * @param     t0     (in)源点维度2坐标
+ * @param     p0     (in)源点维度3坐标
+ * @param     rcvs   (in)形状为(nrcv, 3)的接收点坐标数组
+ * @param     nrcv   (in)接收点个数
+ * @param     seglen (in)射线段长度
+ * @param     segfac (in)t < segfac*seglen/v，当射线追踪到在源点附近时，射线直接连接源点
+ * @param     Slw    (in)展平的三维慢度场，若非NULL则使用累加求和计算走时，否则直接从走时场中插值得到走时
+ * @param     TT     (in)展平的三维走时场
+ * @param     sphcoord  (in)是否使用球坐标
+ * @param     maxdots   (in)每条射线的最大点数
+ * @param     nthreads  (in)线程数，<=0时使用OpenMP当前设置的线程数
+ * @param     travt     (out)各射线走时，射线为空时为9.9e30
+ * @param     status    (out)各射线状态， FMM_RAY_OK, FMM_RAY_TRUNCATED, FMM_RAY_OUTSIDE 或 FMM_RAY_UNREACHED
+ * @param     offsets   (out)长度为nrcv+1，各射线在射线点数组中的起始位置
+ * @param     prays     (out)展平的射线点数组，需使用 FMM_rays_free 释放
+ * 
+ * @return    射线点总数
+ * 
+ */
+MYINT FMM_raytracing_batch(
+    const double *rs, MYINT nr, 
+    const double *ts, MYINT nt, 
+    const double *ps, MYINT np,
+    double r0, double t0, double p0,
+    const double *rcvs, MYINT nrcv, double seglen, double segfac,
+    const MYREAL *Slw, const MYREAL *TT, bool sphcoord, MYINT maxdots, MYINT nthreads,
+    MYREAL *travt, MYINT *status, MYINT *offsets, double **prays);
+
+
+/**
+ * 释放 FMM_raytracing_batch 返回的射线点数组
+ * 
+ * @param     rays    (inout)射线点数组
+ */
+void FMM_rays_free(double *rays);
\ No newline at end of file
@@ -0,0 +1,62 @@
+/**
+ * @file   fmmadj.h
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+ *       伴随状态法(adjoint-state)计算接收点走时目标函数对慢度场的梯度。
+ *
+ *       离散程函方程在每个节点处为 \f$ F_k = \sum_d (a_d T_k - b_d)^2 - s_k^2 = 0 \f$ ，
+ *       其中 \f$ b_d \f$ 为上游邻点走时的线性组合。FMM按走时递增的顺序确定节点，
+ *       节点只依赖比它先确定的节点，方程组的雅可比矩阵按确定顺序为下三角矩阵。
+ *       因此正演时记录节点的确定顺序(见 FastMarching_with_initial 的order参数)，
+ *       伴随方程只需按相反顺序扫描一遍：每个节点的拉格朗日乘子确定后，
+ *       按差分模板中的系数传给其上游节点，同时得到该节点处的梯度，
+ *       计算量与一次FMM相当，且与接收点个数无关。
+ *
+ *       反向扫描时以最终走时场重建每个节点的差分模板(见 upwind_stencil )，
+ *       源点附近初始化且之后未被更新的节点走时为距离乘以慢度，梯度为走时除以慢度。
+ *
+*/
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "const.h"
+
+
+/**
+ * 使用FMM计算单个源点到多个接收点的走时，并使用伴随状态法计算目标函数对慢度场的梯度。
+ * rcvTTobs为NULL时目标函数为各接收点走时之和，否则为 \f$ \frac{1}{2}\sum_i (T_i - T^{obs}_i)^2 \f$ 。
+ * 正演使用二叉堆和带幽灵层的行优先排布，不支持源点附近的加密网格；
+ * 接收点插值所需的节点均确定后即结束，未确定节点的梯度为0
+ *
+ * @param     rs     (in)维度1坐标数组
+ * @param     nr     (in)rs长度
+ * @param     ts     (in)维度2坐标数组
+ * @param     nt     (in)ts长度
+ * @param     ps     (in)维度2坐标数组
+ * @param     np     (in)ps长度
+ * @param     rr     (in)源点维度1坐标
+ * @param     tt     (in)源点维度2坐标
+ * @param     pp     (in)源点维度3坐标
+ * @param     maxodr (in)使用的最大差分阶数
+ * @param     Slw    (in)展平的三维慢度场
+ * @param     TT     (out)展平的三维走时场，未确定节点为临时走时或9.9e30
+ * @param     sphcoord  (in)是否使用球坐标
+ * @param     rcvs      (in)形状为(nrcv, 3)的接收点坐标数组
+ * @param     nrcv      (in)接收点个数
+ * @param     rcvTTobs  (in)接收点观测走时，可为NULL
+ * @param     rcvTT     (out)接收点走时
+ * @param     grad      (out)展平的三维梯度场
+ * @param     printbar  (in)是否打印进度条
+ *
+ */
+void FastMarching_adjoint(
+    const double *rs, MYINT nr,
+    const double *ts, MYINT nt,
+    const double *ps, MYINT np,
+    double rr,  double tt, double pp,
+    MYINT maxodr,  const MYREAL *Slw, MYREAL *TT,
+    bool sphcoord, const double *rcvs, MYINT nrcv,
+    const MYREAL *rcvTTobs, MYREAL *rcvTT, MYREAL *grad, bool printbar);
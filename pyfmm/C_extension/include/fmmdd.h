@@ -0,0 +1,71 @@
+/**
+ * @file   fmmdd.h
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+ *       区域分解的并行Fast Marching Method。
+ *
+ *       沿维度1将网格分为若干连续的子区域，每个子区域两侧各带 maxodr 层幽灵节点(ghost)，
+ *       以满足差分模板的需要。每个线程负责一个子区域，使用局部的堆独立推进波前。
+ *       各子区域的走时、状态和堆位置索引只覆盖自身及幽灵层的行，交换边界走时时按起始行转换索引，
+ *       因此所有子区域合计约需要一份走时和堆位置索引数组，外加 2*maxodr*(子区域数-1) 行幽灵节点。
+ *
+ *       为使各子区域的波前同步推进，按走时分段(宽度为 DDFMM_BAND_CELLS 个最小单元走时)：
+ *       每段内各线程只确定走时不超过当前段上界的节点，之后交换边界走时，
+ *       幽灵节点的走时若明显减小则重新入堆。由于相邻子区域的走时可能晚一段才传到，
+ *       这些节点标记为 FMM_RCL ，局部推进时由其出发重新打开已确定的节点(见 FastMarching_with_initial 的reopen参数)，
+ *       走时只减不增。所有子区域的堆都为空且交换后没有走时变化时结束。
+ *
+ *       各子区域内的计算顺序与串行FMM不同，结果与串行FMM存在差别：
+ *       均匀介质中与 FMM_REOPEN_RTOL 同量级，强非均匀介质中可达差分误差的量级。
+ *
+*/
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "const.h"
+#include "nodestat.h"
+
+#define DDFMM_BAND_CELLS 4   ///< 同步推进的走时段宽度，以最小的单个网格走时为单位
+#define DDFMM_MIN_ROWS   8   ///< 每个子区域至少拥有的维度1节点数
+
+
+/**
+ * 根据网格大小和线程数确定子区域个数
+ *
+ * @param      nr        (in)维度1长度
+ * @param      maxodr    (in)使用的最大差分阶数，即幽灵节点层数
+ * @param      nthreads  (in)线程数，<=0时使用OpenMP当前设置的线程数
+ *
+ * @return     子区域个数，为1时应使用串行FMM
+ */
+MYINT fmmdd_ndomain(MYINT nr, MYINT maxodr, MYINT nthreads);
+
+
+/**
+ * 在源点附近初始化完成后，使用区域分解的并行Fast Marching Method计算全局走时场，
+ * 各子区域固定使用二叉堆，数组为行优先排布
+ *
+ * @param     rs     (in)维度1坐标数组
+ * @param     nr     (in)rs长度
+ * @param     ts     (in)维度2坐标数组
+ * @param     nt     (in)ts长度
+ * @param     ps     (in)维度2坐标数组
+ * @param     np     (in)ps长度
+ * @param     maxodr (in)使用的最大差分阶数
+ * @param     Slw    (in)展平的三维慢度场
+ * @param     TT     (inout)展平的三维走时场，未计算的节点为9.9e30
+ * @param     FMM_stat  (in)初始化后每个节点的状态，close节点作为初始波前
+ * @param     sphcoord  (in)是否使用球坐标
+ * @param     nthreads  (in)线程数，<=0时使用OpenMP当前设置的线程数
+ * @param     printbar  (in)是否打印进度条
+ * 
+ */
+void FastMarching_dd(
+    const double *rs, MYINT nr, 
+    const double *ts, MYINT nt, 
+    const double *ps, MYINT np,
+    MYINT maxodr,  const MYREAL *Slw, MYREAL *TT, 
+    const NODE_STAT *FMM_stat, bool sphcoord, MYINT nthreads, bool printbar);
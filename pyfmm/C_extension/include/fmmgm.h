@@ -0,0 +1,64 @@
+/**
+ * @file   fmmgm.h
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+ *       Group Marching Method (Kim, 2001)。
+ *
+ *       波前不需要堆。每一步取波前最小走时 Tmin，
+ *       将走时不超过 Tmin + δ 的所有波前节点作为一组同时确定，
+ *       δ 为波前节点处 h*s 的最小值乘以 FMMGM_GROUP_FAC ，其中h为该节点处最小的网格间距。
+ *       波前节点按走时放入宽度为全网格上最小 δ 的桶中，每个桶记录桶内 h*s 的最小值，
+ *       因此每步只需检查走时不超过 Tmin + δ 的几个桶，不需要遍历整个波前。
+ *       组内节点之间的走时差小于一个网格的走时，互相依赖较弱，
+ *       因此对组内节点及其未确定的邻点做两遍更新即可，
+ *       每遍都基于同一走时场计算所有节点的新走时再一起写回，可以并行，结果与线程数无关。
+ *
+ *       与FMM相比省去了堆操作的对数因子，但组内节点的确定顺序不再严格按走时递增，
+ *       结果与串行FMM存在差别，不超过差分误差的量级。
+ *
+*/
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "const.h"
+#include "heapsort.h"
+#include "layout.h"
+#include "nodestat.h"
+
+#define FMMGM_GROUP_FAC  0.5773502691896258   ///< 组的走时宽度与波前节点处 h*s 最小值之比，即 1/sqrt(3)
+
+
+/**
+ * 在源点附近初始化完成后，使用Group Marching Method计算全局走时场
+ *
+ * @param     rs     (in)维度1坐标数组
+ * @param     nr     (in)rs长度
+ * @param     ts     (in)维度2坐标数组
+ * @param     nt     (in)ts长度
+ * @param     ps     (in)维度2坐标数组
+ * @param     np     (in)ps长度
+ * @param     maxodr (in)使用的最大差分阶数
+ * @param     Slw    (in)展平的三维慢度场
+ * @param     TT     (inout)展平的三维走时场，未计算的节点为9.9e30
+ * @param     FMM_stat  (inout)每个节点的状态，结束时到达的节点均为alive
+ * @param     sphcoord  (in)是否使用球坐标
+ * @param     FMM_data  (in)初始波前，即堆中的节点索引
+ * @param     size      (in)初始波前的节点数
+ * @param     Ndots     (in)未计算的节点数，用于打印进度条
+ * @param     lay       (in)慢度、走时、状态数组的排布方式，须带有幽灵层，
+ *                      幽灵节点须为走时9.9e30的alive节点
+ * @param     nthreads  (in)线程数，<=0时使用OpenMP当前设置的线程数
+ * @param     printbar  (in)是否打印进度条
+ *
+ */
+void FastMarching_gm(
+    const double *rs, MYINT nr,
+    const double *ts, MYINT nt,
+    const double *ps, MYINT np,
+    MYINT maxodr,  const MYREAL *Slw, MYREAL *TT,
+    NODE_STAT *FMM_stat, bool sphcoord,
+    const HEAP_DATA *FMM_data, MYINT size, MYINT Ndots,
+    const GRID_LAYOUT *lay, MYINT nthreads, bool printbar);
@@ -0,0 +1,69 @@
+/**
+ * @file   fmmmq.h
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+ *       基于松弛并发优先队列 (multiqueue, Rihani et al., 2015) 的并行Fast Marching Method。
+ *
+ *       波前由 FMMMQ_QUEUES_PER_THREAD*线程数 个d叉堆共同管理，每个堆各有一把锁。
+ *       压入时随机选一个堆，弹出时随机选两个堆并取堆首走时较小者，
+ *       因此各线程确定节点的顺序只是近似按走时递增，不需要划分子区域。
+ *       弹出的节点若比所有堆首及其它线程正在处理的节点晚 FMMMQ_BAND_CELLS 个最小单元走时以上，
+ *       则放回堆中，以此限制乱序的程度。
+ *
+ *       邻点走时以原子操作取最小值写入。乱序确定的节点若之后得到明显更小的走时
+ *       (相对差超过 FMM_REOPEN_RTOL)，则重新入堆，弹出后再修正其邻点，
+ *       即以重复入堆代替强制因果性，走时只减不增。初始化时已确定的节点不再重新打开。
+ *       堆中元素采用惰性删除，弹出的走时大于当前走时的元素直接跳过。
+ *       所有堆为空且没有线程仍在处理节点时结束。
+ *       线程连续多次取不到可处理的节点后每次让出处理器，避免空转线程与工作线程争抢。
+ *
+ *       结果与串行FMM存在差别：一阶差分时与舍入误差相近，
+ *       二阶以上差分时差分模板的选取与确定顺序有关，非均匀介质中可达差分误差的量级。
+ *
+*/
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "const.h"
+#include "heapsort.h"
+#include "layout.h"
+#include "nodestat.h"
+
+#define FMMMQ_QUEUES_PER_THREAD 2   ///< 每个线程对应的堆个数
+#define FMMMQ_BAND_CELLS  0.5       ///< 允许乱序的走时段宽度，以最小的单个网格走时为单位
+
+
+/**
+ * 在源点附近初始化完成后，使用multiqueue并行Fast Marching Method计算全局走时场
+ *
+ * @param     rs     (in)维度1坐标数组
+ * @param     nr     (in)rs长度
+ * @param     ts     (in)维度2坐标数组
+ * @param     nt     (in)ts长度
+ * @param     ps     (in)维度2坐标数组
+ * @param     np     (in)ps长度
+ * @param     maxodr (in)使用的最大差分阶数
+ * @param     Slw    (in)展平的三维慢度场
+ * @param     TT     (inout)展平的三维走时场，未计算的节点为9.9e30
+ * @param     FMM_stat  (inout)每个节点的状态，结束时均为alive
+ * @param     sphcoord  (in)是否使用球坐标
+ * @param     FMM_data  (in)初始波前，即堆中的节点索引
+ * @param     size      (in)初始波前的节点数
+ * @param     Ndots     (in)未计算的节点数，用于打印进度条
+ * @param     lay       (in)慢度、走时、状态数组的排布方式，NULL表示行优先排布
+ *                      有幽灵层时，幽灵节点须为走时9.9e30的alive节点
+ * @param     nthreads  (in)线程数，<=0时使用OpenMP当前设置的线程数
+ * @param     printbar  (in)是否打印进度条
+ *
+ */
+void FastMarching_mq(
+    const double *rs, MYINT nr,
+    const double *ts, MYINT nt,
+    const double *ps, MYINT np,
+    MYINT maxodr,  const MYREAL *Slw, MYREAL *TT,
+    NODE_STAT *FMM_stat, bool sphcoord,
+    const HEAP_DATA *FMM_data, MYINT size, MYINT Ndots,
+    const GRID_LAYOUT *lay, MYINT nthreads, bool printbar);
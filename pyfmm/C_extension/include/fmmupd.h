@@ -0,0 +1,55 @@
+/**
+ * @file   fmmupd.h
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+ *       慢度场局部扰动后，在已有走时场的基础上增量更新。
+ *
+ *       FMM按走时递增的顺序确定节点，节点走时只依赖走时更小的邻点，
+ *       因此已有走时场本身就记录了节点的确定顺序。慢度改变的节点只影响其下游，
+ *       即从这些节点出发、沿原走时不减的方向经相邻节点可以到达的区域。
+ *       将下游区域重置为far，与其相邻的alive节点以原走时放入堆中作为初始波前面，
+ *       再调用 FastMarching_with_initial 推进。初始波前面节点与下游节点按走时顺序交替确定，
+ *       每次更新时已确定的邻点与完整计算时相同，结果与重新计算全局走时场一致，
+ *       计算量只与下游区域的大小有关。
+ *
+ *       之后检查下游区域之外、差分模板可能用到区域内节点的节点，走时改变的节点并入下游区域。
+ *       慢度减小时走时的减小可能传播到原先的上游，此时先以重新打开已确定节点的方式
+ *       (见 FastMarching_with_initial 的reopen参数)找出走时减小的区域，
+ *       将其及其下游并入下游区域后重新推进，直到区域外的节点都不再改变。
+ *
+*/
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "const.h"
+
+
+/**
+ * 慢度场局部改变后，更新已有的全局走时场。只重新计算慢度改变的节点的下游区域，
+ * 慢度减小时该区域会向上游扩大。结果与使用堆的 FastMarching 重新计算的全局走时场一致
+ *
+ * @param     rs     (in)维度1坐标数组
+ * @param     nr     (in)rs长度
+ * @param     ts     (in)维度2坐标数组
+ * @param     nt     (in)ts长度
+ * @param     ps     (in)维度2坐标数组
+ * @param     np     (in)ps长度
+ * @param     maxodr (in)使用的最大差分阶数，应与计算原走时场时相同
+ * @param     Slw    (in)展平的三维慢度场，改变后的值
+ * @param     TT     (inout)展平的三维走时场，输入为改变前慢度场的FMM全局走时场，输出为更新后的走时场
+ * @param     sphcoord  (in)是否使用球坐标
+ * @param     changed   (in)长度为nr*nt*np的数组，标记慢度改变的节点。
+ *                      改变的节点不能包括源点及源点附近初始化的区域
+ * @param     printbar  (in)是否打印进度条
+ *
+ * @return    重新计算的节点数；标记的节点中有走时为0的源点时返回-1，不修改走时场
+ */
+MYINT FastMarching_update(
+    const double *rs, MYINT nr,
+    const double *ts, MYINT nt,
+    const double *ps, MYINT np,
+    MYINT maxodr,  const MYREAL *Slw, MYREAL *TT,
+    bool sphcoord, const bool *changed, bool printbar);
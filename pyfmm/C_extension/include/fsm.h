@@ -8,6 +8,15 @@
 
 #include "const.h"
 #include "heapsort.h"
+#include "nodestat.h"
+
+#define FSM_PARALLEL_NONE    0   ///< 串行FSM
+#define FSM_PARALLEL_COPIES  1   ///< 8个扫描方向各用一份走时和状态数组同时扫描，再取最小值合并，最多8个线程
+#define FSM_PARALLEL_PLANE   2   ///< 每个扫描方向内，同一超平面 i+j+k=const 上的节点同时更新，不需要额外的数组
+#define FSM_PARALLEL_TILES   3   ///< 网格分块，每个扫描方向内按块的超平面分层同时扫描各块，跳过已收敛的块
+
+#define FSM_TILE_RT      16   ///< 分块扫描时每块在维度1、2上的节点数
+#define FSM_TILE_P       64   ///< 分块扫描时每块在维度3上的节点数，即每行连续的节点数
 
 
 /**
@@ -39,7 +48,11 @@ void set_fsm_num_threads(MYINT num_threads);
  * @param     printbar  (in)是否打印进度条
  * @param     eps        (in)Sweep后的最大更新量达到收敛条件
  * @param     maxLoops   (in)Fast Sweeping Method整体迭代次数（对于3D模型，向8个方向各Sweep一次为迭代一次）  
- * @param     isparallel (in)是否使用并行FSM
+ * @param     parallel   (in)并行方式，见 FSM_PARALLEL_* 。FSM_PARALLEL_COPIES 至少需要迭代2次才能收敛，
+ *                       FSM_PARALLEL_PLANE 和 FSM_PARALLEL_TILES 的结果与串行FSM完全相同
+ * @param     locking    (in)是否使用锁定扫描 (Bak et al., 2010)：节点走时更新或邻点变为alive时，
+ *                       解锁该节点及差分模板范围内的节点，只计算未锁定的节点，跳过已收敛的区域，
+ *                       结果与不锁定时相同。FSM_PARALLEL_COPIES 时不使用
  * 
  * @return    nsweep, sweep次数
  * 
@@ -52,7 +65,26 @@ MYINT FastSweeping(
     MYINT maxodr,  const MYREAL *Slw, 
     MYREAL *TT, bool sphcoord, 
     MYINT rfgfac, MYINT rfgn, bool printbar, 
-    double eps, MYINT maxLoops, bool isparallel);
+    double eps, MYINT maxLoops, MYINT parallel, bool locking);
+
+
+/**
+ * 使用调用者提供的状态数组计算全局走时场，多次计算时可重复使用，其余参数见 FastSweeping
+ * 
+ * @param     FMM_stat   (out)状态数组，长度见 nodestat_alloc ，会被重新初始化
+ * @param     useseeds   (in)是否将TT中的非零值作为初始走时。为false时不检查TT，直接使用源点
+ * 
+ * @return    nsweep, sweep次数
+ */
+MYINT FastSweeping_stat(
+    const double *rs, MYINT nr, 
+    const double *ts, MYINT nt, 
+    const double *ps, MYINT np,
+    double rr,  double tt, double pp,
+    MYINT maxodr,  const MYREAL *Slw, 
+    MYREAL *TT, NODE_STAT *FMM_stat, bool sphcoord, 
+    MYINT rfgfac, MYINT rfgn, bool printbar, 
+    double eps, MYINT maxLoops, MYINT parallel, bool locking, bool useseeds);
 
 
 /**
@@ -67,12 +99,16 @@ MYINT FastSweeping(
  * @param     maxodr (in)使用的最大差分阶数
  * @param     Slw    (in)展平的三维慢度场
  * @param     TT     (inout)展平的三维走时场
- * @param     FMM_stat  (out)记录每个节点的状态(alive, close, far)
+ * @param     FMM_stat  (out)记录每个节点的状态(alive, close, far)，紧凑存储，详见 nodestat.h
  * @param     sphcoord  (in)是否使用球坐标
  * @param     printbar  (in)是否打印进度条
  * @param     eps        (in)Sweep后的最大更新量达到收敛条件
  * @param     maxLoops   (in)Fast Sweeping Method整体迭代次数（对于3D模型，向8个方向各Sweep一次为迭代一次）  
- * @param     isparallel (in)是否使用并行FSM
+ * @param     parallel   (in)并行方式，见 FSM_PARALLEL_* 。FSM_PARALLEL_COPIES 至少需要迭代2次才能收敛，
+ *                       FSM_PARALLEL_PLANE 和 FSM_PARALLEL_TILES 的结果与串行FSM完全相同
+ * @param     locking    (in)是否使用锁定扫描 (Bak et al., 2010)：节点走时更新或邻点变为alive时，
+ *                       解锁该节点及差分模板范围内的节点，只计算未锁定的节点，跳过已收敛的区域，
+ *                       结果与不锁定时相同。FSM_PARALLEL_COPIES 时不使用
  * 
  * @return    nsweep, sweep次数
  */
@@ -81,6 +117,6 @@ MYINT FastSweeping_with_initial(
     const double *ts, MYINT nt, 
     const double *ps, MYINT np,
     MYINT maxodr,  const MYREAL *Slw, MYREAL *TT, 
-    char *FMM_stat, bool sphcoord, bool printbar, 
-    double eps, MYINT maxLoops, bool isparallel);
+    NODE_STAT *FMM_stat, bool sphcoord, bool printbar, 
+    double eps, MYINT maxLoops, MYINT parallel, bool locking);
 
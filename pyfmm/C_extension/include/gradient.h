@@ -0,0 +1,71 @@
+/**
+ * @file   gradient.h
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+ *       由走时场重建各节点的迎风差分模板，计算走时梯度场。
+ *
+ *       差分模板的选取规则与 get_neighbour_travt 相同：每个维度在两侧取走时严格递减的alive节点，
+ *       选差分值较大的一侧，差分值为负时忽略该维度。FMM、FSM和FIM的结果都满足这一离散程函方程，
+ *       因此由最终走时场重建的模板即为求解时最后一次更新使用的模板，
+ *       得到的梯度与走时场自洽，不需要再对走时场做插值差分。
+ *
+*/
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "const.h"
+#include "layout.h"
+#include "nodestat.h"
+
+
+/**
+ * 以节点的走时重建其迎风差分模板
+ *
+ * @param     lay    (in)带幽灵层的排布，幽灵节点的走时须为9.9e30
+ * @param     ir     (in)维度1索引
+ * @param     it     (in)维度2索引
+ * @param     ip     (in)维度3索引
+ * @param     maxodr (in)使用的最大差分阶数
+ * @param     TT     (in)走时场
+ * @param     FMM_stat  (in)节点状态，只使用alive节点；为NULL时所有节点均视为alive
+ * @param     h      (in)节点处各维度的网格间距，球坐标下已乘以半径
+ * @param     dif    (out)各维度的差分值 \f$ aT-b \f$ ，忽略的维度为0
+ * @param     acoef  (out)各维度的系数a
+ * @param     sgn    (out)各维度上游节点所在的一侧，-1为索引减小的一侧，1为索引增大的一侧，忽略的维度为0
+ * @param     odrs   (out)各维度使用的阶数
+ * @param     jdxs   (out)各维度上游节点的索引，依次远离该节点
+ */
+void upwind_stencil(
+    const GRID_LAYOUT *lay, MYINT ir, MYINT it, MYINT ip, MYINT maxodr,
+    const MYREAL *TT, const NODE_STAT *FMM_stat, const double h[3],
+    double dif[3], double acoef[3], char sgn[3], MYINT odrs[3], MYINT jdxs[3][3]);
+
+
+/**
+ * 由走时场计算各节点的走时梯度。球坐标下为
+ * \f$ (\partial_r T, \frac{1}{r}\partial_\theta T, \frac{1}{r\sin\theta}\partial_\phi T) \f$ ，
+ * 未到达(走时为9.9e30)的节点梯度为0
+ *
+ * @param     rs     (in)维度1坐标数组
+ * @param     nr     (in)rs长度
+ * @param     ts     (in)维度2坐标数组
+ * @param     nt     (in)ts长度
+ * @param     ps     (in)维度2坐标数组
+ * @param     np     (in)ps长度
+ * @param     maxodr (in)使用的最大差分阶数，应与计算走时场时相同
+ * @param     TT     (in)展平的三维走时场
+ * @param     sphcoord  (in)是否使用球坐标
+ * @param     gTr    (out)展平的三维梯度场，维度1分量
+ * @param     gTt    (out)展平的三维梯度场，维度2分量
+ * @param     gTp    (out)展平的三维梯度场，维度3分量
+ *
+ */
+void traveltime_gradient(
+    const double *rs, MYINT nr,
+    const double *ts, MYINT nt,
+    const double *ps, MYINT np,
+    MYINT maxodr, const MYREAL *TT, bool sphcoord,
+    MYREAL *gTr, MYREAL *gTt, MYREAL *gTp);
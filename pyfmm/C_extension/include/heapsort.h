@@ -4,7 +4,8 @@
  * @date   2023-03
  * 
  *       非标准版本的最小推排序，堆元素本身数据是某个数据节点的索引值，
- *       判断元素大小关系使用节点对应的走时进行比较
+ *       判断元素大小关系使用节点对应的走时进行比较，走时相等时节点索引小者优先，
+ *       因此二叉堆与d叉堆的弹出顺序完全确定且相同
  * 
 */
 
@@ -99,6 +100,104 @@ inline void Swap(HEAP_DATA * data1, HEAP_DATA * data2){
 }
 
 
+
+/**
+ * 缓存行字节数，d叉堆的子节点按此对齐
+ */
+#define DHEAP_CACHELINE 64
+
+
+/**
+ * d叉堆元素，走时与节点索引连续存放，比较大小时无需再访问走时数组
+ */
+typedef struct {
+    MYREAL t;        ///< 走时
+    HEAP_DATA idx;   ///< 节点索引
+} DHEAP_NODE;
+
+
+/**
+ * d叉堆的叉数，使每个节点的全部子节点恰好占满一个缓存行
+ * （双精度/长整型为4叉，单精度+32位整型为8叉）
+ */
+#define DHEAP_D ((MYINT)(DHEAP_CACHELINE/sizeof(DHEAP_NODE)))
+
+
+/**
+ * 按缓存行对齐的d叉最小堆。
+ * 
+ * 节点i的子节点为 D*i+1, ..., D*i+D，堆首放在对齐内存块的最后一个元素位置，
+ * 使每组子节点都落在同一个缓存行内。
+ * 
+ * 支持两种删除方式：
+ *   + 传入 NroIdx 时维护节点在堆中的位置，可使用 DHeap_DecreaseKey 原位调整；
+ *   + NroIdx 为NULL时使用惰性删除，走时减小后直接重复压入，
+ *     弹出时由调用者跳过已确定的节点，此时不再需要每个网格节点8字节的 NroIdx 数组。
+ * 
+ * 与二叉堆相同，走时相等时按节点索引决定先后，两者弹出有效元素的顺序一致，
+ * 走时有并列时FMM结果仍与二叉堆逐位相同。
+ */
+typedef struct {
+    DHEAP_NODE *data;  ///< 堆首指针
+    void *raw;         ///< 实际申请的内存首地址
+    MYINT size;        ///< 堆大小
+    MYINT cap;         ///< 堆容量
+} DARY_HEAP;
+
+
+/**
+ * 创建d叉堆
+ * 
+ * @param      cap           (in)初始容量
+ * 
+ * @return     d叉堆指针
+ */
+DARY_HEAP * DHeap_create(MYINT cap);
+
+
+/**
+ * 释放d叉堆
+ * 
+ * @param      heap          (inout)d叉堆指针
+ */
+void DHeap_free(DARY_HEAP *heap);
+
+
+/**
+ * 压入元素，容量不足时自动扩充
+ * 
+ * @param      heap          (inout)d叉堆指针
+ * @param      newdata       (in)节点索引
+ * @param      t             (in)节点走时
+ * @param      NroIdx        (out)一维指针，用于在节点索引位置处填上堆中的索引值，可为NULL
+ */
+void DHeapPush(DARY_HEAP *heap, HEAP_DATA newdata, MYREAL t, MYINT *NroIdx);
+
+
+/**
+ * 弹出堆首元素，调用前需保证 heap->size > 0
+ * 
+ * @param      heap          (inout)d叉堆指针
+ * @param      pt            (out)非NULL时，返回弹出元素的走时
+ * @param      NroIdx        (out)一维指针，用于在节点索引位置处填上堆中的索引值，可为NULL
+ * 
+ * @return     堆首元素的节点索引
+ */
+HEAP_DATA DHeapPop(DARY_HEAP *heap, MYREAL *pt, MYINT *NroIdx);
+
+
+/**
+ * 减小堆中某个元素的走时并向上调整，需要维护 NroIdx
+ * 
+ * @param      heap          (inout)d叉堆指针
+ * @param      pos           (in)元素在堆中的索引值，即 NroIdx[节点索引]
+ * @param      t             (in)新的走时，不大于原走时
+ * @param      NroIdx        (out)一维指针，用于在节点索引位置处填上堆中的索引值
+ */
+void DHeap_DecreaseKey(DARY_HEAP *heap, MYINT pos, MYREAL t, MYINT *NroIdx);
+
+
+
 /**
  * 打印推数据【用于debug】
  */
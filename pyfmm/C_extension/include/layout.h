@@ -0,0 +1,135 @@
+/**
+ * @file   layout.h
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+ *       三维网格数据在内存中的排布方式。
+ *
+ *       除了行优先 (r, t, p) 排布外，支持将网格划分为 4x4x4 的小块 (brick)，
+ *       块内节点连续存放，块与块之间再按行优先排布。此时差分模板中
+ *       r 方向的邻点不再相隔 nt*np 个元素，大部分落在同一块内，减少缓存未命中。
+ *
+ *       两种排布的展开索引都可以写成各维度偏移量之和，
+ *       \f$ idx = offr[ir] + offt[it] + offp[ip] \f$ ，
+ *       求解器中沿某一维度移动时只需查表，不需要区分排布方式。
+ *
+ *       网格四周还可以填充 pad 层幽灵节点，此时偏移量数组的有效索引为 [-pad, n+pad)，
+ *       幽灵节点的状态和走时由求解器设置，使其永远不会被用作差分模板或被更新，
+ *       边界节点的邻点和差分模板访问不再需要检查索引范围。
+ *
+*/
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "const.h"
+#include "nodestat.h"
+
+#define BRICK_BITS 2                 ///< 分块边长的以2为底对数
+#define BRICK_LEN  (1<<BRICK_BITS)   ///< 分块边长
+
+
+/**
+ * 网格排布
+ */
+typedef struct {
+    MYINT nr, nt, np;            ///< 各维度网格点数
+    MYINT nbt, nbp;              ///< 维度2、3的块数
+    MYINT br, bt, bp;            ///< 各维度块边长的以2为底对数，均为0时即行优先排布
+    MYINT pad;                   ///< 四周幽灵层的层数
+    MYINT size;                  ///< 数组长度，包括分块的填充部分和幽灵层
+    MYINT *offr, *offt, *offp;   ///< 各维度索引对应的偏移量，有效索引为 [-pad, n+pad)
+} GRID_LAYOUT;
+
+
+/**
+ * 初始化网格排布
+ *
+ * @param      lay      (out)网格排布
+ * @param      nr       (in)维度1长度
+ * @param      nt       (in)维度2长度
+ * @param      np       (in)维度3长度
+ * @param      brick    (in)是否分块排布，长度不足一个块边长的维度不分块
+ * @param      pad      (in)四周幽灵层的层数，0表示不填充
+ *
+ */
+void grid_layout_init(GRID_LAYOUT *lay, MYINT nr, MYINT nt, MYINT np, bool brick, MYINT pad);
+
+
+/**
+ * 释放网格排布中的偏移量数组
+ *
+ * @param      lay      (inout)网格排布
+ */
+void grid_layout_free(GRID_LAYOUT *lay);
+
+
+/**
+ * 将行优先排布的数组转为指定排布，填充部分和幽灵层赋值为fill
+ *
+ * @param      lay      (in)网格排布
+ * @param      src      (in)行优先排布的数组
+ * @param      dst      (out)指定排布的数组，长度为 lay->size
+ * @param      fill     (in)填充值
+ */
+void grid_to_layout(const GRID_LAYOUT *lay, const MYREAL *src, MYREAL *dst, MYREAL fill);
+
+
+/**
+ * 将指定排布的数组转回行优先排布
+ *
+ * @param      lay      (in)网格排布
+ * @param      src      (in)指定排布的数组，长度为 lay->size
+ * @param      dst      (out)行优先排布的数组
+ */
+void grid_from_layout(const GRID_LAYOUT *lay, const MYREAL *src, MYREAL *dst);
+
+
+/**
+ * 同 grid_to_layout ，用于状态数组，dst需预先初始化（填充部分和幽灵层保持原值）
+ */
+void grid_to_layout_stat(const GRID_LAYOUT *lay, const NODE_STAT *src, NODE_STAT *dst);
+
+
+/**
+ * 同 grid_from_layout ，用于状态数组
+ */
+void grid_from_layout_stat(const GRID_LAYOUT *lay, const NODE_STAT *src, NODE_STAT *dst);
+
+
+
+/**
+ * 将三维索引展开成一维索引(内联函数)
+ *
+ * @param      lay      (in)网格排布
+ * @param      ir       (in)第1维索引
+ * @param      it       (in)第2维索引
+ * @param      ip       (in)第3维索引
+ *
+ * @return     展开后的索引
+ */
+inline MYINT grid_ravel(const GRID_LAYOUT *lay, MYINT ir, MYINT it, MYINT ip){
+    return lay->offr[ir] + lay->offt[it] + lay->offp[ip];
+}
+
+
+/**
+ * 将一维索引恢复成三维索引(内联函数)
+ *
+ * @param      lay      (in)网格排布
+ * @param      idx      (in)展开后的索引
+ * @param      ir       (out)第1维索引，幽灵节点为负数或不小于nr
+ * @param      it       (out)第2维索引
+ * @param      ip       (out)第3维索引
+ */
+inline void grid_unravel(const GRID_LAYOUT *lay, MYINT idx, MYINT *ir, MYINT *it, MYINT *ip){
+    MYINT bt = lay->bt, bp = lay->bp;
+    MYINT nb = lay->br + bt + bp;
+    MYINT blk = idx >> nb;
+    MYINT in = idx & (((MYINT)1<<nb) - 1);
+    MYINT blkt = blk / lay->nbp;
+    *ir = (((blkt / lay->nbt) << lay->br) | (in >> (bt+bp))) - lay->pad;
+    *it = (((blkt % lay->nbt) << bt) | ((in >> bp) & (((MYINT)1<<bt) - 1))) - lay->pad;
+    *ip = (((blk % lay->nbp) << bp) | (in & (((MYINT)1<<bp) - 1))) - lay->pad;
+}
@@ -0,0 +1,176 @@
+/**
+ * @file   nodestat.h
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+ *       节点状态(alive, close, far)的紧凑存储。每个节点占2比特，一个字节存放4个节点，
+ *       相比每个节点一个char，状态数组的内存减少为1/4。
+ *
+ *       存储值为 状态-FMM_FAR ，即 far=0, close=1, alive=2, 重新打开的close=3，
+ *       因此全零的数组即所有节点均为 far 。
+ *
+ *       同一字节内的4个节点共享一次读-改-写，多个线程不能同时修改同一个状态数组。
+ *
+*/
+
+#pragma once
+
+#include "const.h"
+
+#define FMM_FAR -1   ///< 波前还未触及的区域
+#define FMM_CLS 0    ///< 波前面
+#define FMM_ALV 1    ///< 波前已完全扫过的区域，走时已确定
+#define FMM_RCL 2    ///< 走时被修正而重新打开的波前面，仅在允许重新打开已确定节点时使用
+
+#define NODESTAT_BITS 2                          ///< 每个节点状态占用的比特数
+#define NODESTAT_PER_WORD (8/NODESTAT_BITS)      ///< 每个字节存放的节点数
+
+typedef unsigned char NODE_STAT;  ///< 状态数组的存储单元
+
+
+/**
+ * 状态数组所需的存储单元个数
+ *
+ * @param      n        (in)节点数
+ *
+ * @return     存储单元个数
+ */
+MYINT nodestat_words(MYINT n);
+
+
+/**
+ * 申请状态数组，所有节点初始化为 far
+ *
+ * @param      n        (in)节点数
+ *
+ * @return     状态数组
+ */
+NODE_STAT * nodestat_alloc(MYINT n);
+
+
+/**
+ * 将所有节点设为同一状态
+ *
+ * @param      st       (inout)状态数组
+ * @param      n        (in)节点数
+ * @param      s        (in)状态
+ */
+void nodestat_fill(NODE_STAT *st, MYINT n, char s);
+
+
+/**
+ * 读取节点状态(内联函数)
+ *
+ * @param      st       (in)状态数组
+ * @param      i        (in)节点索引
+ *
+ * @return     状态，FMM_FAR, FMM_CLS, FMM_ALV 或 FMM_RCL
+ */
+inline char nodestat_get(const NODE_STAT *st, MYINT i){
+    return (char)((st[i>>2] >> ((i&3)<<1)) & 3) + FMM_FAR;
+}
+
+
+/**
+ * 设置节点状态(内联函数)
+ *
+ * @param      st       (inout)状态数组
+ * @param      i        (in)节点索引
+ * @param      s        (in)状态，FMM_FAR, FMM_CLS, FMM_ALV 或 FMM_RCL
+ */
+inline void nodestat_set(NODE_STAT *st, MYINT i, char s){
+    int sh = (i&3)<<1;
+    NODE_STAT *w = st + (i>>2);
+    *w = (NODE_STAT)((*w & ~(3<<sh)) | ((s - FMM_FAR) << sh));
+}
+
+
+/**
+ * 设置节点状态(内联函数)，同一字节内的其它节点可能被其它线程同时修改，以原子操作写入
+ *
+ * @param      st       (inout)状态数组
+ * @param      i        (in)节点索引
+ * @param      s        (in)状态，FMM_FAR, FMM_CLS, FMM_ALV 或 FMM_RCL
+ */
+inline void nodestat_set_atomic(NODE_STAT *st, MYINT i, char s){
+    int sh = (i&3)<<1;
+    NODE_STAT *w = st + (i>>2);
+    NODE_STAT old = __atomic_load_n(w, __ATOMIC_RELAXED), nw;
+    do {
+        nw = (NODE_STAT)((old & ~(3<<sh)) | ((s - FMM_FAR) << sh));
+    } while(!__atomic_compare_exchange_n(w, &old, nw, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+
+
+typedef unsigned char NODE_MASK;  ///< 节点标记数组的存储单元，每个节点1比特
+
+
+/**
+ * 申请节点标记数组，所有节点初始化为未标记
+ *
+ * @param      n        (in)节点数
+ *
+ * @return     标记数组
+ */
+NODE_MASK * nodemask_alloc(MYINT n);
+
+
+/**
+ * 读取节点是否被标记(内联函数)
+ *
+ * @param      m        (in)标记数组
+ * @param      i        (in)节点索引
+ *
+ * @return     1表示已标记，0表示未标记
+ */
+inline char nodemask_get(const NODE_MASK *m, MYINT i){
+    return (char)((m[i>>3] >> (i&7)) & 1);
+}
+
+
+/**
+ * 标记节点(内联函数)
+ *
+ * @param      m        (inout)标记数组
+ * @param      i        (in)节点索引
+ */
+inline void nodemask_set(NODE_MASK *m, MYINT i){
+    m[i>>3] |= (NODE_MASK)(1 << (i&7));
+}
+
+
+/**
+ * 取消节点标记(内联函数)
+ *
+ * @param      m        (inout)标记数组
+ * @param      i        (in)节点索引
+ */
+inline void nodemask_clear(NODE_MASK *m, MYINT i){
+    m[i>>3] &= (NODE_MASK)~(1 << (i&7));
+}
+
+
+/**
+ * 标记节点(内联函数)，同一字节内的其它节点可能被其它线程同时修改，以原子操作写入
+ *
+ * @param      m        (inout)标记数组
+ * @param      i        (in)节点索引
+ *
+ * @return     标记前的值，1表示此前已被标记。多个线程同时标记同一节点时只有一个得到0
+ */
+inline char nodemask_set_atomic(NODE_MASK *m, MYINT i){
+    NODE_MASK bit = (NODE_MASK)(1 << (i&7));
+    return (__atomic_fetch_or(m + (i>>3), bit, __ATOMIC_RELAXED) & bit) != 0;
+}
+
+
+/**
+ * 取消节点标记(内联函数)，以原子操作写入
+ *
+ * @param      m        (inout)标记数组
+ * @param      i        (in)节点索引
+ */
+inline void nodemask_clear_atomic(NODE_MASK *m, MYINT i){
+    __atomic_fetch_and(m + (i>>3), (NODE_MASK)~(1 << (i&7)), __ATOMIC_RELAXED);
+}
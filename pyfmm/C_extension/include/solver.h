@@ -0,0 +1,123 @@
+/**
+ * @file   solver.h
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+ *       可重复使用的走时求解器。
+ *
+ *       FastMarching 和 FastSweeping 每次调用都要重新申请状态数组、堆和堆中位置数组，
+ *       检查走时场中的非零初始值，分块排布时还要转换慢度场。对于同一网格和慢度模型下
+ *       大量小规模计算(如逐个源点计算)，这些开销占比较大。
+ *
+ *       求解器在创建时复制网格坐标和慢度场(分块排布时同时转换)，并申请FMM工作空间，
+ *       之后每次计算只需给出源点，直接初始化走时场和状态数组，不再检查非零初始值，
+ *       所有数组在多次计算间重复使用。FSM的状态数组在第一次使用时申请。
+ *
+*/
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "const.h"
+#include "nodestat.h"
+#include "fmm.h"
+
+
+/**
+ * 走时求解器
+ */
+typedef struct {
+    MYINT nr, nt, np;          ///< 各维度网格点数
+    double *rs, *ts, *ps;      ///< 各维度坐标数组
+    MYINT maxodr;              ///< 使用的最大差分阶数
+    bool sphcoord;             ///< 是否使用球坐标
+    MYREAL *Slw;               ///< 行优先排布的慢度场
+    MYREAL *Slw_lay;           ///< 按工作空间排布（带幽灵层）的慢度场，工作空间inplace时即为Slw
+    FMM_WORKSPACE ws;          ///< FMM工作空间
+    NODE_STAT *FSM_stat;       ///< FSM的状态数组，第一次使用FSM时申请
+} FMM_SOLVER;
+
+
+/**
+ * 创建求解器
+ * 
+ * @param     rs     (in)维度1坐标数组
+ * @param     nr     (in)rs长度
+ * @param     ts     (in)维度2坐标数组
+ * @param     nt     (in)ts长度
+ * @param     ps     (in)维度2坐标数组
+ * @param     np     (in)ps长度
+ * @param     maxodr (in)使用的最大差分阶数
+ * @param     Slw    (in)展平的三维慢度场，会被复制
+ * @param     sphcoord  (in)是否使用球坐标
+ * @param     fmmqueue  (in)FMM波前优先队列类型，见 FastMarching
+ * @param     bricklayout  (in)FMM是否在内部使用 4x4x4 分块排布的数组，见 FastMarching
+ * 
+ * @return    求解器，需使用 fmm_solver_free 释放
+ */
+FMM_SOLVER * fmm_solver_create(
+    const double *rs, MYINT nr, 
+    const double *ts, MYINT nt, 
+    const double *ps, MYINT np,
+    MYINT maxodr,  const MYREAL *Slw, bool sphcoord,
+    MYINT fmmqueue, bool bricklayout);
+
+
+/**
+ * 更新求解器中的慢度场，网格不变
+ * 
+ * @param     sv     (inout)求解器
+ * @param     Slw    (in)展平的三维慢度场
+ */
+void fmm_solver_set_slowness(FMM_SOLVER *sv, const MYREAL *Slw);
+
+
+/**
+ * 使用Fast Marching Method计算给定源点的全局走时场
+ * 
+ * @param     sv     (inout)求解器
+ * @param     rr     (in)源点维度1坐标
+ * @param     tt     (in)源点维度2坐标
+ * @param     pp     (in)源点维度3坐标
+ * @param     TT     (out)展平的三维走时场，不需要初始化
+ * @param     rfgfac    (in)对于源点附近的格点间加密倍数，>1
+ * @param     rfgn      (in)对于源点附近的格点间加密处理的辐射半径，>=1
+ * @param     printbar  (in)是否打印进度条
+ * @param     isparallel   (in)是否使用区域分解的并行FMM，见 FastMarching 。分块排布时不使用
+ */
+void fmm_solver_fmm(
+    FMM_SOLVER *sv, double rr,  double tt, double pp, MYREAL *TT, 
+    MYINT rfgfac, MYINT rfgn, bool printbar, bool isparallel);
+
+
+/**
+ * 使用Fast Sweeping Method计算给定源点的全局走时场
+ * 
+ * @param     sv     (inout)求解器
+ * @param     rr     (in)源点维度1坐标
+ * @param     tt     (in)源点维度2坐标
+ * @param     pp     (in)源点维度3坐标
+ * @param     TT     (out)展平的三维走时场，不需要初始化
+ * @param     rfgfac    (in)对于源点附近的格点间加密倍数，>1
+ * @param     rfgn      (in)对于源点附近的格点间加密处理的辐射半径，>=1
+ * @param     printbar  (in)是否打印进度条
+ * @param     eps        (in)Sweep后的最大更新量达到收敛条件
+ * @param     maxLoops   (in)Fast Sweeping Method整体迭代次数
+ * @param     parallel   (in)并行方式，见 FSM_PARALLEL_*
+ * @param     locking    (in)是否使用锁定扫描，见 FastSweeping
+ * 
+ * @return    nsweep, sweep次数
+ */
+MYINT fmm_solver_fsm(
+    FMM_SOLVER *sv, double rr,  double tt, double pp, MYREAL *TT, 
+    MYINT rfgfac, MYINT rfgn, bool printbar, 
+    double eps, MYINT maxLoops, MYINT parallel, bool locking);
+
+
+/**
+ * 释放求解器
+ * 
+ * @param     sv     (inout)求解器
+ */
+void fmm_solver_free(FMM_SOLVER *sv);
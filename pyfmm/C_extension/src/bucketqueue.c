@@ -0,0 +1,131 @@
+/**
+ * @file   bucketqueue.c
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "const.h"
+#include "mallocfree.h"
+#include "bucketqueue.h"
+
+
+/**
+ * 分配 nbkt 个空桶
+ */
+static void alloc_buckets(BUCKET_QUEUE *bq, MYINT nbkt){
+    bq->nbkt = nbkt;
+    bq->cur = 0;
+    bq->data = (HEAP_DATA **)malloc1d(nbkt, sizeof(HEAP_DATA *));
+    bq->bhead = (MYINT *)malloc1d(nbkt, sizeof(MYINT));
+    bq->bsize = (MYINT *)malloc1d(nbkt, sizeof(MYINT));
+    bq->bcap = (MYINT *)malloc1d(nbkt, sizeof(MYINT));
+    for(MYINT i=0; i<nbkt; ++i){
+        bq->data[i] = NULL;
+        bq->bhead[i] = bq->bsize[i] = bq->bcap[i] = 0;
+    }
+}
+
+static void free_buckets(BUCKET_QUEUE *bq){
+    for(MYINT i=0; i<bq->nbkt; ++i){
+        if(bq->data[i]!=NULL) free(bq->data[i]);
+    }
+    free(bq->data);
+    free(bq->bhead);
+    free(bq->bsize);
+    free(bq->bcap);
+}
+
+/**
+ * 向某个桶尾部添加元素
+ */
+static void bucket_append(BUCKET_QUEUE *bq, MYINT ib, HEAP_DATA newdata){
+    if(bq->bsize[ib] == bq->bcap[ib]){
+        MYINT newcap = (bq->bcap[ib]==0)? 8 : bq->bcap[ib]*2;
+        HEAP_DATA *data0 = realloc(bq->data[ib], sizeof(HEAP_DATA)*newcap);
+        if(data0==NULL){
+            fprintf(stderr, "reallocation failed in bucket queue. exit.");
+            exit(EXIT_FAILURE);
+        }
+        bq->data[ib] = data0;
+        bq->bcap[ib] = newcap;
+    }
+    bq->data[ib][bq->bsize[ib]++] = newdata;
+    bq->size++;
+}
+
+/**
+ * 走时跨度超过环的范围时，扩充桶个数并按当前走时重新分配元素
+ */
+static void grow_buckets(BUCKET_QUEUE *bq, MYINT nbkt, const MYREAL *TT){
+    BUCKET_QUEUE old = *bq;
+    alloc_buckets(bq, nbkt);
+    bq->size = 0;
+
+    for(MYINT k=0; k<old.nbkt; ++k){
+        MYINT ib = (old.cur + k) % old.nbkt;
+        for(MYINT i=old.bhead[ib]; i<old.bsize[ib]; ++i){
+            HEAP_DATA data = old.data[ib][i];
+            MYINT jb = BucketQueue_index(bq, TT[data]);
+            if(jb < 0) jb = (bq->cur + bq->nbkt - 1) % bq->nbkt;
+            bucket_append(bq, jb, data);
+        }
+    }
+
+    free_buckets(&old);
+}
+
+
+BUCKET_QUEUE * BucketQueue_create(double width, double tspan, double tmin){
+    BUCKET_QUEUE *bq = (BUCKET_QUEUE *)malloc1d(1, sizeof(BUCKET_QUEUE));
+    if(width <= 0.0) width = 1e-6;
+    MYINT nbkt = (MYINT)ceil(tspan/width) + 2;
+    if(nbkt < 8) nbkt = 8;
+
+    alloc_buckets(bq, nbkt);
+    bq->width = width;
+    bq->tbase = tmin;
+    bq->size = 0;
+
+    return bq;
+}
+
+void BucketQueue_free(BUCKET_QUEUE *bq){
+    free_buckets(bq);
+    free(bq);
+}
+
+MYINT BucketQueue_index(const BUCKET_QUEUE *bq, MYREAL travt){
+    double k = floor((travt - bq->tbase)/bq->width);
+    if(k < 0.0) k = 0.0;
+    if(k >= (double)bq->nbkt) return -1;
+    return (bq->cur + (MYINT)k) % bq->nbkt;
+}
+
+void BucketPush(BUCKET_QUEUE *bq, HEAP_DATA newdata, const MYREAL *TT){
+    MYINT ib = BucketQueue_index(bq, TT[newdata]);
+    if(ib < 0){
+        MYINT nbkt = bq->nbkt;
+        while((TT[newdata] - bq->tbase)/bq->width >= (double)nbkt)  nbkt *= 2;
+        grow_buckets(bq, nbkt, TT);
+        ib = BucketQueue_index(bq, TT[newdata]);
+    }
+    bucket_append(bq, ib, newdata);
+}
+
+HEAP_DATA BucketPop(BUCKET_QUEUE *bq){
+    MYINT ib = bq->cur;
+    // 跳到最早的非空桶
+    while(bq->bhead[ib] == bq->bsize[ib]){
+        bq->bhead[ib] = bq->bsize[ib] = 0;
+        ib = (ib + 1) % bq->nbkt;
+        bq->tbase += bq->width;
+    }
+    bq->cur = ib;
+    bq->size--;
+    return bq->data[ib][bq->bhead[ib]++];
+}
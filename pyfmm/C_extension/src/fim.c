@@ -0,0 +1,367 @@
+/**
+ * @file   fim.c
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <omp.h>
+#include <sys/time.h>
+
+#include "fim.h"
+#include "fmm.h"
+#include "const.h"
+#include "layout.h"
+#include "nodestat.h"
+#include "mallocfree.h"
+
+
+// 走时不小于该值的节点视为尚未到达，不参与最小邻点的比较
+#define FIM_TT_UNREACHED 1e30
+
+
+/**
+ * 局部更新用到的网格信息
+ */
+typedef struct {
+    const GRID_LAYOUT *lay;                 ///< 不带幽灵层的行优先排布
+    NEIGHBOUR_TRAVT_FUNC neighbour_travt;   ///< 邻点走时更新函数
+    MYINT maxodr;                           ///< 使用的最大差分阶数
+    MYINT dnb[6];                           ///< 6个邻点相对于当前节点的索引偏移量
+    const MYREAL *Slw;                      ///< 慢度场
+    const NODE_STAT *FMM_stat;              ///< 节点状态，均为alive
+    bool sphcoord;                          ///< 是否使用球坐标
+    const double *rs;                       ///< 维度1坐标数组
+    const double *sin_ts;                   ///< 维度2坐标的正弦绝对值，仅球坐标使用
+    double dr, dt, dp;                      ///< 各维度网格间距
+} FIM_GRID;
+
+
+/**
+ * 节点在某个方向上是否有邻点
+ *
+ * @param     g         (in)网格信息
+ * @param     ir        (in)维度1索引
+ * @param     it        (in)维度2索引
+ * @param     ip        (in)维度3索引
+ * @param     d         (in)邻点方向，与dnb顺序一致
+ *
+ * @return    是否有邻点
+ */
+static inline bool fim_has_neighbour(const FIM_GRID *g, MYINT ir, MYINT it, MYINT ip, MYINT d)
+{
+    switch(d){
+        case 0:  return ir > 0;
+        case 1:  return ir < g->lay->nr - 1;
+        case 2:  return it > 0;
+        case 3:  return it < g->lay->nt - 1;
+        case 4:  return ip > 0;
+        default: return ip < g->lay->np - 1;
+    }
+}
+
+
+/**
+ * 根据当前走时场计算一个节点的新走时，不修改走时场。
+ * 先由6个邻点中的最小走时得到走时上限，再以其与当前走时的较小值为试探走时调用差分格式
+ *
+ * @param     g         (in)网格信息
+ * @param     TT        (in)走时场
+ * @param     idx       (in)展开后的索引
+ *
+ * @return    新走时，不大于当前走时
+ */
+static MYREAL fim_local_update(const FIM_GRID *g, const MYREAL *TT, MYINT idx)
+{
+    MYINT ir, it, ip;
+    grid_unravel(g->lay, idx, &ir, &it, &ip);
+
+    double hr = g->dr, ht = g->dt, hp = g->dp;
+    if(g->sphcoord){
+        ht *= g->rs[ir];
+        hp *= g->rs[ir]*g->sin_ts[it];
+    }
+    const double hh[6] = {hr, hr, ht, ht, hp, hp};
+
+    MYREAL slw = g->Slw[idx];
+    MYREAL t0 = TT[idx];
+    MYREAL t_bak = t0;
+    bool reached = false;
+    for(MYINT k=0; k<6; ++k){
+        if(! fim_has_neighbour(g, ir, it, ip, k))  continue;
+        MYREAL T = TT[idx + g->dnb[k]];
+        if(T >= FIM_TT_UNREACHED)  continue;
+        reached = true;
+        MYREAL t_bak0 = T + hh[k] * slw;
+        if(t_bak0 < t_bak)  t_bak = t_bak0;
+    }
+    if(! reached)  return t0;
+
+    char travt_stat;
+    MYREAL travt = g->neighbour_travt(
+        g->lay, ir, it, ip, idx, g->maxodr, TT,
+        g->FMM_stat, slw, hr, ht, hp, t_bak, &travt_stat);
+
+    if(travt_stat>=0 && travt>0){
+        if(t_bak < travt) travt = t_bak;
+    } else {
+        travt = t_bak;
+    }
+
+    return (travt < t0)? travt : t0;
+}
+
+
+/**
+ * 保证列表的容量不小于need，按倍数增长
+ *
+ * @param     arr       (in)列表指针，可为NULL
+ * @param     pcap      (inout)当前容量
+ * @param     need      (in)所需容量
+ * @param     maxcap    (in)容量上限，即节点总数
+ * @param     size      (in)每个元素字节数
+ *
+ * @return    增长后的列表指针
+ */
+static void * fim_list_reserve(void *arr, MYINT *pcap, MYINT need, MYINT maxcap, size_t size)
+{
+    if(need <= *pcap)  return arr;
+    MYINT newcap = (*pcap)*2;
+    if(newcap < need)    newcap = need;
+    if(newcap > maxcap)  newcap = maxcap;
+
+    void *arr0 = realloc(arr, size*newcap);
+    if(arr0==NULL){
+        fprintf(stderr, "reallocation failed in fim. exit.");
+        exit(EXIT_FAILURE);
+    }
+    *pcap = newcap;
+    return arr0;
+}
+
+
+MYINT FastIterative(
+    const double *rs, MYINT nr,
+    const double *ts, MYINT nt,
+    const double *ps, MYINT np,
+    double rr,  double tt, double pp,
+    MYINT maxodr,  const MYREAL *Slw,
+    MYREAL *TT, bool sphcoord,
+    MYINT rfgfac, MYINT rfgn, bool printbar, double eps)
+{
+    // 程序运行开始时间
+    struct timeval begin_t;
+    gettimeofday(&begin_t, NULL);
+
+    MYINT nrtp = nr*nt*np;
+    NODE_STAT *FMM_stat = nodestat_alloc(nrtp);
+    nodestat_fill(FMM_stat, nrtp, FMM_FAR);
+
+    // All non-zero value of TT will be treated as efficient value,
+    // and set FMM_ALV
+    bool allzeroTT = true;
+    for(MYINT i=0; i<nrtp; ++i){
+        if(TT[i] == 0.0){
+            TT[i] = 9.9e30f;// init FAR Traveltime
+        } else {
+            nodestat_set(FMM_stat, i, FMM_ALV);
+            allzeroTT = false;
+        }
+    }
+
+    // if all zero in TT, then use rr, tt, pp
+    if(allzeroTT){
+        if(rfgfac>1 && rfgn>=1){
+            init_source_TT_refinegrid(
+                rs, nr, ts, nt, ps, np,
+                rr, tt, pp,
+                maxodr, Slw, TT,
+                FMM_stat, sphcoord,
+                rfgfac, rfgn, printbar,
+                NULL, NULL, NULL, NULL, NULL, FMM_QUEUE_HEAP);
+        } else {
+            init_source_TT(
+                rs, nr, ts, nt, ps, np,
+                rr, tt, pp,
+                Slw, TT,
+                FMM_stat, sphcoord,
+                NULL, NULL, NULL, NULL, NULL);
+        }
+    }
+
+    MYINT niter;
+    niter = FastIterative_with_initial(
+        rs, nr, ts, nt, ps, np,
+        maxodr, Slw, TT,
+        FMM_stat, sphcoord, printbar, eps);
+
+    free(FMM_stat);
+
+    // 程序运行结束时间
+    struct timeval end_t;
+    gettimeofday(&end_t, NULL);
+    if(printbar) printf("Runtime: %.3f s\n", (end_t.tv_sec - begin_t.tv_sec) + (end_t.tv_usec - begin_t.tv_usec) / 1e6);
+    fflush(stdout);
+
+    return niter;
+}
+
+
+
+MYINT FastIterative_with_initial(
+    const double *rs, MYINT nr,
+    const double *ts, MYINT nt,
+    const double *ps, MYINT np,
+    MYINT maxodr,  const MYREAL *Slw, MYREAL *TT,
+    NODE_STAT *FMM_stat, bool sphcoord, bool printbar, double eps)
+{
+    double dr = (nr>1)? rs[1] - rs[0] : 0.0;
+    double dt = (nt>1)? ts[1] - ts[0] : 0.0;
+    double dp = (np>1)? ps[1] - ps[0] : 0.0;
+
+    // convenient arrays
+    double sin_ts[nt];
+    if(sphcoord){
+        for(MYINT it=0; it<nt; ++it){
+            sin_ts[it] = fabs(sin(ts[it]));
+            if(sin_ts[it] < 1e-12) sin_ts[it] += 1e-12;
+        }
+    }
+
+    // 直接在行优先的走时场和状态数组上计算，邻点超出网格时跳过
+    GRID_LAYOUT lay;
+    grid_layout_init(&lay, nr, nt, np, false, 0);
+    MYINT nrtp = nr*nt*np;
+
+    // 活动列表及其下一次迭代的列表，每个节点至多出现一次，容量随波前增长。
+    // 标记数组记录节点是否在列表中
+    MYINT *list = NULL, *next = NULL;
+    MYREAL *val = NULL;
+    MYINT listcap = 0, nextcap = 0, valcap = 0;
+    NODE_MASK *inlist = nodemask_alloc(nrtp);
+
+    MYINT nlist = 0;
+    for(MYINT i=0; i<nrtp; ++i){
+        if(nodestat_get(FMM_stat, i) != FMM_FAR)  nlist++;
+    }
+    list = fim_list_reserve(list, &listcap, (nlist>0)? nlist : 1, nrtp, sizeof(MYINT));
+    nlist = 0;
+    for(MYINT i=0; i<nrtp; ++i){
+        if(nodestat_get(FMM_stat, i) != FMM_FAR){
+            nodemask_set(inlist, i);
+            list[nlist++] = i;
+        }
+    }
+
+    // 所有节点均置为alive，差分格式只根据走时是否小于试探走时选择模板，
+    // 与FSM第一轮扫描之后的情况相同
+    nodestat_fill(FMM_stat, nrtp, FMM_ALV);
+
+    FIM_GRID g = {
+        .lay = &lay,
+        .neighbour_travt = get_neighbour_travt_func(maxodr, false),
+        .maxodr = maxodr,
+        .dnb = {-nt*np, nt*np, -np, np, -1, 1},
+        .Slw = Slw,
+        .FMM_stat = FMM_stat,
+        .sphcoord = sphcoord,
+        .rs = rs, .sin_ts = sin_ts,
+        .dr = dr, .dt = dt, .dp = dp};
+
+    MYINT niter = 0;
+
+    while(nlist > 0){
+        niter++;
+        MYINT nnext = 0, ncarry = 0;
+
+        // 下一次迭代的列表至多包含未收敛的节点及收敛节点的6个邻点，val在步骤1中也按当前列表索引
+        MYINT need = (nlist <= nrtp/7)? 7*nlist : nrtp;
+        next = fim_list_reserve(next, &nextcap, need, nrtp, sizeof(MYINT));
+        val = fim_list_reserve(val, &valcap, need, nrtp, sizeof(MYREAL));
+
+        #pragma omp parallel default(shared)
+        {
+            // 1. 基于同一走时场计算列表中所有节点的新走时
+            #pragma omp for schedule(static)
+            for(MYINT i=0; i<nlist; ++i){
+                val[i] = fim_local_update(&g, TT, list[i]);
+            }
+
+            // 2. 写回走时。未收敛的节点留在列表中，
+            //    收敛的节点移出列表，在列表中记为负数以便下一步检查其邻点
+            #pragma omp for schedule(static)
+            for(MYINT i=0; i<nlist; ++i){
+                MYINT idx = list[i];
+                MYREAL update0 = TT[idx] - val[i];
+                TT[idx] = val[i];
+                if(update0 > eps){
+                    MYINT k;
+                    #pragma omp atomic capture
+                    k = nnext++;
+                    next[k] = idx;
+                } else {
+                    nodemask_clear_atomic(inlist, idx);
+                    list[i] = -1 - idx;
+                }
+            }
+
+            #pragma omp single
+            ncarry = nnext;
+
+            // 3. 收敛节点的邻点若不在列表中且走时可以减小，加入列表，新走时暂存于val。
+            //    多个收敛节点有同一邻点时只有一个线程能加入它，由于走时场不变，得到的新走时相同
+            #pragma omp for schedule(static)
+            for(MYINT i=0; i<nlist; ++i){
+                if(list[i] >= 0)  continue;
+                MYINT idx = -1 - list[i];
+                MYINT ir, it, ip;
+                grid_unravel(&lay, idx, &ir, &it, &ip);
+                for(MYINT d=0; d<6; ++d){
+                    if(! fim_has_neighbour(&g, ir, it, ip, d))  continue;
+                    MYINT jdx = idx + g.dnb[d];
+                    if(nodemask_get(inlist, jdx))  continue;
+                    MYREAL travt = fim_local_update(&g, TT, jdx);
+                    if(travt >= TT[jdx])  continue;
+                    if(nodemask_set_atomic(inlist, jdx))  continue;
+                    MYINT k;
+                    #pragma omp atomic capture
+                    k = nnext++;
+                    next[k] = jdx;
+                    val[k] = travt;
+                }
+            }
+
+            // 4. 写回新加入节点的走时
+            #pragma omp for schedule(static)
+            for(MYINT k=ncarry; k<nnext; ++k){
+                TT[next[k]] = val[k];
+            }
+        }
+
+        MYINT *tmp = list;
+        list = next;
+        next = tmp;
+        MYINT tmpcap = listcap;
+        listcap = nextcap;
+        nextcap = tmpcap;
+        nlist = nnext;
+    }
+
+    if(printbar)  printf("FIM iterations: %ld\n", (long)niter);
+
+    for(MYINT i=0; i<nrtp; ++i){
+        nodestat_set(FMM_stat, i, (TT[i] < FIM_TT_UNREACHED)? FMM_ALV : FMM_FAR);
+    }
+
+    grid_layout_free(&lay);
+    free(list);
+    free(next);
+    free(val);
+    free(inlist);
+
+    return niter;
+}
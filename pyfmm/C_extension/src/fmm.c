@@ -11,8 +11,12 @@
 #include <math.h>
 #include <assert.h>
 #include <stddef.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "const.h"
 #include "interp.h"
@@ -21,57 +25,159 @@
 #include "mallocfree.h"
 #include "diff.h"
 #include "heapsort.h"
+#include "bucketqueue.h"
 #include "index.h"
+#include "layout.h"
+#include "nodestat.h"
 #include "progressbar.h"
 #include "fmm.h"
+#include "fmmdd.h"
+#include "fmmmq.h"
+#include "fmmgm.h"
 
 
 
-void FastMarching(
+bool fmm_workspace_inplace(MYINT fmmqueue, bool bricklayout){
+    return !bricklayout && fmmqueue!=FMM_QUEUE_GROUP;
+}
+
+
+void fmm_workspace_init(FMM_WORKSPACE *ws, MYINT nr, MYINT nt, MYINT np, MYINT fmmqueue, bool bricklayout, bool inplace){
+    MYINT nrtp = nr*nt*np;
+    ws->fmmqueue = fmmqueue;
+    ws->bricklayout = bricklayout;
+    ws->inplace = inplace && fmm_workspace_inplace(fmmqueue, bricklayout);
+    grid_layout_init(&ws->lay, nr, nt, np, bricklayout, (ws->inplace)? 0 : FMM_GHOST_LAYERS);
+
+    ws->FMM_stat = nodestat_alloc(nrtp);
+    ws->FMM_stat_lay = (ws->inplace)? NULL : nodestat_alloc(ws->lay.size);
+    ws->TT_lay = (ws->inplace)? NULL : (MYREAL *)malloc1d(ws->lay.size, sizeof(MYREAL));
+
+    ws->heapcap = nr*nt + nt*np + nr*np;
+    ws->FMM_data = (HEAP_DATA *)malloc1d(ws->heapcap, sizeof(HEAP_DATA));
+    // 桶队列和d叉堆不需要记录节点在堆中的位置
+    ws->NroIdx = (fmmqueue==FMM_QUEUE_HEAP)? (MYINT *)malloc1d(ws->lay.size, sizeof(MYINT)) : NULL;
+    // 确定顺序按需由调用者分配
+    ws->order = NULL;
+    ws->norder = 0;
+}
+
+
+void fmm_workspace_free(FMM_WORKSPACE *ws){
+    grid_layout_free(&ws->lay);
+    free(ws->FMM_stat);
+    free(ws->FMM_data);
+    if(ws->FMM_stat_lay!=NULL) free(ws->FMM_stat_lay);
+    if(ws->TT_lay!=NULL)       free(ws->TT_lay);
+    if(ws->NroIdx!=NULL)       free(ws->NroIdx);
+}
+
+
+/**
+ * 标记各接收点三次线性插值所用的8个节点，并统计其中尚未确定的节点数
+ * 
+ * @param     lay      (in)状态数组的排布方式
+ * @param     FMM_stat (in)源点附近初始化后的节点状态
+ * @param     rcvs     (in)形状为(nrcv, 3)的接收点坐标数组
+ * @param     nrcv     (in)接收点个数
+ * @param     pNstop   (out)标记的节点中未确定的节点数
+ * 
+ * @return    按lay排布的节点标记数组
+ */
+static NODE_MASK * receivers_stopmask(
+    const double *rs, MYINT nr, 
+    const double *ts, MYINT nt, 
+    const double *ps, MYINT np,
+    const GRID_LAYOUT *lay, const NODE_STAT *FMM_stat,
+    const double *rcvs, MYINT nrcv, MYINT *pNstop)
+{
+    NODE_MASK *stopmask = nodemask_alloc(lay->size);
+    MYINT IXYZ[6];
+    *pNstop = 0;
+    for(MYINT i=0; i<nrcv; ++i){
+        IXYZ[0] = 0; // 不外插
+        trilinear_one_fac(rs, nr, ts, nt, ps, np, rcvs[i*3], rcvs[i*3+1], rcvs[i*3+2], IXYZ, NULL);
+        for(MYINT a=0; a<2; ++a){
+        for(MYINT b=0; b<2; ++b){
+        for(MYINT c=0; c<2; ++c){
+            MYINT idx = grid_ravel(lay, IXYZ[a], IXYZ[2+b], IXYZ[4+c]);
+            if(nodemask_get(stopmask, idx)) continue;
+            nodemask_set(stopmask, idx);
+            if(nodestat_get(FMM_stat, idx) != FMM_ALV) (*pNstop)++;
+        }}}
+    }
+    return stopmask;
+}
+
+
+/**
+ * 从行优先排布的走时场中插值得到各接收点走时
+ */
+static void interp_receivers_TT(
+    const double *rs, MYINT nr, 
+    const double *ts, MYINT nt, 
+    const double *ps, MYINT np,
+    const MYREAL *TT, const double *rcvs, MYINT nrcv, MYREAL *rcvTT)
+{
+    for(MYINT i=0; i<nrcv; ++i){
+        rcvTT[i] = trilinear_one_ravel(
+            rs, nr, ts, nt, ps, np, nt*np, TT, 
+            rcvs[i*3], rcvs[i*3+1], rcvs[i*3+2], NULL, NULL, NULL, NULL, NULL);
+    }
+}
+
+
+void FastMarching_ws(
+    FMM_WORKSPACE *ws,
     const double *rs, MYINT nr, 
     const double *ts, MYINT nt, 
     const double *ps, MYINT np,
     double rr,  double tt, double pp,
-    MYINT maxodr,  const MYREAL *Slw, 
+    MYINT maxodr,  const MYREAL *Slw, const MYREAL *Slw_lay,
     MYREAL *TT, bool sphcoord, 
-    MYINT rfgfac, MYINT rfgn, bool printbar)
+    MYINT rfgfac, MYINT rfgn, bool printbar, bool isparallel, double tstop,
+    const double *rcvs, MYINT nrcv, MYREAL *rcvTT, bool useseeds)
 {
-    // 程序运行开始时间
-    struct timeval begin_t;
-    gettimeofday(&begin_t, NULL);
-
     MYINT ntp=nt*np;
     MYINT nrtp=nr*ntp;
-    MYINT Ndots=nrtp;
+    MYINT fmmqueue = ws->fmmqueue;
+    ws->Ndots = nrtp;
 
-    char *FMM_stat = (char *)malloc1d(nrtp, sizeof(char)); // 1 alive, 0 close, -1 far
+    NODE_STAT *FMM_stat = ws->FMM_stat; 
+    nodestat_fill(FMM_stat, nrtp, FMM_FAR);
 
-    MYINT heapsize=0, heapcapcity=nr*nt + nt*np + nr*np;
+    ws->heapsize = 0;
     MYINT *psize, *pcap;
-    psize = &heapsize;
-    pcap = &heapcapcity;
-    HEAP_DATA *FMM_data = (HEAP_DATA *)malloc1d(heapcapcity, sizeof(HEAP_DATA));
-    MYINT *NroIdx = (MYINT *)malloc1d(nrtp, sizeof(MYINT));
+    psize = &ws->heapsize;
+    pcap = &ws->heapcap;
+    HEAP_DATA *FMM_data = ws->FMM_data;
+    MYINT *NroIdx = ws->NroIdx;
 
     // All non-zero value of TT will be treated as efficient value,
     // and set FMM_CLS
     bool allzeroTT = true; 
-    for(MYINT i=0; i<nrtp; ++i){
-        if(TT[i] == 0.0){
-            TT[i] = 9.9e30f;// init FAR Traveltime 
-            FMM_stat[i] = FMM_FAR;
-        } else {
-            FMM_data = HeapPush(FMM_data, psize, pcap, i, NroIdx, TT);
-            FMM_stat[i] = FMM_CLS;
+    if(! useseeds){
+        for(MYINT i=0; i<nrtp; ++i)  TT[i] = 9.9e30f;
+    } 
+    else {
+        for(MYINT i=0; i<nrtp; ++i){
+            if(TT[i] == 0.0){
+                TT[i] = 9.9e30f;// init FAR Traveltime 
+            } else {
+                FMM_data = HeapPush(FMM_data, psize, pcap, i, NroIdx, TT);
+                nodestat_set(FMM_stat, i, FMM_CLS);
 
-            Ndots--;
-            allzeroTT = false;
+                ws->Ndots--;
+                allzeroTT = false;
+            }
         }
     }
 
 
     // if all zero in TT, then use rr, tt, pp
+    // multiqueue和分组推进只用于全局计算，加密网格中使用d叉堆
     if(allzeroTT){
+        MYINT rfgqueue = (fmmqueue==FMM_QUEUE_MULTI || fmmqueue==FMM_QUEUE_GROUP)? FMM_QUEUE_DHEAP : fmmqueue;
         if(rfgfac>1 && rfgn>=1){
             FMM_data = init_source_TT_refinegrid(
                 rs, nr, ts, nt, ps, np,
@@ -79,31 +185,217 @@ void FastMarching(
                 maxodr, Slw, TT, 
                 FMM_stat, sphcoord,
                 rfgfac, rfgn, printbar,
-                FMM_data, psize, pcap, NroIdx, &Ndots);
+                FMM_data, psize, pcap, NroIdx, &ws->Ndots, rfgqueue);
         } else {
             FMM_data = init_source_TT(
             rs, nr, ts, nt, ps, np, 
             rr, tt, pp,
             Slw, TT, 
             FMM_stat, sphcoord,
-            FMM_data, psize, pcap, NroIdx, &Ndots); 
+            FMM_data, psize, pcap, NroIdx, &ws->Ndots); 
         }
     }
      
     // print_FMM_HEAP(FMM_data, *psize, nr, nt, np, NroIdx, TT, NULL, NULL, NULL);
 
-    FMM_data = FastMarching_with_initial(
-        rs, nr, 
-        ts, nt, 
-        ps, np,
-        maxodr, Slw, TT,
-        FMM_stat, sphcoord, NULL, printbar,
-        FMM_data, psize, pcap, NroIdx, &Ndots);
+    if(isparallel){
+        FastMarching_dd(
+            rs, nr, ts, nt, ps, np, 
+            maxodr, Slw, TT, 
+            FMM_stat, sphcoord, 0, printbar);
+        ws->FMM_data = FMM_data;
+        if(rcvs!=NULL)  interp_receivers_TT(rs, nr, ts, nt, ps, np, TT, rcvs, nrcv, rcvTT);
+        return;
+    }
+
+    // 源点附近初始化完成后再转换为带幽灵层的内部排布，堆中的节点索引也相应转换。
+    // 幽灵节点（及分块的填充部分）设为走时9.9e30的alive节点，不会被更新，也不会用于差分模板。
+    // 行优先排布时直接在TT和状态数组上计算，不需要转换
+    const GRID_LAYOUT *lay = &ws->lay;
+    MYREAL *TT_lay = (ws->inplace)? TT : ws->TT_lay;
+    if(! ws->inplace){
+        grid_to_layout(lay, TT, TT_lay, 9.9e30f);
+
+        nodestat_fill(ws->FMM_stat_lay, lay->size, FMM_ALV);
+        grid_to_layout_stat(lay, FMM_stat, ws->FMM_stat_lay);
+        FMM_stat = ws->FMM_stat_lay;
+    }
+
+    // 节点走时不变，堆的顺序也不变
+    if(! ws->inplace){
+        MYINT ir, it, ip;
+        for(MYINT i=0; i<*psize; ++i){
+            unravel_index(FMM_data[i], ntp, np, &ir, &it, &ip);
+            FMM_data[i] = grid_ravel(lay, ir, it, ip);
+            if(NroIdx!=NULL) NroIdx[FMM_data[i]] = i;
+        }
+    }
+
+    // 标记接收点插值所需的节点，multiqueue中节点可能被重新打开，分组推进中组内节点确定后仍会更新，仍计算全局走时场
+    NODE_MASK *stopmask = NULL;
+    MYINT Nstop = 0;
+    if(rcvs!=NULL && fmmqueue!=FMM_QUEUE_MULTI && fmmqueue!=FMM_QUEUE_GROUP){
+        stopmask = receivers_stopmask(rs, nr, ts, nt, ps, np, lay, FMM_stat, rcvs, nrcv, &Nstop);
+    }
+
+    if(stopmask!=NULL && Nstop <= 0){
+        // 所需节点在源点附近初始化时已确定
+    }
+    else if(fmmqueue==FMM_QUEUE_MULTI){
+        FastMarching_mq(
+            rs, nr, 
+            ts, nt, 
+            ps, np,
+            maxodr, Slw_lay, TT_lay,
+            FMM_stat, sphcoord, 
+            FMM_data, *psize, ws->Ndots, lay, 0, printbar);
+    }
+    else if(fmmqueue==FMM_QUEUE_GROUP){
+        FastMarching_gm(
+            rs, nr, 
+            ts, nt, 
+            ps, np,
+            maxodr, Slw_lay, TT_lay,
+            FMM_stat, sphcoord, 
+            FMM_data, *psize, ws->Ndots, lay, 0, printbar);
+    } else {
+        FMM_data = FastMarching_with_initial(
+            rs, nr, 
+            ts, nt, 
+            ps, np,
+            maxodr, Slw_lay, TT_lay,
+            FMM_stat, sphcoord, NULL, printbar,
+            FMM_data, psize, pcap, NroIdx, &ws->Ndots, fmmqueue, lay, tstop, false, stopmask, &Nstop, ws->order, &ws->norder);
+    }
+
+    if(! ws->inplace)  grid_from_layout(lay, TT_lay, TT);
+
+    if(stopmask!=NULL) free(stopmask);
+    if(rcvs!=NULL)  interp_receivers_TT(rs, nr, ts, nt, ps, np, TT, rcvs, nrcv, rcvTT);
 
     // printf("done, Ndots=%d, size=%d\n", Ndots, *psize);
-    free(FMM_data);
-    free(FMM_stat);
-    free(NroIdx);
+    // 堆可能在计算中扩容
+    ws->FMM_data = FMM_data;
+}
+
+
+void FastMarching(
+    const double *rs, MYINT nr, 
+    const double *ts, MYINT nt, 
+    const double *ps, MYINT np,
+    double rr,  double tt, double pp,
+    MYINT maxodr,  const MYREAL *Slw, 
+    MYREAL *TT, bool sphcoord, 
+    MYINT rfgfac, MYINT rfgn, bool printbar, MYINT fmmqueue, bool bricklayout, bool isparallel,
+    const double *rcvs, MYINT nrcv, MYREAL *rcvTT)
+{
+    // 程序运行开始时间
+    struct timeval begin_t;
+    gettimeofday(&begin_t, NULL);
+
+    // 网格太小或只有一个线程时仍使用串行FMM
+    if(isparallel && fmmdd_ndomain(nr, maxodr, 0) <= 1)  isparallel = false;
+    if(isparallel)  bricklayout = false;
+
+    // 区域分解时工作空间只用于源点附近初始化，各子区域由状态数组重新建堆，
+    // 使用不记录堆中位置的d叉堆，也不需要带幽灵层的内部数组
+    FMM_WORKSPACE ws;
+    fmm_workspace_init(&ws, nr, nt, np, (isparallel)? FMM_QUEUE_DHEAP : fmmqueue, bricklayout, true);
+
+    MYREAL *Slw_lay = NULL;
+    if(! ws.inplace){
+        Slw_lay = (MYREAL *)malloc1d(ws.lay.size, sizeof(MYREAL));
+        grid_to_layout(&ws.lay, Slw, Slw_lay, Slw[0]);
+    }
+
+    FastMarching_ws(
+        &ws, rs, nr, ts, nt, ps, np, rr, tt, pp, 
+        maxodr, Slw, (ws.inplace)? Slw : Slw_lay, 
+        TT, sphcoord, rfgfac, rfgn, printbar, isparallel, -1.0, rcvs, nrcv, rcvTT, true);
+
+    if(Slw_lay!=NULL)  free(Slw_lay);
+    fmm_workspace_free(&ws);
+
+
+    // 程序运行结束时间
+    struct timeval end_t;
+    gettimeofday(&end_t, NULL);
+    if(printbar) printf("Runtime: %.3f s\n", (end_t.tv_sec - begin_t.tv_sec) + (end_t.tv_usec - begin_t.tv_usec) / 1e6);
+    fflush(stdout);
+}
+
+
+void FastMarching_batch(
+    const double *rs, MYINT nr, 
+    const double *ts, MYINT nt, 
+    const double *ps, MYINT np,
+    const double *srcs, MYINT nsrc,
+    MYINT maxodr,  const MYREAL *Slw, 
+    MYREAL *TTs, bool sphcoord, 
+    MYINT rfgfac, MYINT rfgn, bool printbar, MYINT fmmqueue, bool bricklayout,
+    MYINT nthreads)
+{
+    // 程序运行开始时间
+    struct timeval begin_t;
+    gettimeofday(&begin_t, NULL);
+
+    MYINT nrtp = nr*nt*np;
+
+    // 源点间已经并行
+    if(fmmqueue==FMM_QUEUE_MULTI || fmmqueue==FMM_QUEUE_GROUP)  fmmqueue = FMM_QUEUE_DHEAP;
+
+    // 各源点共用同一份按工作空间排布的慢度场，行优先排布时直接使用Slw
+    const bool inplace = fmm_workspace_inplace(fmmqueue, bricklayout);
+    MYREAL *Slw_lay = NULL;
+    if(! inplace){
+        GRID_LAYOUT lay;
+        grid_layout_init(&lay, nr, nt, np, bricklayout, FMM_GHOST_LAYERS);
+        Slw_lay = (MYREAL *)malloc1d(lay.size, sizeof(MYREAL));
+        grid_to_layout(&lay, Slw, Slw_lay, Slw[0]);
+        grid_layout_free(&lay);
+    }
+
+    int nth = 1;
+#ifdef _OPENMP
+    nth = (nthreads > 0)? nthreads : omp_get_max_threads();
+#endif
+    if(nth > nsrc) nth = (nsrc > 0)? nsrc : 1;
+
+    MYINT ndone = 0;
+
+    #pragma omp parallel num_threads(nth) default(shared)
+    {
+        // 每个线程一份工作空间，在该线程分到的所有源点间重复使用
+        FMM_WORKSPACE ws;
+        fmm_workspace_init(&ws, nr, nt, np, fmmqueue, bricklayout, inplace);
+
+        // 不同源点计算量差别较大（如是否加密网格），动态分配
+        #pragma omp for schedule(dynamic, 1)
+        for(MYINT isrc=0; isrc<nsrc; ++isrc){
+            double rr=0.0, tt=0.0, pp=0.0;
+            if(srcs!=NULL){
+                rr = srcs[isrc*3];
+                tt = srcs[isrc*3+1];
+                pp = srcs[isrc*3+2];
+            }
+            FastMarching_ws(
+                &ws, rs, nr, ts, nt, ps, np, rr, tt, pp, 
+                maxodr, Slw, (inplace)? Slw : Slw_lay, 
+                TTs + isrc*nrtp, sphcoord, rfgfac, rfgn, false, false, -1.0, NULL, 0, NULL, true);
+
+            if(printbar){
+                #pragma omp critical(fmm_batch_bar)
+                {
+                    ndone++;
+                    printprogressBar("Fast Marching (batch)...  ", ndone*100/nsrc);
+                }
+            }
+        }
+
+        fmm_workspace_free(&ws);
+    }
+
+    if(Slw_lay!=NULL)  free(Slw_lay);
 
 
     // 程序运行结束时间
@@ -115,14 +407,134 @@ void FastMarching(
 
 
 
+FMM_STATE * FastMarching_bounded(
+    const double *rs, MYINT nr, 
+    const double *ts, MYINT nt, 
+    const double *ps, MYINT np,
+    double rr,  double tt, double pp,
+    MYINT maxodr,  const MYREAL *Slw, 
+    MYREAL *TT, bool sphcoord, 
+    MYINT rfgfac, MYINT rfgn, bool printbar, MYINT fmmqueue, bool bricklayout,
+    double tmax, MYINT *pnfront)
+{
+    // 并行队列中已确定的节点可能被修正，不能中途停止
+    if(fmmqueue==FMM_QUEUE_MULTI || fmmqueue==FMM_QUEUE_GROUP)  fmmqueue = FMM_QUEUE_DHEAP;
+
+    FMM_STATE *st = (FMM_STATE *)malloc1d(1, sizeof(FMM_STATE));
+    st->nr = nr;
+    st->nt = nt;
+    st->np = np;
+    st->rs = (double *)malloc1d(nr, sizeof(double));
+    st->ts = (double *)malloc1d(nt, sizeof(double));
+    st->ps = (double *)malloc1d(np, sizeof(double));
+    for(MYINT i=0; i<nr; ++i)  st->rs[i] = rs[i];
+    for(MYINT i=0; i<nt; ++i)  st->ts[i] = ts[i];
+    for(MYINT i=0; i<np; ++i)  st->ps[i] = ps[i];
+    st->maxodr = maxodr;
+    st->sphcoord = sphcoord;
+
+    // 之后继续计算时需要保留内部走时场和状态数组
+    fmm_workspace_init(&st->ws, nr, nt, np, fmmqueue, bricklayout, false);
+    st->Slw_lay = (MYREAL *)malloc1d(st->ws.lay.size, sizeof(MYREAL));
+    grid_to_layout(&st->ws.lay, Slw, st->Slw_lay, Slw[0]);
+
+    // 走时场和状态数组保留在工作空间中，在多次调用间保留
+    FastMarching_ws(
+        &st->ws, st->rs, nr, st->ts, nt, st->ps, np, rr, tt, pp, 
+        maxodr, Slw, st->Slw_lay, 
+        TT, sphcoord, rfgfac, rfgn, printbar, false, tmax, NULL, 0, NULL, true);
+
+    *pnfront = st->ws.heapsize;
+    return st;
+}
+
+
+MYINT FastMarching_resume(FMM_STATE *st, double tmax, MYREAL *TT, bool printbar)
+{
+    FMM_WORKSPACE *ws = &st->ws;
+    MYREAL *TT_lay = ws->TT_lay;
+    NODE_STAT *FMM_stat = ws->FMM_stat_lay;
+
+    if(ws->heapsize > 0){
+        ws->FMM_data = FastMarching_with_initial(
+            st->rs, st->nr, 
+            st->ts, st->nt, 
+            st->ps, st->np,
+            st->maxodr, st->Slw_lay, TT_lay,
+            FMM_stat, st->sphcoord, NULL, printbar,
+            ws->FMM_data, &ws->heapsize, &ws->heapcap, ws->NroIdx, &ws->Ndots, 
+            ws->fmmqueue, &ws->lay, tmax, false, NULL, NULL, NULL, NULL);
+    }
+
+    grid_from_layout(&ws->lay, TT_lay, TT);
+    return ws->heapsize;
+}
+
+
+void FastMarching_state_free(FMM_STATE *st)
+{
+    fmm_workspace_free(&st->ws);
+    free(st->rs);
+    free(st->ts);
+    free(st->ps);
+    free(st->Slw_lay);
+    free(st);
+}
+
+
+
+/**
+ * 根据网格间隔和慢度范围创建桶队列，并放入堆中已有的节点。
+ * 桶宽取最小的单个网格走时 hmin*smin，此时节点确定顺序的乱序带来的误差与一阶差分格式误差同量级；
+ * 环的跨度取最大的单个网格走时 hmax*smax，覆盖一次邻点更新可能的走时增量。
+ * 球坐标下 \f$ \theta, \phi \f$ 方向的间隔按最大半径计算，忽略极点和球心附近间隔的退化。
+ */
+static BUCKET_QUEUE * create_fmm_bucketqueue(
+    const double *rs, MYINT nr, double dr, double dt, double dp,
+    const MYREAL *Slw, MYINT nrtp, bool sphcoord, const MYREAL *TT,
+    const HEAP_DATA *FMM_data, MYINT size)
+{
+    MYREAL smin=Slw[0], smax=Slw[0];
+    for(MYINT i=1; i<nrtp; ++i){
+        if(smin > Slw[i]) smin = Slw[i];
+        if(smax < Slw[i]) smax = Slw[i];
+    }
+
+    double rmax = (sphcoord)? fabs(rs[nr-1]) : 1.0;
+    if(sphcoord && rmax < fabs(rs[0])) rmax = fabs(rs[0]);
+    double harr[3] = {fabs(dr), fabs(dt)*rmax, fabs(dp)*rmax};
+    double hmin=-1.0, hmax=0.0;
+    for(MYINT k=0; k<3; ++k){
+        if(harr[k] <= 0.0) continue;
+        if(hmin < 0.0 || hmin > harr[k]) hmin = harr[k];
+        if(hmax < harr[k]) hmax = harr[k];
+    }
+    if(hmin < 0.0) hmin = hmax = 1.0;
+
+    MYREAL tmin=0.0, tmax=0.0;
+    for(MYINT i=0; i<size; ++i){
+        MYREAL t = TT[FMM_data[i]];
+        if(i==0 || tmin > t) tmin = t;
+        if(i==0 || tmax < t) tmax = t;
+    }
+
+    BUCKET_QUEUE *bq = BucketQueue_create(hmin*smin, hmax*smax + (tmax - tmin), tmin);
+    for(MYINT i=0; i<size; ++i){
+        BucketPush(bq, FMM_data[i], TT);
+    }
+    return bq;
+}
+
 
 HEAP_DATA * FastMarching_with_initial(
     const double *rs, MYINT nr, 
     const double *ts, MYINT nt, 
     const double *ps, MYINT np,
     MYINT maxodr,  const MYREAL *Slw, MYREAL *TT, 
-    char *FMM_stat, bool sphcoord, bool *edgeStop, bool printbar,
-    HEAP_DATA *FMM_data, MYINT *psize, MYINT *pcap, MYINT *NroIdx, MYINT *pNdots)
+    NODE_STAT *FMM_stat, bool sphcoord, bool *edgeStop, bool printbar,
+    HEAP_DATA *FMM_data, MYINT *psize, MYINT *pcap, MYINT *NroIdx, MYINT *pNdots,
+    MYINT fmmqueue, const GRID_LAYOUT *lay, double tstop, bool reopen,
+    const NODE_MASK *stopmask, MYINT *pNstop, MYINT *order, MYINT *pnorder)
 {
     double dr = (nr>1)? rs[1] - rs[0] : 0.0;
     double dt = (nt>1)? ts[1] - ts[0] : 0.0;
@@ -144,6 +556,28 @@ HEAP_DATA * FastMarching_with_initial(
 
     MYINT ntp=nt*np;
 
+    // 未指定排布时使用行优先排布
+    GRID_LAYOUT lay0;
+    if(lay==NULL){
+        grid_layout_init(&lay0, nr, nt, np, false, 0);
+        lay = &lay0;
+    }
+
+    // 使用桶队列或d叉堆时，将堆中已有的节点移入其中
+    BUCKET_QUEUE *bq = NULL;
+    DARY_HEAP *dh = NULL;
+    if(fmmqueue==FMM_QUEUE_BUCKET){
+        bq = create_fmm_bucketqueue(rs, nr, dr, dt, dp, Slw, lay->size, sphcoord, TT, FMM_data, *psize);
+        *psize = 0;
+    } 
+    else if(fmmqueue==FMM_QUEUE_DHEAP){
+        dh = DHeap_create(*pcap);
+        for(MYINT i=0; i<*psize; ++i){
+            DHeapPush(dh, FMM_data[i], TT[FMM_data[i]], NULL);
+        }
+        *psize = 0;
+    }
+
     HEAP_DATA popdata, newdata;
     MYINT ir0, it0, ip0, ir, it, ip;
     MYINT idx, idx0;
@@ -151,24 +585,57 @@ HEAP_DATA * FastMarching_with_initial(
     MYREAL travt_bak, travt, travt0, travt1;
     double h;
 
-    MYREAL *pt;
-    char *pstat;
+    char nstat;
+    // 有幽灵层时，alive的幽灵节点在邻点循环中被跳过，差分模板也在幽灵节点处停止，不需要检查索引范围
+    const bool padded = (lay->pad > 0);
+    const NEIGHBOUR_COEF_FUNC neighbour_coef = get_neighbour_coef_func(maxodr, padded);
+
+    // 一次出堆的候选邻点，及其二次方程系数和解
+    char k1;
+    MYINT nb;
+    MYINT bidx[6];
+    char bnstat[6];
+    MYREAL btravt1[6];
+    double bA[6], bB[6], bC[6], btravt[6];
 
     // 打印进度条时每隔print_interv打印一次
     MYINT size_bak = nr*ntp;
     MYINT last_barpercent = 0, barpercent;
 
     // printf("loop start, size=%d\n", *psize );
-    char travt_stat;
     MYREAL maxtravt=-999;
-    while(*psize > 0){
+    while((bq!=NULL)? bq->size > 0 : (dh!=NULL)? dh->size > 0 : *psize > 0){
 
         // get the minimum one 
-        popdata = HeapPop(FMM_data, psize, NroIdx, TT);
+        if(bq!=NULL){
+            popdata = BucketPop(bq);
+            // 跳过重复入队的节点
+            if(nodestat_get(FMM_stat, popdata) == FMM_ALV) continue;
+        } 
+        else if(dh!=NULL){
+            popdata = DHeapPop(dh, NULL, NULL);
+            if(nodestat_get(FMM_stat, popdata) == FMM_ALV) continue;
+        } 
+        else {
+            popdata = HeapPop(FMM_data, psize, NroIdx, TT);
+        }
+
+        // 超过截止走时，放回队列后结束。桶内节点不按走时排序，桶队列在整个桶超过截止走时后才结束
+        if(tstop > 0.0 && ((bq!=NULL)? bq->tbase > tstop : TT[popdata] > tstop)){
+            if(bq!=NULL)       BucketPush(bq, popdata, TT);
+            else if(dh!=NULL)  DHeapPush(dh, popdata, TT[popdata], NULL);
+            else               FMM_data = HeapPush(FMM_data, psize, pcap, popdata, NroIdx, TT);
+            break;
+        }
+
         idx0 = popdata;
-        FMM_stat[idx0] = FMM_ALV;
+        // 重新打开的节点，其走时修正可以继续传播给已确定的邻点
+        bool dirty = reopen && (nodestat_get(FMM_stat, idx0) == FMM_RCL);
+        nodestat_set(FMM_stat, idx0, FMM_ALV);
+        if(stopmask!=NULL && nodemask_get(stopmask, idx0))  (*pNstop)--;
+        if(order!=NULL)  order[(*pnorder)++] = idx0;
 
-        unravel_index(idx0, ntp, np, &ir0, &it0, &ip0);
+        grid_unravel(lay, idx0, &ir0, &it0, &ip0);
         travt0 = TT[idx0];
 
         // break loop in advance when reach the boundary
@@ -179,8 +646,11 @@ HEAP_DATA * FastMarching_with_initial(
 
         
 
-        if(travt0 > maxtravt) maxtravt = travt0;
-        else if(travt0 < maxtravt){
+        if(dirty) {
+            // 修正的走时不参与顺序检查
+        }
+        else if(travt0 > maxtravt) maxtravt = travt0;
+        else if(bq==NULL && travt0 < maxtravt){
             // 当在源点附近使用加密网格时，由于需要使用一般方法初始化源点附近的走时，
             printf("pNdots=%d, WRONG! travt0(%f) < maxtravt(%f) \n", *pNdots, travt0, maxtravt);
             print_HEAP(FMM_data, *psize, nr, nt, np, NroIdx, TT, NULL, NULL, NULL);
@@ -188,88 +658,126 @@ HEAP_DATA * FastMarching_with_initial(
         } 
 
         // get neighbours (max 6)
-        for(char k=0; k<6; ++k){
-            
-            ir = ir0 + xr[k];
-            it = it0 + xt[k];
-            ip = ip0 + xp[k];
-
-            
-            if(ir<0 || ir>nr-1) continue;
-            if(it<0 || it>nt-1) continue;
-            if(ip<0 || ip>np-1) continue;
-            
-            ravel_index(&idx, ntp, np, ir, it, ip);
-            // idx6_bak[k] = idx;
-
-            pstat = FMM_stat+idx;
-            // skip alive point 
-            if(*pstat == FMM_ALV) continue;
-
-            if(k<2){
-                h = dr;
-            } else if(k<4){
-                h = dt;
-                if(sphcoord) h *= rs[ir];
-            } else if(k<6){
-                h = dp;
-                if(sphcoord) h *= rs[ir]*sin_ts[it];
-            } else {
-                fprintf(stderr, "BAD interval h\n");
-                exit(EXIT_FAILURE);
-            }
+        // 先收集所有候选邻点的差分模板，再一起求解二次方程，最后依次更新。
+        // 重新打开的节点逐个处理，因为被修正的alive邻点会变为RCL，影响其余邻点的差分模板
+        for(char k0=0; k0<6; k0=k1){
+            k1 = (dirty)? k0+1 : 6;
+            nb = 0;
+            for(char k=k0; k<k1; ++k){
+                
+                ir = ir0 + xr[k];
+                it = it0 + xt[k];
+                ip = ip0 + xp[k];
+
+                // 重新打开的节点会修正alive邻点，仍需排除幽灵节点
+                if(!padded || dirty){
+                    if(ir<0 || ir>nr-1) continue;
+                    if(it<0 || it>nt-1) continue;
+                    if(ip<0 || ip>np-1) continue;
+                }
+                
+                idx = grid_ravel(lay, ir, it, ip);
+
+                nstat = nodestat_get(FMM_stat, idx);
+                // skip alive point 
+                if(nstat == FMM_ALV && !dirty) continue;
+
+                if(k<2){
+                    h = dr;
+                } else if(k<4){
+                    h = dt;
+                    if(sphcoord) h *= rs[ir];
+                } else if(k<6){
+                    h = dp;
+                    if(sphcoord) h *= rs[ir]*sin_ts[it];
+                } else {
+                    fprintf(stderr, "BAD interval h\n");
+                    exit(EXIT_FAILURE);
+                }
 
-            s = Slw[idx];
-            
-            travt1 = travt0 + h*s;
-            // compute traveltime
-            pt = TT+idx;
-            travt_bak = *pt;
-            if(travt1 < travt_bak)  *pt = travt1;
+                s = Slw[idx];
+                
+                // 以沿该方向的一阶走时与原走时的较小者作为试探走时
+                travt1 = travt0 + h*s;
+                travt_bak = (travt1 < TT[idx])? travt1 : TT[idx];
 
-            if(sphcoord){
-                travt = get_neighbour_travt(
-                    nr, nt, np, ntp,
-                    ir, it, ip, idx,
-                    maxodr, TT,
-                    FMM_stat, s, dr, dt*rs[ir], dp*rs[ir]*sin_ts[it], 
-                    &travt_stat);
-            } else {
-                travt = get_neighbour_travt(
-                    nr, nt, np, ntp,
-                    ir, it, ip, idx,
-                    maxodr, TT,
-                    FMM_stat, s, dr, dt, dp, 
-                    &travt_stat);
-            }
-            
-            // printf("k, travt, travt_bak = %d, %f, %f\n", k, travt, travt_bak);
-            *pt = travt_bak;
-            if(travt_stat<0 || travt<0) {
-                // printf("get_neighbour_travt failed, use the lazy one.\n");
-                travt = travt1;
+                if(sphcoord){
+                    neighbour_coef(
+                        lay,
+                        ir, it, ip, idx,
+                        maxodr, TT,
+                        FMM_stat, s, dr, dt*rs[ir], dp*rs[ir]*sin_ts[it], 
+                        travt_bak, &bA[nb], &bB[nb], &bC[nb]);
+                } else {
+                    neighbour_coef(
+                        lay,
+                        ir, it, ip, idx,
+                        maxodr, TT,
+                        FMM_stat, s, dr, dt, dp, 
+                        travt_bak, &bA[nb], &bB[nb], &bC[nb]);
+                }
+                bidx[nb] = idx;
+                bnstat[nb] = nstat;
+                btravt1[nb] = travt1;
+                nb++;
             }
 
-            // Forced Causality
-            if(travt < maxtravt) travt = maxtravt;
-
-            if(travt < TT[idx]){
-                // printf("get, travt, TT[idx] = %f, %f\n", travt, TT[idx]);
-                TT[idx] = travt;
+            solve_travt_batch(nb, bA, bB, bC, btravt);
 
-                if(*pstat == FMM_CLS){ // CLOSE
-                    MinHeap_AdjustUp(FMM_data, NroIdx[idx], NroIdx, TT);
-                }
-                else if(*pstat == FMM_FAR){ // FAR
-                    newdata= idx;
-                    FMM_data = HeapPush(FMM_data, psize, pcap, newdata, NroIdx, TT);
-                    *pstat = FMM_CLS;
-                    (*pNdots)--;
+            for(MYINT ib=0; ib<nb; ++ib){
+                idx = bidx[ib];
+                nstat = bnstat[ib];
+                travt = btravt[ib];
+                if(travt<0) {
+                    // printf("get_neighbour_travt failed, use the lazy one.\n");
+                    travt = btravt1[ib];
                 }
+
+                // Forced Causality
+                // 桶队列本身允许一个桶宽内的乱序，不再强制因果性
+                if(bq==NULL && !dirty && travt < maxtravt) travt = maxtravt;
+
+                // 已确定的节点只在走时明显减小时重新打开
+                if(nstat == FMM_ALV && travt >= TT[idx]*(1.0 - FMM_REOPEN_RTOL)) continue;
+
+                if(travt < TT[idx]){
+                    // printf("get, travt, TT[idx] = %f, %f\n", travt, TT[idx]);
+                    MYINT ib0 = (bq!=NULL)? BucketQueue_index(bq, TT[idx]) : 0;
+                    TT[idx] = travt;
+
+                    if(dirty) nodestat_set(FMM_stat, idx, FMM_RCL);
+
+                    if(nstat == FMM_CLS || nstat == FMM_RCL){ // CLOSE
+                        if(bq!=NULL){
+                            // 换桶时重复入队，原有元素在弹出时跳过
+                            if(BucketQueue_index(bq, travt) != ib0)  BucketPush(bq, idx, TT);
+                        } 
+                        else if(dh!=NULL){
+                            // 惰性删除，重复压入，原有元素在弹出时跳过
+                            DHeapPush(dh, idx, travt, NULL);
+                        }
+                        else {
+                            MinHeap_AdjustUp(FMM_data, NroIdx[idx], NroIdx, TT);
+                        } 
+                    }
+                    else { // FAR or reopened ALIVE
+                        newdata= idx;
+                        if(bq!=NULL){
+                            BucketPush(bq, newdata, TT);
+                        } 
+                        else if(dh!=NULL){
+                            DHeapPush(dh, newdata, travt, NULL);
+                        }
+                        else {
+                            FMM_data = HeapPush(FMM_data, psize, pcap, newdata, NroIdx, TT);
+                        }
+                        nodestat_set(FMM_stat, idx, (dirty)? FMM_RCL : FMM_CLS);
+                        if(nstat == FMM_FAR) (*pNdots)--;
+                    }
                 
+                }
+                // print_FMM_HEAP(FMM_data, *psize, nr, nt, np, NroIdx, TT, gTr, gTt, gTp);
             }
-            // print_FMM_HEAP(FMM_data, *psize, nr, nt, np, NroIdx, TT, gTr, gTt, gTp);
-
         } 
 
 
@@ -281,8 +789,28 @@ HEAP_DATA * FastMarching_with_initial(
             last_barpercent = barpercent;
         }
 
+        // 标记的节点均已确定，邻点已更新，堆中剩余节点可再次调用继续计算
+        if(stopmask!=NULL && *pNstop <= 0)  break;
+
     }
 
+    // 将桶队列或d叉堆中剩余的未确定节点移回堆中
+    if(bq!=NULL || dh!=NULL){
+        while((bq!=NULL)? bq->size > 0 : dh->size > 0){
+            popdata = (bq!=NULL)? BucketPop(bq) : DHeapPop(dh, NULL, NULL);
+            nstat = nodestat_get(FMM_stat, popdata);
+            if(nstat != FMM_CLS && nstat != FMM_RCL) continue;
+            FMM_data = HeapPush(FMM_data, psize, pcap, popdata, NroIdx, TT);
+            nodestat_set(FMM_stat, popdata, FMM_FAR); // 临时标记，避免重复节点多次入堆
+        }
+        for(MYINT i=0; i<*psize; ++i){
+            nodestat_set(FMM_stat, FMM_data[i], FMM_CLS);
+        }
+        if(bq!=NULL) BucketQueue_free(bq);
+        if(dh!=NULL) DHeap_free(dh);
+    }
+
+    if(lay==&lay0) grid_layout_free(&lay0);
 
     return FMM_data;
 }
@@ -297,7 +825,7 @@ HEAP_DATA * init_source_TT(
     const double *ps, MYINT np,
     double rr, double tt, double pp,
     const MYREAL *Slw, MYREAL *TT, 
-    char *FMM_stat, bool sphcoord,
+    NODE_STAT *FMM_stat, bool sphcoord,
     HEAP_DATA *FMM_data, MYINT *psize, MYINT *pcap, MYINT *NroIdx, MYINT *pNdots)
 {   
     MYINT ir, it, ip;
@@ -372,7 +900,7 @@ HEAP_DATA * init_source_TT(
                     FMM_data = HeapPush(FMM_data, psize, pcap, newdata, NroIdx, TT);
                 }
                 
-                if(FMM_stat!=NULL) FMM_stat[jdx] = FMM_CLS;
+                if(FMM_stat!=NULL) nodestat_set(FMM_stat, jdx, FMM_CLS);
                 // print_FMM_HEAP(FMM_data, *psize, nr, nt, np, NroIdx);
                 
                 if(pNdots!=NULL) (*pNdots)--;
@@ -387,7 +915,7 @@ HEAP_DATA * init_source_TT(
         popdata = HeapPop(FMM_data, psize, NroIdx, TT);
         midx = popdata;
     }
-    if(FMM_stat!=NULL) FMM_stat[midx] = FMM_ALV;
+    if(FMM_stat!=NULL) nodestat_set(FMM_stat, midx, FMM_ALV);
 
 
     unravel_index(midx, nt*np, np, &mir, &mit, &mip);
@@ -415,7 +943,7 @@ HEAP_DATA * init_source_TT(
 
                 ravel_index(&jdx, nt*np, np, jr, jt, jp);
 
-                if(FMM_stat!=NULL && FMM_stat[jdx] != FMM_FAR) continue;
+                if(FMM_stat!=NULL && nodestat_get(FMM_stat, jdx) != FMM_FAR) continue;
 
                 s = Slw[jdx];
                 
@@ -437,7 +965,7 @@ HEAP_DATA * init_source_TT(
                     FMM_data = HeapPush(FMM_data, psize, pcap, newdata, NroIdx, TT);
                 }
                 
-                if(FMM_stat!=NULL) FMM_stat[jdx] = FMM_CLS;
+                if(FMM_stat!=NULL) nodestat_set(FMM_stat, jdx, FMM_CLS);
                 // print_FMM_HEAP(FMM_data, *psize, nr, nt, np, NroIdx);
                 
                 if(pNdots!=NULL) (*pNdots)--;
@@ -458,10 +986,11 @@ HEAP_DATA * init_source_TT_refinegrid(
     const double *ps, MYINT np,
     double rr, double tt, double pp, 
     MYINT maxodr,  const MYREAL *Slw, MYREAL *TT, 
-    char *FMM_stat, bool sphcoord,
+    NODE_STAT *FMM_stat, bool sphcoord,
     MYINT rfgfac, MYINT rfgn, // refine grid factor and number of grids
     bool printbar,
-    HEAP_DATA *FMM_data, MYINT *psize, MYINT *pcap, MYINT *NroIdx, MYINT *pNdots)
+    HEAP_DATA *FMM_data, MYINT *psize, MYINT *pcap, MYINT *NroIdx, MYINT *pNdots,
+    MYINT fmmqueue)
 {   
     double dr = (nr>1)? rs[1] - rs[0] : 0.0;
     double dt = (nt>1)? ts[1] - ts[0] : 0.0;
@@ -527,12 +1056,11 @@ HEAP_DATA * init_source_TT_refinegrid(
 
     MYREAL *rfg_TT = (MYREAL *)malloc1d(rfg_nrtp, sizeof(MYREAL));
     MYREAL *rfg_Slw = (MYREAL *)malloc1d(rfg_nrtp, sizeof(MYREAL));
-    char *rfg_FMM_stat = (char *)malloc1d(rfg_nrtp, sizeof(char)); // 1 alive, 0 close, -1 far
+    NODE_STAT *rfg_FMM_stat = nodestat_alloc(rfg_nrtp); // 初始均为 far
     
     // 插值加密的慢度场
     for(MYINT i=0; i<rfg_nrtp; ++i){
         rfg_TT[i] = 9.9e30f;// init FAR Traveltime 
-        rfg_FMM_stat[i] = FMM_FAR;
 
         MYINT ir0, it0, ip0;
         unravel_index(i, rfg_ntp, rfg_np, &ir0, &it0, &ip0);
@@ -549,7 +1077,7 @@ HEAP_DATA * init_source_TT_refinegrid(
     prfg_size = &rfg_heapsize;
     prfg_cap = &rfg_heapcapcity;
     HEAP_DATA *rfg_FMM_data = (HEAP_DATA *)malloc1d(rfg_heapcapcity, sizeof(HEAP_DATA));
-    MYINT *rfg_NroIdx = (MYINT *)malloc1d(rfg_nrtp, sizeof(MYINT));
+    MYINT *rfg_NroIdx = (fmmqueue==FMM_QUEUE_HEAP)? (MYINT *)malloc1d(rfg_nrtp, sizeof(MYINT)) : NULL;
 
     rfg_FMM_data = init_source_TT(
         rfg_rs, rfg_nr, rfg_ts, rfg_nt, rfg_ps, rfg_np, 
@@ -572,7 +1100,7 @@ HEAP_DATA * init_source_TT_refinegrid(
         rfg_ps, rfg_np,
         maxodr, rfg_Slw, rfg_TT,
         rfg_FMM_stat, sphcoord, edgeStop, printbar, // break loop in advance
-        rfg_FMM_data, prfg_size, prfg_cap, rfg_NroIdx, &rfg_Ndots);
+        rfg_FMM_data, prfg_size, prfg_cap, rfg_NroIdx, &rfg_Ndots, fmmqueue, NULL, -1.0, false, NULL, NULL, NULL, NULL);
 
     // record result to main TT 
     for(MYINT jr=rfg_ir1, rfg_jr=0; jr<=rfg_ir2; ++jr, rfg_jr+=rfgfac){
@@ -584,7 +1112,7 @@ HEAP_DATA * init_source_TT_refinegrid(
             ravel_index(&jdx, ntp, np, jr, jt, jp);
             ravel_index(&rfg_jdx, rfg_ntp, rfg_np, rfg_jr, rfg_jt, rfg_jp);
 
-            if(rfg_FMM_stat[rfg_jdx] == FMM_FAR) continue;
+            if(nodestat_get(rfg_FMM_stat, rfg_jdx) == FMM_FAR) continue;
 
             // 将最外侧的节点加入堆
             if(jdx1<0) jdx1 = jdx;
@@ -592,16 +1120,16 @@ HEAP_DATA * init_source_TT_refinegrid(
 
             TT[jdx] = rfg_TT[rfg_jdx];
             // printf("rfg_TT = %f, jr, jt, jp %d, %d, %d\n", rfg_TT[rfg_jdx], jr, jt, jp);
-            FMM_stat[jdx] = FMM_ALV;
+            nodestat_set(FMM_stat, jdx, FMM_ALV);
             if(pNdots!=NULL) (*pNdots)--;
         }
         if(jdx1>=0){
             FMM_data = HeapPush(FMM_data, psize, pcap, jdx1, NroIdx, TT);
-            FMM_stat[jdx1] = FMM_CLS;
+            nodestat_set(FMM_stat, jdx1, FMM_CLS);
         }
         if(jdx2>=0 && jdx2!=jdx1){
             FMM_data = HeapPush(FMM_data, psize, pcap, jdx2, NroIdx, TT);
-            FMM_stat[jdx2] = FMM_CLS;
+            nodestat_set(FMM_stat, jdx2, FMM_CLS);
         }
 
     }}
@@ -613,7 +1141,8 @@ HEAP_DATA * init_source_TT_refinegrid(
     free(rfg_ps);
 
     free(rfg_FMM_data);
-    free(rfg_NroIdx);
+    free(rfg_FMM_stat);
+    if(rfg_NroIdx!=NULL) free(rfg_NroIdx);
 
 
     return FMM_data;
@@ -624,26 +1153,46 @@ HEAP_DATA * init_source_TT_refinegrid(
 
 
 MYREAL get_neighbour_travt(
-    MYINT nr, MYINT nt, MYINT np, MYINT ntp,
+    const GRID_LAYOUT *lay,
     MYINT ir, MYINT it, MYINT ip, MYINT idx,
     MYINT maxodr, MYREAL *TT,
-    char *FMM_stat,  double s,
+    const NODE_STAT *FMM_stat,  double s,
     double dr, double dt, double dp, 
     char *stat)
-{   
-    if(stat!=NULL) *stat = 0;
+{
+    return get_neighbour_travt_trial(
+        lay, ir, it, ip, idx, maxodr, TT, FMM_stat, s, dr, dt, dp, TT[idx], stat);
+}
+
 
+/**
+ * 收集节点各方向的差分模板，得到走时二次方程 A*T^2 - B*T + C = 0 的系数。
+ * maxodr为常量时，编译器可展开各方向的循环，
+ * 并删去 get_diff_odr123 中不会用到的分支，见 get_neighbour_travt_func 。
+ * padded为真时网格四周有幽灵层，模板遇到幽灵节点即停止，不再检查索引范围
+ */
+static inline void neighbour_travt_coef(
+    const GRID_LAYOUT *lay,
+    MYINT ir, MYINT it, MYINT ip, MYINT idx,
+    const MYINT maxodr, const bool padded, const MYREAL *TT,
+    const NODE_STAT *FMM_stat,  double s,
+    double dr, double dt, double dp, 
+    MYREAL t0, double *pA, double *pB, double *pC)
+{   
     double Acoef, Bcoef, Ccoef;
     Acoef = Bcoef = 0.0;
     Ccoef = - s*s;
 
     MYREAL tarr[5], tarrR[5], tarrT[5], tarrP[5]; // max(maxodr) = 3
-    tarr[0] = tarrR[0] = tarrT[0] = tarrP[0] = TT[idx];
+    tarr[0] = tarrR[0] = tarrT[0] = tarrP[0] = t0;
     MYINT odr, odrR, odrT, odrP;
     odr = odrR = odrT = odrP = 0;
 
-    MYINT jdx;
+    MYINT jdx, base;
+    MYREAL tprev;
     MYINT i;
+    MYINT nr = lay->nr, nt = lay->nt, np = lay->np;
+    const MYINT *offr = lay->offr, *offt = lay->offt, *offp = lay->offp;
 
     char sgn_r, sgn_t, sgn_p;
     sgn_r = sgn_t = sgn_p = 0;
@@ -652,21 +1201,26 @@ MYREAL get_neighbour_travt(
     double pos_acoef, neg_acoef, pos_bcoef, neg_bcoef;
     //------------------------------------------- R ---------------------------------------
     // --------------------------------------- negative -----------------------------------
+    base = idx - offr[ir];
+    tprev = t0;
     for(odr=0; odr<maxodr; ++odr){
-        if(ir-odr<1) break;
-        jdx = idx - (odr+1)*ntp;
-        if(FMM_stat[jdx]!=FMM_ALV) break;
+        if(!padded && (ir-odr<1)) break;
+        jdx = base + offr[ir-odr-1];
+        if(nodestat_get(FMM_stat, jdx)!=FMM_ALV) break;
         tarr[odr+1] = TT[jdx];
-        if(tarr[odr+1] >= TT[jdx+ntp]) break;
+        if(tarr[odr+1] >= tprev) break;
+        tprev = tarr[odr+1];
     }
     get_diff_odr123(odr, tarr, dr, &neg_acoef, &neg_bcoef, &neg_dif);
     // --------------------------------------- positive -----------------------------------
+    tprev = t0;
     for(odrR=0; odrR<maxodr; ++odrR){
-        if(ir+odrR+1>nr-1) break;
-        jdx = idx + (odrR+1)*ntp;
-        if(FMM_stat[jdx]!=FMM_ALV) break;
+        if(!padded && (ir+odrR+1>nr-1)) break;
+        jdx = base + offr[ir+odrR+1];
+        if(nodestat_get(FMM_stat, jdx)!=FMM_ALV) break;
         tarrR[odrR+1] = TT[jdx];
-        if(tarrR[odrR+1] >= TT[jdx-ntp]) break;
+        if(tarrR[odrR+1] >= tprev) break;
+        tprev = tarrR[odrR+1];
     }
     get_diff_odr123(odrR, tarrR, dr, &pos_acoef, &pos_bcoef, &pos_dif);
     // compare positive and negative 
@@ -691,21 +1245,26 @@ MYREAL get_neighbour_travt(
     
     //------------------------------------------- T ---------------------------------------
     // --------------------------------------- negative -----------------------------------
+    base = idx - offt[it];
+    tprev = t0;
     for(odr=0; odr<maxodr; ++odr){
-        if(it-odr<1) break;
-        jdx = idx - (odr+1)*np;
-        if(FMM_stat[jdx]!=FMM_ALV) break;
+        if(!padded && (it-odr<1)) break;
+        jdx = base + offt[it-odr-1];
+        if(nodestat_get(FMM_stat, jdx)!=FMM_ALV) break;
         tarr[odr+1] = TT[jdx];
-        if(tarr[odr+1] >= TT[jdx+np]) break;
+        if(tarr[odr+1] >= tprev) break;
+        tprev = tarr[odr+1];
     }
     get_diff_odr123(odr, tarr, dt, &neg_acoef, &neg_bcoef, &neg_dif);
     // --------------------------------------- positive -----------------------------------
+    tprev = t0;
     for(odrT=0; odrT<maxodr; ++odrT){
-        if(it+odrT+1>nt-1) break;
-        jdx = idx + (odrT+1)*np;
-        if(FMM_stat[jdx]!=FMM_ALV) break;
+        if(!padded && (it+odrT+1>nt-1)) break;
+        jdx = base + offt[it+odrT+1];
+        if(nodestat_get(FMM_stat, jdx)!=FMM_ALV) break;
         tarrT[odrT+1] = TT[jdx];
-        if(tarrT[odrT+1] >= TT[jdx-np]) break;
+        if(tarrT[odrT+1] >= tprev) break;
+        tprev = tarrT[odrT+1];
     }
     get_diff_odr123(odrT, tarrT, dt, &pos_acoef, &pos_bcoef, &pos_dif);
     // compare positive and negative 
@@ -732,21 +1291,26 @@ MYREAL get_neighbour_travt(
 
     //------------------------------------------- P ---------------------------------------
     // --------------------------------------- negative -----------------------------------
+    base = idx - offp[ip];
+    tprev = t0;
     for(odr=0; odr<maxodr; ++odr){
-        if(ip-odr<1) break;
-        jdx = idx - (odr+1);
-        if(FMM_stat[jdx]!=FMM_ALV) break;
+        if(!padded && (ip-odr<1)) break;
+        jdx = base + offp[ip-odr-1];
+        if(nodestat_get(FMM_stat, jdx)!=FMM_ALV) break;
         tarr[odr+1] = TT[jdx];
-        if(tarr[odr+1] >= TT[jdx+1]) break;
+        if(tarr[odr+1] >= tprev) break;
+        tprev = tarr[odr+1];
     }
     get_diff_odr123(odr, tarr, dp, &neg_acoef, &neg_bcoef, &neg_dif);
     // --------------------------------------- positive -----------------------------------
+    tprev = t0;
     for(odrP=0; odrP<maxodr; ++odrP){
-        if(ip+odrP+1>np-1) break;
-        jdx = idx + (odrP+1);
-        if(FMM_stat[jdx]!=FMM_ALV) break;
+        if(!padded && (ip+odrP+1>np-1)) break;
+        jdx = base + offp[ip+odrP+1];
+        if(nodestat_get(FMM_stat, jdx)!=FMM_ALV) break;
         tarrP[odrP+1] = TT[jdx];
-        if(tarrP[odrP+1] >= TT[jdx-1]) break;
+        if(tarrP[odrP+1] >= tprev) break;
+        tprev = tarrP[odrP+1];
     }
     get_diff_odr123(odrP, tarrP, dp, &pos_acoef, &pos_bcoef, &pos_dif);
     // compare positive and negative 
@@ -769,13 +1333,20 @@ MYREAL get_neighbour_travt(
     Acoef += acoef*acoef;
     Bcoef += 2*acoef*bcoef;
     Ccoef += bcoef*bcoef;
-    
 
+    *pA = Acoef;
+    *pB = Bcoef;
+    *pC = Ccoef;
+}
 
 
-    //--------------------------------------------------
-    // solve second-order equation with one unknown
-    // (A*T^2 - B*T + C = 0)
+/**
+ * 求解走时二次方程 A*T^2 - B*T + C = 0 的较大根，系数退化时返回-1，并将stat置为-1
+ */
+static inline MYREAL solve_travt_quadratic(double Acoef, double Bcoef, double Ccoef, char *stat)
+{
+    if(stat!=NULL) *stat = 0;
+
     double jdg = Bcoef*Bcoef - 4*Acoef*Ccoef;
     if(jdg <= 0.0) jdg = 0.0;
     if(fabs(Acoef)<1e-10 || fabs(Bcoef)<1e-10){
@@ -802,10 +1373,160 @@ MYREAL get_neighbour_travt(
 }
 
 
+/**
+ * get_neighbour_travt_trial 的实现
+ */
+static inline MYREAL neighbour_travt_kernel(
+    const GRID_LAYOUT *lay,
+    MYINT ir, MYINT it, MYINT ip, MYINT idx,
+    const MYINT maxodr, const bool padded, const MYREAL *TT,
+    const NODE_STAT *FMM_stat,  double s,
+    double dr, double dt, double dp, 
+    MYREAL t0, char *stat)
+{
+    double Acoef, Bcoef, Ccoef;
+    neighbour_travt_coef(lay, ir, it, ip, idx, maxodr, padded, TT, FMM_stat, s, dr, dt, dp, t0, &Acoef, &Bcoef, &Ccoef);
+    return solve_travt_quadratic(Acoef, Bcoef, Ccoef, stat);
+}
+
+
+MYREAL get_neighbour_travt_trial(
+    const GRID_LAYOUT *lay,
+    MYINT ir, MYINT it, MYINT ip, MYINT idx,
+    MYINT maxodr, const MYREAL *TT,
+    const NODE_STAT *FMM_stat,  double s,
+    double dr, double dt, double dp, 
+    MYREAL t0, char *stat)
+{
+    return neighbour_travt_kernel(
+        lay, ir, it, ip, idx, maxodr, false, TT, FMM_stat, s, dr, dt, dp, t0, stat);
+}
 
 
+/**
+ * 生成差分阶数固定为ODR的 get_neighbour_travt_trial ，参数maxodr不再使用，
+ * 后缀为pad的版本不检查索引范围
+ */
+#define DEFINE_NEIGHBOUR_TRAVT_ODR(ODR, PAD, SUFFIX) \
+static MYREAL get_neighbour_travt_odr##ODR##SUFFIX( \
+    const GRID_LAYOUT *lay, \
+    MYINT ir, MYINT it, MYINT ip, MYINT idx, \
+    MYINT maxodr, const MYREAL *TT, \
+    const NODE_STAT *FMM_stat,  double s, \
+    double dr, double dt, double dp, \
+    MYREAL t0, char *stat) \
+{ \
+    return neighbour_travt_kernel( \
+        lay, ir, it, ip, idx, ODR, PAD, TT, FMM_stat, s, dr, dt, dp, t0, stat); \
+}
 
-MYREAL FMM_raytracing(
+DEFINE_NEIGHBOUR_TRAVT_ODR(1, false, )
+DEFINE_NEIGHBOUR_TRAVT_ODR(2, false, )
+DEFINE_NEIGHBOUR_TRAVT_ODR(3, false, )
+DEFINE_NEIGHBOUR_TRAVT_ODR(1, true, _pad)
+DEFINE_NEIGHBOUR_TRAVT_ODR(2, true, _pad)
+DEFINE_NEIGHBOUR_TRAVT_ODR(3, true, _pad)
+
+#undef DEFINE_NEIGHBOUR_TRAVT_ODR
+
+
+NEIGHBOUR_TRAVT_FUNC get_neighbour_travt_func(MYINT maxodr, bool padded)
+{
+    switch(maxodr){
+        case 1:  return (padded)? get_neighbour_travt_odr1_pad : get_neighbour_travt_odr1;
+        case 2:  return (padded)? get_neighbour_travt_odr2_pad : get_neighbour_travt_odr2;
+        case 3:  return (padded)? get_neighbour_travt_odr3_pad : get_neighbour_travt_odr3;
+        default: return get_neighbour_travt_trial;
+    }
+}
+
+
+void get_neighbour_travt_coef(
+    const GRID_LAYOUT *lay,
+    MYINT ir, MYINT it, MYINT ip, MYINT idx,
+    MYINT maxodr, const MYREAL *TT,
+    const NODE_STAT *FMM_stat,  double s,
+    double dr, double dt, double dp, 
+    MYREAL t0, double *pA, double *pB, double *pC)
+{
+    neighbour_travt_coef(
+        lay, ir, it, ip, idx, maxodr, false, TT, FMM_stat, s, dr, dt, dp, t0, pA, pB, pC);
+}
+
+
+/**
+ * 生成差分阶数固定为ODR的 get_neighbour_travt_coef ，参数maxodr不再使用，
+ * 后缀为pad的版本不检查索引范围
+ */
+#define DEFINE_NEIGHBOUR_COEF_ODR(ODR, PAD, SUFFIX) \
+static void get_neighbour_travt_coef_odr##ODR##SUFFIX( \
+    const GRID_LAYOUT *lay, \
+    MYINT ir, MYINT it, MYINT ip, MYINT idx, \
+    MYINT maxodr, const MYREAL *TT, \
+    const NODE_STAT *FMM_stat,  double s, \
+    double dr, double dt, double dp, \
+    MYREAL t0, double *pA, double *pB, double *pC) \
+{ \
+    neighbour_travt_coef( \
+        lay, ir, it, ip, idx, ODR, PAD, TT, FMM_stat, s, dr, dt, dp, t0, pA, pB, pC); \
+}
+
+DEFINE_NEIGHBOUR_COEF_ODR(1, false, )
+DEFINE_NEIGHBOUR_COEF_ODR(2, false, )
+DEFINE_NEIGHBOUR_COEF_ODR(3, false, )
+DEFINE_NEIGHBOUR_COEF_ODR(1, true, _pad)
+DEFINE_NEIGHBOUR_COEF_ODR(2, true, _pad)
+DEFINE_NEIGHBOUR_COEF_ODR(3, true, _pad)
+
+#undef DEFINE_NEIGHBOUR_COEF_ODR
+
+
+NEIGHBOUR_COEF_FUNC get_neighbour_coef_func(MYINT maxodr, bool padded)
+{
+    switch(maxodr){
+        case 1:  return (padded)? get_neighbour_travt_coef_odr1_pad : get_neighbour_travt_coef_odr1;
+        case 2:  return (padded)? get_neighbour_travt_coef_odr2_pad : get_neighbour_travt_coef_odr2;
+        case 3:  return (padded)? get_neighbour_travt_coef_odr3_pad : get_neighbour_travt_coef_odr3;
+        default: return get_neighbour_travt_coef;
+    }
+}
+
+
+SIMD_CLONES
+void solve_travt_batch(
+    MYINT n, const double *restrict Acoef, const double *restrict Bcoef, 
+    const double *restrict Ccoef, double *restrict travt)
+{
+    // 与 solve_travt_quadratic 逐位相同，分支改为选择以便向量化
+    #pragma omp simd
+    for(MYINT i=0; i<n; ++i){
+        double A = Acoef[i], B = Bcoef[i];
+        double jdg = B*B - 4*A*Ccoef[i];
+        jdg = (jdg <= 0.0)? 0.0 : jdg;
+        double t = (B + sqrt(jdg))/(2.0*A);
+        travt[i] = (fabs(A)<1e-10 || fabs(B)<1e-10)? -1.0 : t;
+    }
+}
+
+
+
+
+
+/**
+ * FMM_raytracing 的实现。射线点从 (*prays)[3*off] 开始写入，grow为真时数组容量不足则扩容，
+ * 否则在容量处截断。点数(含源点)不超过maxdots
+ *
+ * @param     prays     (inout)射线点数组的指针，扩容时会改变
+ * @param     pcap      (inout)射线点数组的容量(点数)
+ * @param     off       (in)本条射线的起始点
+ * @param     grow      (in)容量不足时是否扩容
+ * @param     maxdots   (in)射线最大点数
+ * @param     N         (out)射线点数
+ * @param     ptrunc    (out)射线是否因点数达到上限被截断
+ *
+ * @return    射线走时
+ */
+static MYREAL raytracing_core(
     const double *rs, MYINT nr, 
     const double *ts, MYINT nt, 
     const double *ps, MYINT np,
@@ -813,8 +1534,10 @@ MYREAL FMM_raytracing(
     double rr, double tt, double pp, double seglen, double segfac,
     const MYREAL *Slw, const MYREAL *TT, bool sphcoord,
     // MYREAL *gTr, MYREAL *gTt, MYREAL *gTp, 
-    double *rays, MYINT *N)
+    double **prays, MYINT *pcap, MYINT off, bool grow, MYINT maxdots, MYINT *N, bool *ptrunc)
 {
+    double *rays = *prays + 3*off;
+    bool reached = false;
     double dr = (nr>1)? rs[1] - rs[0] : 1e-6;
     double dt = (nt>1)? ts[1] - ts[0] : 1e-6;
     double dp = (np>1)? ps[1] - ps[0] : 1e-6;
@@ -892,9 +1615,24 @@ MYREAL FMM_raytracing(
     // printf("%f, %f, %f, %f, \n", trem, gtr, gtt, gtp);
 
     //-------------------------------------------------------------------
-    MYINT N0 = *N;
+    MYINT N0 = maxdots;
     double dist;
     while(idot < N0-1){
+        // 保留最后一个点给源点
+        if(off+idot+2 > *pcap){
+            if(! grow) break;
+            MYINT newcap = 2*(*pcap);
+            if(newcap < off+idot+2) newcap = off+idot+2;
+            double *rays0 = realloc(*prays, sizeof(double)*3*newcap);
+            if(rays0==NULL){
+                fprintf(stderr, "reallocation failed in raytracing. exit.");
+                exit(EXIT_FAILURE);
+            }
+            *prays = rays0;
+            *pcap = newcap;
+            rays = *prays + 3*off;
+        }
+
         rays[3*idot] = r1;
         rays[3*idot+1] = t1;
         rays[3*idot+2] = p1;
@@ -902,7 +1640,10 @@ MYREAL FMM_raytracing(
         idot++;
 
         // if(dist <= limitdist) break;
-        if(trem <= limt) break;
+        if(trem <= limt){
+            reached = true;
+            break;
+        }
         
         // update
         seglen = seglen0;
@@ -1002,6 +1743,7 @@ MYREAL FMM_raytracing(
    
     idot++;
     *N = idot;
+    *ptrunc = !reached;
 
     if(Slw != NULL){
         return travt1;
@@ -1012,6 +1754,106 @@ MYREAL FMM_raytracing(
 }
 
 
+MYREAL FMM_raytracing(
+    const double *rs, MYINT nr, 
+    const double *ts, MYINT nt, 
+    const double *ps, MYINT np,
+    double r0, double t0, double p0,
+    double rr, double tt, double pp, double seglen, double segfac,
+    const MYREAL *Slw, const MYREAL *TT, bool sphcoord,
+    double *rays, MYINT *N)
+{
+    MYINT cap = *N;
+    bool trunc;
+    return raytracing_core(
+        rs, nr, ts, nt, ps, np, r0, t0, p0, rr, tt, pp, seglen, segfac, 
+        Slw, TT, sphcoord, &rays, &cap, 0, false, *N, N, &trunc);
+}
+
+
+MYINT FMM_raytracing_batch(
+    const double *rs, MYINT nr, 
+    const double *ts, MYINT nt, 
+    const double *ps, MYINT np,
+    double r0, double t0, double p0,
+    const double *rcvs, MYINT nrcv, double seglen, double segfac,
+    const MYREAL *Slw, const MYREAL *TT, bool sphcoord, MYINT maxdots, MYINT nthreads,
+    MYREAL *travt, MYINT *status, MYINT *offsets, double **prays)
+{
+    int nth = 1;
+#ifdef _OPENMP
+    nth = (nthreads > 0)? nthreads : omp_get_max_threads();
+#endif
+    if(maxdots < 2) maxdots = 2;
+
+    // 各线程先写入自己的数组，记录每条射线所在的线程和起始点，最后按接收点顺序拼接。
+    // 实际启动的线程可能少于nth，未启动线程的数组保持为NULL，射线也只会记录在已启动的线程上
+    double *bufs[nth];
+    for(int ith=0; ith<nth; ++ith)  bufs[ith] = NULL;
+    MYINT *rayth = (MYINT *)malloc1d(nrcv, sizeof(MYINT));
+    MYINT *raybeg = (MYINT *)malloc1d(nrcv, sizeof(MYINT));
+    MYINT ntp = nt*np;
+
+    #pragma omp parallel num_threads(nth) default(shared)
+    {
+        int ith = 0;
+#ifdef _OPENMP
+        ith = omp_get_thread_num();
+#endif
+        MYINT cap = 1024, used = 0, n;
+        bool trunc;
+        double *buf = (double *)malloc1d(3*cap, sizeof(double));
+
+        #pragma omp for schedule(dynamic, 16)
+        for(MYINT i=0; i<nrcv; ++i){
+            double rr = rcvs[3*i], tt = rcvs[3*i+1], pp = rcvs[3*i+2];
+            rayth[i] = ith;
+            raybeg[i] = used;
+            offsets[i+1] = 0;
+            travt[i] = 9.9e30;
+
+            if(rr < rs[0] || rr > rs[nr-1] || tt < ts[0] || tt > ts[nt-1] || pp < ps[0] || pp > ps[np-1]){
+                status[i] = FMM_RAY_OUTSIDE;
+                continue;
+            }
+            if(trilinear_one_ravel(rs, nr, ts, nt, ps, np, ntp, TT, rr, tt, pp, NULL, NULL, NULL, NULL, NULL) >= 9.9e30){
+                status[i] = FMM_RAY_UNREACHED;
+                continue;
+            }
+
+            travt[i] = raytracing_core(
+                rs, nr, ts, nt, ps, np, r0, t0, p0, rr, tt, pp, seglen, segfac, 
+                Slw, TT, sphcoord, &buf, &cap, used, true, maxdots, &n, &trunc);
+            status[i] = (trunc)? FMM_RAY_TRUNCATED : FMM_RAY_OK;
+            offsets[i+1] = n;
+            used += n;
+        }
+        bufs[ith] = buf;
+    }
+
+    offsets[0] = 0;
+    for(MYINT i=0; i<nrcv; ++i)  offsets[i+1] += offsets[i];
+
+    double *rays = (double *)malloc1d(3*((offsets[nrcv]>0)? offsets[nrcv] : 1), sizeof(double));
+    #pragma omp parallel for num_threads(nth) schedule(static) default(shared)
+    for(MYINT i=0; i<nrcv; ++i){
+        memcpy(rays + 3*offsets[i], bufs[rayth[i]] + 3*raybeg[i], sizeof(double)*3*(offsets[i+1] - offsets[i]));
+    }
+
+    for(int ith=0; ith<nth; ++ith)  free(bufs[ith]);
+    free(rayth);
+    free(raybeg);
+
+    *prays = rays;
+    return offsets[nrcv];
+}
+
+
+void FMM_rays_free(double *rays){
+    free(rays);
+}
+
+
 
 
 
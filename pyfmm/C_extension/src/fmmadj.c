@@ -0,0 +1,177 @@
+/**
+ * @file   fmmadj.c
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "const.h"
+#include "mallocfree.h"
+#include "index.h"
+#include "interp.h"
+#include "layout.h"
+#include "nodestat.h"
+#include "fmm.h"
+#include "fmmadj.h"
+#include "gradient.h"
+
+
+#define ADJ_UNREACHED  9.9e30f   ///< 未计算节点的走时
+#define ADJ_MAXINIT    64        ///< 源点附近初始化的节点数上限，2x2x2与3x3x3的立方体共35个
+
+
+/**
+ * 差分格式 \f$ aT-b \f$ 中b对上游各节点走时的导数乘以h，下标为(阶数-1, 上游第几个节点)，见 diff.h
+ */
+static const double adj_bcoef[3][3] = {
+    {1.0,  0.0,  0.0},
+    {2.0, -0.5,  0.0},
+    {3.0, -1.5,  1.0/3.0}};
+
+
+void FastMarching_adjoint(
+    const double *rs, MYINT nr,
+    const double *ts, MYINT nt,
+    const double *ps, MYINT np,
+    double rr,  double tt, double pp,
+    MYINT maxodr,  const MYREAL *Slw, MYREAL *TT,
+    bool sphcoord, const double *rcvs, MYINT nrcv,
+    const MYREAL *rcvTTobs, MYREAL *rcvTT, MYREAL *grad, bool printbar)
+{
+    MYINT ntp = nt*np;
+    MYINT nrtp = nr*ntp;
+    double dr = (nr>1)? rs[1] - rs[0] : 0.0;
+    double dt = (nt>1)? ts[1] - ts[0] : 0.0;
+    double dp = (np>1)? ps[1] - ps[0] : 0.0;
+
+    // convenient arrays
+    double sin_ts[nt];
+    if(sphcoord){
+        for(MYINT it=0; it<nt; ++it){
+            sin_ts[it] = fabs(sin(ts[it]));
+            if(sin_ts[it] < 1e-12) sin_ts[it] += 1e-12;
+        }
+    }
+
+    // 先借用TT记录源点附近初始化的走时，之后 FastMarching_ws 会重新填充TT
+    MYINT ninit = 0;
+    MYINT init_idx[ADJ_MAXINIT];
+    MYREAL init_TT[ADJ_MAXINIT];
+    for(MYINT i=0; i<nrtp; ++i)  TT[i] = ADJ_UNREACHED;
+    init_source_TT(rs, nr, ts, nt, ps, np, rr, tt, pp, Slw, TT, NULL, sphcoord, NULL, NULL, NULL, NULL, NULL);
+    for(MYINT i=0; i<nrtp && ninit<ADJ_MAXINIT; ++i){
+        if(TT[i] >= ADJ_UNREACHED)  continue;
+        init_idx[ninit] = i;
+        init_TT[ninit] = TT[i];
+        ninit++;
+    }
+
+    // 正演，记录节点的确定顺序
+    FMM_WORKSPACE ws;
+    // 反向扫描使用带幽灵层的内部走时场和状态数组
+    fmm_workspace_init(&ws, nr, nt, np, FMM_QUEUE_HEAP, false, false);
+    const GRID_LAYOUT *lay = &ws.lay;
+    ws.order = (MYINT *)malloc1d(lay->size, sizeof(MYINT));
+
+    MYREAL *Slw_lay = (MYREAL *)malloc1d(lay->size, sizeof(MYREAL));
+    grid_to_layout(lay, Slw, Slw_lay, Slw[0]);
+
+    FastMarching_ws(
+        &ws, rs, nr, ts, nt, ps, np, rr, tt, pp,
+        maxodr, Slw, Slw_lay,
+        TT, sphcoord, 0, 0, printbar, false, -1.0, rcvs, nrcv, rcvTT, false);
+
+    const MYREAL *TT_lay = ws.TT_lay;
+    const NODE_STAT *FMM_stat = ws.FMM_stat_lay;
+
+    // 初始化节点转为内部排布的索引
+    NODE_MASK *isinit = nodemask_alloc(lay->size);
+    MYINT midx = -1;
+    for(MYINT i=0; i<ninit; ++i){
+        MYINT ir, it, ip;
+        unravel_index(init_idx[i], ntp, np, &ir, &it, &ip);
+        // 初始化时直接确定的最小走时节点，不在确定顺序中
+        if(nodestat_get(ws.FMM_stat, init_idx[i]) == FMM_ALV)  midx = i;
+        init_idx[i] = grid_ravel(lay, ir, it, ip);
+        nodemask_set(isinit, init_idx[i]);
+    }
+
+    // 伴随方程的源项，即目标函数对接收点插值所用节点走时的导数
+    MYREAL *lam = (MYREAL *)calloc(lay->size, sizeof(MYREAL));
+    MYREAL *grad_lay = (MYREAL *)calloc(lay->size, sizeof(MYREAL));
+    MYINT IXYZ[6];
+    double WGHT[2][2][2];
+    for(MYINT i=0; i<nrcv; ++i){
+        MYREAL w = (rcvTTobs!=NULL)? rcvTT[i] - rcvTTobs[i] : 1.0;
+        IXYZ[0] = 0; // 不外插
+        trilinear_one_fac(rs, nr, ts, nt, ps, np, rcvs[i*3], rcvs[i*3+1], rcvs[i*3+2], IXYZ, WGHT);
+        for(MYINT a=0; a<2; ++a){
+        for(MYINT b=0; b<2; ++b){
+        for(MYINT c=0; c<2; ++c){
+            lam[grid_ravel(lay, IXYZ[a], IXYZ[2+b], IXYZ[4+c])] += w * WGHT[a][b][c];
+        }}}
+    }
+
+    // 按确定顺序的反向求解伴随方程，节点的乘子在其下游节点都处理后才确定
+    double h[3], dif[3], acoef[3];
+    char sgn[3];
+    MYINT odrs[3], jdxs[3][3];
+    for(MYINT n=ws.norder-1; n>=-1; --n){
+        MYINT idx;
+        if(n >= 0)  idx = ws.order[n];
+        else if(midx >= 0)  idx = init_idx[midx];
+        else  break;
+
+        MYREAL lk = lam[idx];
+        if(lk == 0.0)  continue;
+        MYREAL s = Slw_lay[idx];
+
+        // 源点附近初始化之后未被更新的节点，T = dist*s
+        if(nodemask_get(isinit, idx)){
+            MYINT i;
+            for(i=0; i<ninit && init_idx[i]!=idx; ++i);
+            if(TT_lay[idx] == init_TT[i]){
+                if(s != 0.0)  grad_lay[idx] += lk * TT_lay[idx] / s;
+                continue;
+            }
+        }
+
+        MYINT ir, it, ip;
+        grid_unravel(lay, idx, &ir, &it, &ip);
+        h[0] = dr;
+        h[1] = dt;
+        h[2] = dp;
+        if(sphcoord){
+            h[1] *= rs[ir];
+            h[2] *= rs[ir]*sin_ts[it];
+        }
+        upwind_stencil(lay, ir, it, ip, maxodr, TT_lay, FMM_stat, h, dif, acoef, sgn, odrs, jdxs);
+
+        // dF/dT_k = 2G, dF/ds_k = -2s, dF/dT_j = -2 dif * db/dT_j
+        double G = dif[0]*acoef[0] + dif[1]*acoef[1] + dif[2]*acoef[2];
+        if(G <= 0.0)  continue;
+
+        grad_lay[idx] += lk * s / G;
+        for(MYINT dim=0; dim<3; ++dim){
+            if(odrs[dim] == 0)  continue;
+            double fac = lk * dif[dim] / (G * h[dim]);
+            for(MYINT i=0; i<odrs[dim]; ++i){
+                lam[jdxs[dim][i]] += fac * adj_bcoef[odrs[dim]-1][i];
+            }
+        }
+    }
+
+    grid_from_layout(lay, grad_lay, grad);
+
+    free(lam);
+    free(grad_lay);
+    free(isinit);
+    free(Slw_lay);
+    free(ws.order);
+    fmm_workspace_free(&ws);
+}
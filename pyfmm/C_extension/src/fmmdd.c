@@ -0,0 +1,219 @@
+/**
+ * @file   fmmdd.c
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "const.h"
+#include "mallocfree.h"
+#include "heapsort.h"
+#include "layout.h"
+#include "nodestat.h"
+#include "progressbar.h"
+#include "fmm.h"
+#include "fmmdd.h"
+
+
+/**
+ * 子区域。局部数组只覆盖第 [lo, hi) 行，局部索引为全局索引减去 lo*nt*np
+ */
+typedef struct {
+    MYINT r0, r1;          ///< 拥有的维度1索引范围 [r0, r1)
+    MYINT lo, hi;          ///< 包括幽灵节点的维度1索引范围 [lo, hi)
+    GRID_LAYOUT lay;       ///< 局部行优先排布，各走时段共用
+    MYREAL *TT;            ///< 局部走时场
+    NODE_STAT *stat;       ///< 局部状态数组
+    HEAP_DATA *FMM_data;   ///< 局部堆
+    MYINT size, cap;       ///< 堆大小和容量
+    MYINT *NroIdx;         ///< 节点在局部堆中的位置
+    MYINT Ndots;           ///< 局部未计算的节点数
+} DD_SUBDOMAIN;
+
+
+/**
+ * 将相邻子区域 e 拥有的第 [ra, rb) 行走时导入子区域 d 的幽灵节点，走时明显减小的节点入堆。
+ * 行号为全局索引，分别减去两个子区域的起始行转换为各自的局部索引
+ */
+static void dd_import(DD_SUBDOMAIN *d, const DD_SUBDOMAIN *e, MYINT ra, MYINT rb, MYINT ntp){
+    for(MYINT gr=ra; gr<rb; ++gr){
+        const MYREAL *src = e->TT + (gr - e->lo)*ntp;
+        MYINT off = (gr - d->lo)*ntp;
+        for(MYINT j=0; j<ntp; ++j){
+            MYINT idx = off + j;
+            MYREAL v = src[j];
+            if(v >= d->TT[idx]*(1.0 - FMM_REOPEN_RTOL)) continue;
+
+            // 标记为重新打开，弹出时可以修正已确定的邻点
+            d->TT[idx] = v;
+            char st = nodestat_get(d->stat, idx);
+            if(st == FMM_CLS || st == FMM_RCL){
+                MinHeap_AdjustUp(d->FMM_data, d->NroIdx[idx], d->NroIdx, d->TT);
+            } else {
+                d->FMM_data = HeapPush(d->FMM_data, &d->size, &d->cap, idx, d->NroIdx, d->TT);
+                if(st == FMM_FAR) d->Ndots--;
+            }
+            nodestat_set(d->stat, idx, FMM_RCL);
+        }
+    }
+}
+
+
+MYINT fmmdd_ndomain(MYINT nr, MYINT maxodr, MYINT nthreads){
+    MYINT nd = 1;
+#ifdef _OPENMP
+    nd = (nthreads > 0)? nthreads : omp_get_max_threads();
+#endif
+    MYINT minrows = (maxodr > DDFMM_MIN_ROWS)? maxodr : DDFMM_MIN_ROWS;
+    if(nd > nr/minrows) nd = nr/minrows;
+    if(nd < 1) nd = 1;
+    return nd;
+}
+
+
+void FastMarching_dd(
+    const double *rs, MYINT nr, 
+    const double *ts, MYINT nt, 
+    const double *ps, MYINT np,
+    MYINT maxodr,  const MYREAL *Slw, MYREAL *TT, 
+    const NODE_STAT *FMM_stat, bool sphcoord, MYINT nthreads, bool printbar)
+{
+    MYINT ntp = nt*np;
+    MYINT nrtp = nr*ntp;
+    MYINT ng = (maxodr > 1)? maxodr : 1;  // 幽灵节点层数
+    MYINT nd = fmmdd_ndomain(nr, maxodr, nthreads);
+
+    // 走时段宽度
+    double dr = (nr>1)? rs[1] - rs[0] : 0.0;
+    double dt = (nt>1)? ts[1] - ts[0] : 0.0;
+    double dp = (np>1)? ps[1] - ps[0] : 0.0;
+    if(sphcoord){
+        dt *= rs[nr-1];
+        dp *= rs[nr-1];
+    }
+    double hmin = dr;
+    if(dt > 0.0 && dt < hmin) hmin = dt;
+    if(dp > 0.0 && dp < hmin) hmin = dp;
+    MYREAL smin = Slw[0];
+    for(MYINT i=1; i<nrtp; ++i){
+        if(Slw[i] < smin) smin = Slw[i];
+    }
+    double band = DDFMM_BAND_CELLS * hmin * smin;
+
+    DD_SUBDOMAIN *dd = (DD_SUBDOMAIN *)malloc1d(nd, sizeof(DD_SUBDOMAIN));
+    for(MYINT id=0; id<nd; ++id){
+        DD_SUBDOMAIN *d = dd + id;
+        d->r0 = nr*id/nd;
+        d->r1 = nr*(id+1)/nd;
+        d->lo = (d->r0 - ng > 0)? d->r0 - ng : 0;
+        d->hi = (d->r1 + ng < nr)? d->r1 + ng : nr;
+    }
+
+    double tband = 0.0;
+    bool done = false;
+    MYINT last_barpercent = 0;
+
+    // 一般每个线程负责一个子区域，实际线程数较少时依次负责多个
+    #pragma omp parallel num_threads(nd) default(shared)
+    {
+        MYINT tid = 0, nth = 1;
+#ifdef _OPENMP
+        tid = omp_get_thread_num();
+        nth = omp_get_num_threads();
+#endif
+        // 只复制子区域及其幽灵层内初始化后的走时和状态，close节点入堆
+        for(MYINT id=tid; id<nd; id+=nth){
+            DD_SUBDOMAIN *d = dd + id;
+            MYINT nloc = (d->hi - d->lo);
+            MYINT n = nloc*ntp;
+            grid_layout_init(&d->lay, nloc, nt, np, false, 0);
+            d->TT = (MYREAL *)malloc1d(n, sizeof(MYREAL));
+            d->stat = nodestat_alloc(n);
+            d->NroIdx = (MYINT *)malloc1d(n, sizeof(MYINT));
+            d->cap = nloc*nt + nt*np + nloc*np;
+            d->size = 0;
+            d->FMM_data = (HEAP_DATA *)malloc1d(d->cap, sizeof(HEAP_DATA));
+            d->Ndots = 0;
+            for(MYINT i=0; i<n; ++i){
+                MYINT gi = i + d->lo*ntp;
+                char st = nodestat_get(FMM_stat, gi);
+                d->TT[i] = TT[gi];
+                nodestat_set(d->stat, i, st);
+                if(st == FMM_CLS){
+                    d->FMM_data = HeapPush(d->FMM_data, &d->size, &d->cap, i, d->NroIdx, d->TT);
+                }
+                else if(st == FMM_FAR){
+                    d->Ndots++;
+                }
+            }
+        }
+
+        while(true){
+            // 确定下一走时段的上界，所有堆都为空时结束
+            #pragma omp barrier
+            #pragma omp single
+            {
+                double tmin = -1.0;
+                MYINT Ndots = 0;
+                for(MYINT k=0; k<nd; ++k){
+                    Ndots += dd[k].Ndots;
+                    if(dd[k].size == 0) continue;
+                    double t = dd[k].TT[dd[k].FMM_data[0]];
+                    if(tmin < 0.0 || t < tmin) tmin = t;
+                }
+                done = (tmin < 0.0);
+                if(!done)  tband = ((tmin > tband)? tmin : tband) + band;
+
+                MYINT barpercent = 100.0 - (double)Ndots / (double)nrtp * 100.0;
+                if(printbar && (barpercent != last_barpercent || done)){
+                    printprogressBar("Fast Marching (parallel)...  ", (done)? 100 : barpercent);
+                    last_barpercent = barpercent;
+                }
+            }
+            if(done) break;
+
+            for(MYINT id=tid; id<nd; id+=nth){
+                DD_SUBDOMAIN *d = dd + id;
+                d->FMM_data = FastMarching_with_initial(
+                    rs + d->lo, d->hi - d->lo, 
+                    ts, nt, 
+                    ps, np,
+                    maxodr, Slw + d->lo*ntp, d->TT,
+                    d->stat, sphcoord, NULL, false,
+                    d->FMM_data, &d->size, &d->cap, d->NroIdx, &d->Ndots, 
+                    FMM_QUEUE_HEAP, &d->lay, tband, true, NULL, NULL, NULL, NULL);
+            }
+
+            // 交换边界走时，只读相邻子区域拥有的节点，只写自身的幽灵节点
+            #pragma omp barrier
+            for(MYINT id=tid; id<nd; id+=nth){
+                DD_SUBDOMAIN *d = dd + id;
+                if(id > 0)     dd_import(d, dd+id-1, d->lo, d->r0, ntp);
+                if(id < nd-1)  dd_import(d, dd+id+1, d->r1, d->hi, ntp);
+            }
+        }
+
+        // 写回拥有的节点
+        for(MYINT id=tid; id<nd; id+=nth){
+            DD_SUBDOMAIN *d = dd + id;
+            for(MYINT i=(d->r0 - d->lo)*ntp; i<(d->r1 - d->lo)*ntp; ++i){
+                TT[i + d->lo*ntp] = d->TT[i];
+            }
+            grid_layout_free(&d->lay);
+            free(d->TT);
+            free(d->stat);
+            free(d->NroIdx);
+            free(d->FMM_data);
+        }
+    }
+
+    free(dd);
+}
@@ -0,0 +1,522 @@
+/**
+ * @file   fmmgm.c
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "const.h"
+#include "mallocfree.h"
+#include "heapsort.h"
+#include "layout.h"
+#include "nodestat.h"
+#include "progressbar.h"
+#include "fmm.h"
+#include "fmmgm.h"
+
+
+#define GM_UNREACHED  9.9e30f   ///< 未计算节点的走时
+
+
+// DON'T CHANGE.
+static const char xr[6] = {-1, 1,  0, 0,  0, 0};
+static const char xt[6] = { 0, 0, -1, 1,  0, 0};
+static const char xp[6] = { 0, 0,  0, 0, -1, 1};
+
+
+/**
+ * 更新节点时用到的网格信息
+ */
+typedef struct {
+    const GRID_LAYOUT *lay;                 ///< 带幽灵层的排布
+    NEIGHBOUR_TRAVT_FUNC neighbour_travt;   ///< 邻点走时更新函数
+    MYINT maxodr;                           ///< 使用的最大差分阶数
+    const MYREAL *Slw;                      ///< 慢度场
+    bool sphcoord;                          ///< 是否使用球坐标
+    const double *rs;                       ///< 维度1坐标数组
+    const double *sin_ts;                   ///< 维度2坐标的正弦绝对值，仅球坐标使用
+    double dr, dt, dp;                      ///< 各维度网格间距
+} GM_GRID;
+
+
+/**
+ * 节点处各维度的网格间距，球坐标下已乘以半径
+ */
+static inline void gm_spacing(const GM_GRID *g, MYINT ir, MYINT it, double h[3]){
+    h[0] = g->dr;
+    h[1] = g->dt;
+    h[2] = g->dp;
+    if(g->sphcoord){
+        h[1] *= g->rs[ir];
+        h[2] *= g->rs[ir]*g->sin_ts[it];
+    }
+}
+
+
+/**
+ * 节点处最小的非零网格间距与慢度的乘积，即走过一个网格的最短走时
+ */
+static MYREAL gm_cell_travt(const GM_GRID *g, MYINT idx){
+    MYINT ir, it, ip;
+    grid_unravel(g->lay, idx, &ir, &it, &ip);
+    double h[3];
+    gm_spacing(g, ir, it, h);
+    double hmin = GM_UNREACHED;
+    for(MYINT d=0; d<3; ++d){
+        double a = fabs(h[d]);
+        if(a > 0.0 && a < hmin)  hmin = a;
+    }
+    return hmin * g->Slw[idx];
+}
+
+
+/**
+ * 根据alive邻点计算一个节点的新走时，不修改走时场。
+ * 先由alive邻点中的最小走时得到走时上限，再以其与当前走时的较小值为试探走时调用差分格式
+ *
+ * @param     g         (in)网格信息
+ * @param     TT        (in)走时场
+ * @param     FMM_stat  (in)节点状态
+ * @param     idx       (in)展开后的索引
+ *
+ * @return    新走时，不大于当前走时
+ */
+static MYREAL gm_local_update(const GM_GRID *g, const MYREAL *TT, const NODE_STAT *FMM_stat, MYINT idx)
+{
+    MYINT ir, it, ip;
+    grid_unravel(g->lay, idx, &ir, &it, &ip);
+    double h[3];
+    gm_spacing(g, ir, it, h);
+
+    MYREAL slw = g->Slw[idx];
+    MYREAL t0 = TT[idx];
+    MYREAL t_bak = t0;
+    bool reached = false;
+    for(MYINT k=0; k<6; ++k){
+        MYINT jdx = grid_ravel(g->lay, ir+xr[k], it+xt[k], ip+xp[k]);
+        if(nodestat_get(FMM_stat, jdx) != FMM_ALV)  continue;
+        MYREAL T = TT[jdx];
+        if(T >= GM_UNREACHED)  continue;
+        reached = true;
+        MYREAL t_bak0 = T + h[k/2] * slw;
+        if(t_bak0 < t_bak)  t_bak = t_bak0;
+    }
+    if(! reached)  return t0;
+
+    char travt_stat;
+    MYREAL travt = g->neighbour_travt(
+        g->lay, ir, it, ip, idx, g->maxodr, TT,
+        FMM_stat, slw, h[0], h[1], h[2], t_bak, &travt_stat);
+
+    if(travt_stat>=0 && travt>0){
+        if(t_bak < travt) travt = t_bak;
+    } else {
+        travt = t_bak;
+    }
+
+    return (travt < t0)? travt : t0;
+}
+
+
+/**
+ * 波前中的元素
+ */
+typedef struct {
+    MYINT idx;     ///< 节点索引
+    MYREAL key;    ///< 入桶时的走时，用于扩充环时确定元素所在的桶
+    MYREAL c;      ///< 节点处走过一个网格的最短走时，见 gm_cell_travt
+} GM_ENTRY;
+
+
+/**
+ * 按走时分桶的波前，使每步只需检查走时最小的几个桶。
+ * 桶以绝对编号 k = floor((t - t0)/width) 存放在环中，早于当前桶的走时归入当前桶，环中桶个数为2的幂。
+ * 节点仍为close且当前走时仍对应元素所在的桶时，元素有效。
+ * 节点走时减小到更早的桶时重新入桶，旧元素过期，其所在的桶记为dirty，在用到时才清理；
+ * 清理后桶的bmin为桶内有效元素c的最小值，所有桶的最小值即为波前上c的最小值
+ */
+typedef struct {
+    MYINT nbkt;         ///< 环中桶个数
+    MYINT kcur;         ///< 当前桶的绝对编号
+    double t0;          ///< 编号为0的桶的走时下界
+    double rwidth;      ///< 桶宽（走时）的倒数
+    GM_ENTRY **data;    ///< 每个桶的元素数组
+    MYINT *bsize;       ///< 每个桶的元素个数
+    MYINT *bcap;        ///< 每个桶的容量
+    MYREAL *bmin;       ///< 每个桶内元素c的最小值，空桶为 GM_UNREACHED
+    bool *dirty;        ///< 桶内是否可能有过期元素
+} GM_BUCKETS;
+
+
+static void gm_buckets_alloc(GM_BUCKETS *b, MYINT nbkt){
+    b->nbkt = nbkt;
+    b->data = (GM_ENTRY **)malloc1d(nbkt, sizeof(GM_ENTRY *));
+    b->bsize = (MYINT *)malloc1d(nbkt, sizeof(MYINT));
+    b->bcap = (MYINT *)malloc1d(nbkt, sizeof(MYINT));
+    b->bmin = (MYREAL *)malloc1d(nbkt, sizeof(MYREAL));
+    b->dirty = (bool *)malloc1d(nbkt, sizeof(bool));
+    for(MYINT i=0; i<nbkt; ++i){
+        b->data[i] = NULL;
+        b->bsize[i] = b->bcap[i] = 0;
+        b->bmin[i] = GM_UNREACHED;
+        b->dirty[i] = false;
+    }
+}
+
+static void gm_buckets_free(GM_BUCKETS *b){
+    for(MYINT i=0; i<b->nbkt; ++i){
+        if(b->data[i]!=NULL) free(b->data[i]);
+    }
+    free(b->data);
+    free(b->bsize);
+    free(b->bcap);
+    free(b->bmin);
+    free(b->dirty);
+}
+
+/**
+ * 走时对应的桶的绝对编号，早于当前桶的走时归入当前桶
+ */
+static inline MYINT gm_bucket_key(const GM_BUCKETS *b, MYREAL t){
+    double k = floor((t - b->t0)*b->rwidth);
+    return (k < (double)b->kcur)? b->kcur : (MYINT)k;
+}
+
+static inline MYINT gm_bucket_slot(const GM_BUCKETS *b, MYINT k){
+    return k & (b->nbkt - 1);
+}
+
+/**
+ * 环中第ib个桶的绝对编号
+ */
+static inline MYINT gm_bucket_abs(const GM_BUCKETS *b, MYINT ib){
+    return b->kcur + ((ib - b->kcur) & (b->nbkt - 1));
+}
+
+static void gm_bucket_append_slot(GM_BUCKETS *b, MYINT ib, GM_ENTRY e){
+    if(b->bsize[ib] == b->bcap[ib]){
+        MYINT newcap = (b->bcap[ib]==0)? 8 : b->bcap[ib]*2;
+        GM_ENTRY *data0 = realloc(b->data[ib], sizeof(GM_ENTRY)*newcap);
+        if(data0==NULL){
+            fprintf(stderr, "reallocation failed in group marching. exit.");
+            exit(EXIT_FAILURE);
+        }
+        b->data[ib] = data0;
+        b->bcap[ib] = newcap;
+    }
+    b->data[ib][b->bsize[ib]++] = e;
+    if(e.c < b->bmin[ib])  b->bmin[ib] = e.c;
+}
+
+/**
+ * 将元素加入绝对编号为k的桶，走时跨度超过环的范围时扩充桶个数并重新分配元素
+ */
+static void gm_bucket_push(GM_BUCKETS *b, MYINT k, GM_ENTRY e){
+    if(k - b->kcur >= b->nbkt){
+        MYINT nbkt = b->nbkt;
+        while(k - b->kcur >= nbkt)  nbkt *= 2;
+
+        GM_BUCKETS old = *b;
+        gm_buckets_alloc(b, nbkt);
+        for(MYINT i=0; i<old.nbkt; ++i){
+            for(MYINT j=0; j<old.bsize[i]; ++j){
+                GM_ENTRY e0 = old.data[i][j];
+                gm_bucket_append_slot(b, gm_bucket_slot(b, gm_bucket_key(b, e0.key)), e0);
+            }
+            if(old.dirty[i] && old.bsize[i] > 0){
+                b->dirty[gm_bucket_slot(b, gm_bucket_key(b, old.data[i][0].key))] = true;
+            }
+        }
+        gm_buckets_free(&old);
+    }
+    gm_bucket_append_slot(b, gm_bucket_slot(b, k), e);
+}
+
+/**
+ * 删除桶内走时不超过tgroup的元素并存入group，同时删除过期元素，重新计算桶内c的最小值
+ *
+ * @return    存入group的元素个数
+ */
+static MYINT gm_bucket_take(
+    GM_BUCKETS *b, MYINT ib, const MYREAL *TT, const NODE_STAT *FMM_stat, MYREAL tgroup, MYINT *group)
+{
+    MYINT n = 0, ng = 0;
+    MYINT k = gm_bucket_abs(b, ib);
+    MYREAL cmin = GM_UNREACHED;
+    GM_ENTRY *data = b->data[ib];
+    for(MYINT j=0; j<b->bsize[ib]; ++j){
+        GM_ENTRY e = data[j];
+        if(nodestat_get(FMM_stat, e.idx) != FMM_CLS || gm_bucket_key(b, TT[e.idx]) != k)  continue;
+        if(TT[e.idx] <= tgroup){
+            group[ng++] = e.idx;
+            continue;
+        }
+        data[n++] = e;
+        if(e.c < cmin)  cmin = e.c;
+    }
+    b->bsize[ib] = n;
+    b->bmin[ib] = cmin;
+    b->dirty[ib] = false;
+    return ng;
+}
+
+
+/**
+ * 保证数组的容量不小于need，按倍数增长
+ */
+static void * gm_reserve(void *arr, MYINT *pcap, MYINT need, MYINT maxcap, size_t size)
+{
+    if(need <= *pcap)  return arr;
+    MYINT newcap = (*pcap)*2;
+    if(newcap < need)    newcap = need;
+    if(newcap > maxcap)  newcap = maxcap;
+
+    void *arr0 = realloc(arr, size*newcap);
+    if(arr0==NULL){
+        fprintf(stderr, "reallocation failed in group marching. exit.");
+        exit(EXIT_FAILURE);
+    }
+    *pcap = newcap;
+    return arr0;
+}
+
+
+void FastMarching_gm(
+    const double *rs, MYINT nr,
+    const double *ts, MYINT nt,
+    const double *ps, MYINT np,
+    MYINT maxodr,  const MYREAL *Slw, MYREAL *TT,
+    NODE_STAT *FMM_stat, bool sphcoord,
+    const HEAP_DATA *FMM_data, MYINT size, MYINT Ndots,
+    const GRID_LAYOUT *lay, MYINT nthreads, bool printbar)
+{
+    double dr = (nr>1)? rs[1] - rs[0] : 0.0;
+    double dt = (nt>1)? ts[1] - ts[0] : 0.0;
+    double dp = (np>1)? ps[1] - ps[0] : 0.0;
+
+    // convenient arrays
+    double sin_ts[nt];
+    if(sphcoord){
+        for(MYINT it=0; it<nt; ++it){
+            sin_ts[it] = fabs(sin(ts[it]));
+            if(sin_ts[it] < 1e-12) sin_ts[it] += 1e-12;
+        }
+    }
+
+    int nth = 1;
+#ifdef _OPENMP
+    nth = (nthreads > 0)? nthreads : omp_get_max_threads();
+#endif
+
+    GM_GRID g = {
+        .lay = lay,
+        .neighbour_travt = get_neighbour_travt_func(maxodr, true),
+        .maxodr = maxodr,
+        .Slw = Slw,
+        .sphcoord = sphcoord,
+        .rs = rs, .sin_ts = sin_ts,
+        .dr = dr, .dt = dt, .dp = dp};
+
+    // 桶宽取全网格上c的最小值对应的组宽，不超过任意一步的组宽，
+    // 因此每步只有最后一个被检查的桶中有留在波前的元素
+    MYREAL cglob = GM_UNREACHED;
+    #pragma omp parallel for num_threads(nth) default(shared) reduction(min:cglob)
+    for(MYINT ir=0; ir<nr; ++ir){
+        for(MYINT it=0; it<nt; ++it){
+            for(MYINT ip=0; ip<np; ++ip){
+                MYREAL c = gm_cell_travt(&g, grid_ravel(lay, ir, it, ip));
+                if(c < cglob)  cglob = c;
+            }
+        }
+    }
+
+    // 每步需要更新的节点，前ngroup个为本组节点，其后为本组节点未确定的邻点，told为其更新前的走时，
+    // tkey为更新后需要入桶的节点所在桶的绝对编号。标记数组用于邻点去重
+    MYINT *target = NULL, *tkey = NULL;
+    MYREAL *val = NULL, *told = NULL;
+    MYINT tcap = 0, kcap = 0, vcap = 0, ocap = 0;
+    NODE_MASK *mark = nodemask_alloc(lay->size);
+
+    MYREAL tbeg = GM_UNREACHED;
+    for(MYINT i=0; i<size; ++i){
+        if(TT[FMM_data[i]] < tbeg)  tbeg = TT[FMM_data[i]];
+    }
+    GM_BUCKETS bkt;
+    gm_buckets_alloc(&bkt, 64);
+    bkt.kcur = 0;
+    bkt.t0 = tbeg;
+    bkt.rwidth = (cglob > 0.0)? 1.0/(FMMGM_GROUP_FAC * cglob) : 1e6;
+
+    // 波前中的节点数
+    MYINT nclose = 0;
+    for(MYINT i=0; i<size; ++i){
+        MYINT idx = FMM_data[i];
+        if(nodestat_get(FMM_stat, idx) != FMM_CLS || nodemask_get(mark, idx))  continue;
+        nodemask_set(mark, idx);
+        gm_bucket_push(&bkt, gm_bucket_key(&bkt, TT[idx]), (GM_ENTRY){idx, TT[idx], gm_cell_travt(&g, idx)});
+        nclose++;
+    }
+    for(MYINT k=0; k<bkt.nbkt; ++k){
+        for(MYINT j=0; j<bkt.bsize[k]; ++j)  nodemask_clear(mark, bkt.data[k][j].idx);
+    }
+
+    MYINT size_bak = nr*nt*np;
+    MYINT last_barpercent = 0;
+
+    while(nclose > 0){
+        // 跳到第一个含有效元素的桶，组的走时上界由该桶内的最小走时和所有桶内c的最小值确定
+        while(true){
+            MYINT ib = gm_bucket_slot(&bkt, bkt.kcur);
+            if(bkt.dirty[ib])  gm_bucket_take(&bkt, ib, TT, FMM_stat, -GM_UNREACHED, NULL);
+            if(bkt.bsize[ib] > 0)  break;
+            bkt.kcur++;
+        }
+
+        MYREAL tmin = GM_UNREACHED, cmin = GM_UNREACHED;
+        {
+            MYINT ib = gm_bucket_slot(&bkt, bkt.kcur);
+            for(MYINT j=0; j<bkt.bsize[ib]; ++j){
+                MYREAL t = TT[bkt.data[ib][j].idx];
+                if(t < tmin)  tmin = t;
+            }
+        }
+        // 过期元素对应的节点若仍在波前中，其c仍计入最小值；若已确定，则dirty桶的bmin可能偏小，
+        // 因此只在取得最小值的桶为dirty时清理该桶并重新比较
+        while(true){
+            MYINT imin = 0;
+            cmin = GM_UNREACHED;
+            for(MYINT ib=0; ib<bkt.nbkt; ++ib){
+                if(bkt.bmin[ib] < cmin){
+                    cmin = bkt.bmin[ib];
+                    imin = ib;
+                }
+            }
+            if(! bkt.dirty[imin])  break;
+            gm_bucket_take(&bkt, imin, TT, FMM_stat, -GM_UNREACHED, NULL);
+        }
+        const MYREAL tgroup = tmin + FMMGM_GROUP_FAC * cmin;
+
+        // 走时不超过上界的波前节点确定为alive，只需检查走时不超过上界的桶
+        MYINT ngroup = 0;
+        {
+            MYINT kg = gm_bucket_key(&bkt, tgroup);
+            if(kg - bkt.kcur >= bkt.nbkt)  kg = bkt.kcur + bkt.nbkt - 1;
+            for(MYINT k=bkt.kcur; k<=kg; ++k){
+                MYINT ib = gm_bucket_slot(&bkt, k);
+                MYINT need = ngroup + bkt.bsize[ib];
+                target = gm_reserve(target, &tcap, need, lay->size, sizeof(MYINT));
+                ngroup += gm_bucket_take(&bkt, ib, TT, FMM_stat, tgroup, target + ngroup);
+            }
+        }
+        nclose -= ngroup;
+
+        // 本组节点及其邻点
+        MYINT need = (ngroup <= lay->size/7)? 7*ngroup : lay->size;
+        target = gm_reserve(target, &tcap, need, lay->size, sizeof(MYINT));
+        val = gm_reserve(val, &vcap, need, lay->size, sizeof(MYREAL));
+        told = gm_reserve(told, &ocap, need, lay->size, sizeof(MYREAL));
+        tkey = gm_reserve(tkey, &kcap, need, lay->size, sizeof(MYINT));
+
+        MYINT ntarget = ngroup;
+
+        #pragma omp parallel num_threads(nth) default(shared)
+        {
+            MYINT k;
+
+            #pragma omp for schedule(static)
+            for(MYINT i=0; i<ngroup; ++i){
+                nodestat_set_atomic(FMM_stat, target[i], FMM_ALV);
+                nodemask_set_atomic(mark, target[i]);
+            }
+
+            // 本组节点未确定的邻点，幽灵节点为alive，不会加入
+            #pragma omp for schedule(static)
+            for(MYINT i=0; i<ngroup; ++i){
+                MYINT ir, it, ip;
+                grid_unravel(lay, target[i], &ir, &it, &ip);
+                for(MYINT d=0; d<6; ++d){
+                    MYINT jdx = grid_ravel(lay, ir+xr[d], it+xt[d], ip+xp[d]);
+                    if(nodestat_get(FMM_stat, jdx) == FMM_ALV)  continue;
+                    if(nodemask_set_atomic(mark, jdx))  continue;
+                    #pragma omp atomic capture
+                    k = ntarget++;
+                    target[k] = jdx;
+                }
+            }
+
+            #pragma omp for schedule(static)
+            for(MYINT i=0; i<ntarget; ++i){
+                told[i] = TT[target[i]];
+            }
+
+            // 两遍更新，每遍先基于同一走时场计算所有节点的新走时，再一起写回
+            for(MYINT ipass=0; ipass<2; ++ipass){
+                #pragma omp for schedule(static)
+                for(MYINT i=0; i<ntarget; ++i){
+                    val[i] = gm_local_update(&g, TT, FMM_stat, target[i]);
+                }
+                #pragma omp for schedule(static)
+                for(MYINT i=0; i<ntarget; ++i){
+                    TT[target[i]] = val[i];
+                }
+            }
+
+            // 新到达的邻点加入波前。需要入桶的节点val改为记录节点处的c，不需要入桶的节点tkey记为-1
+            #pragma omp for schedule(static)
+            for(MYINT i=0; i<ntarget; ++i){
+                MYINT jdx = target[i];
+                nodemask_clear_atomic(mark, jdx);
+                if(i < ngroup)  continue;
+                if(nodestat_get(FMM_stat, jdx) == FMM_FAR){
+                    nodestat_set_atomic(FMM_stat, jdx, FMM_CLS);
+                    #pragma omp atomic
+                    Ndots--;
+                }
+                MYINT knew = gm_bucket_key(&bkt, TT[jdx]);
+                if(told[i] < GM_UNREACHED && gm_bucket_key(&bkt, told[i]) == knew){
+                    tkey[i] = -1;
+                } else {
+                    tkey[i] = knew;
+                    val[i] = gm_cell_travt(&g, jdx);
+                }
+            }
+        }
+
+        // 新加入及走时减小到更早的桶的波前节点入桶，后者原先所在的桶记为dirty
+        for(MYINT i=ngroup; i<ntarget; ++i){
+            if(tkey[i] < 0)  continue;
+            MYINT jdx = target[i];
+            if(told[i] < GM_UNREACHED){
+                bkt.dirty[gm_bucket_slot(&bkt, gm_bucket_key(&bkt, told[i]))] = true;
+            } else {
+                nclose++;
+            }
+            gm_bucket_push(&bkt, tkey[i], (GM_ENTRY){jdx, TT[jdx], val[i]});
+        }
+
+        // 打印进度条
+        if(printbar){
+            MYINT barpercent = 100.0 - (double)Ndots / (double)(size_bak) * 100.0;
+            if(barpercent != last_barpercent){
+                printprogressBar("Group Marching...  ", barpercent);
+                last_barpercent = barpercent;
+            }
+        }
+    }
+    if(printbar && last_barpercent != 100)  printprogressBar("Group Marching...  ", 100);
+
+    gm_buckets_free(&bkt);
+    if(target!=NULL) free(target);
+    if(val!=NULL)    free(val);
+    if(told!=NULL)   free(told);
+    if(tkey!=NULL)   free(tkey);
+    free(mark);
+}
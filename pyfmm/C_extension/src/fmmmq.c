@@ -0,0 +1,401 @@
+/**
+ * @file   fmmmq.c
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <sched.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "const.h"
+#include "mallocfree.h"
+#include "heapsort.h"
+#include "layout.h"
+#include "nodestat.h"
+#include "progressbar.h"
+#include "fmm.h"
+#include "fmmmq.h"
+
+
+#define MQ_EMPTY  9.9e30f   ///< 空堆的堆首走时，与未计算节点的走时相同
+#define MQ_SPIN   64        ///< 线程连续空转(弹出失败或放回节点)超过该次数后每次让出处理器
+
+
+/**
+ * 带锁的d叉堆
+ */
+typedef struct {
+    DARY_HEAP *heap;     ///< d叉堆，惰性删除
+    MYREAL top;          ///< 堆首走时，空堆时为 MQ_EMPTY ，可不加锁读取
+#ifdef _OPENMP
+    omp_lock_t lock;     ///< 堆的锁
+#endif
+} MQ_QUEUE;
+
+
+static inline void mq_lock(MQ_QUEUE *q){
+#ifdef _OPENMP
+    omp_set_lock(&q->lock);
+#endif
+}
+
+static inline void mq_unlock(MQ_QUEUE *q){
+#ifdef _OPENMP
+    omp_unset_lock(&q->lock);
+#endif
+}
+
+static inline MYREAL mq_top(const MQ_QUEUE *q){
+    MYREAL t;
+    __atomic_load(&q->top, &t, __ATOMIC_RELAXED);
+    return t;
+}
+
+static inline void mq_set_top(MQ_QUEUE *q){
+    MYREAL t = (q->heap->size > 0)? q->heap->data[0].t : MQ_EMPTY;
+    __atomic_store(&q->top, &t, __ATOMIC_RELAXED);
+}
+
+/**
+ * 所有堆的堆首走时以及各线程正在处理的节点走时的最小值，不加锁读取，只作为近似值
+ */
+static MYREAL mq_min_top(const MQ_QUEUE *mq, MYINT nq, const MYREAL *busy, int nth){
+    MYREAL tmin = MQ_EMPTY, t;
+    for(MYINT i=0; i<nq; ++i){
+        t = mq_top(mq + i);
+        if(t < tmin) tmin = t;
+    }
+    for(int i=0; i<nth; ++i){
+        __atomic_load(busy + i, &t, __ATOMIC_RELAXED);
+        if(t < tmin) tmin = t;
+    }
+    return tmin;
+}
+
+/**
+ * xorshift 伪随机数，每个线程各有一个状态
+ */
+static inline MYINT mq_rand(unsigned int *seed, MYINT n){
+    unsigned int x = *seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    return (MYINT)(x % (unsigned int)n);
+}
+
+
+/**
+ * 压入随机选取的一个堆
+ */
+static void mq_push(MQ_QUEUE *mq, MYINT nq, unsigned int *seed, HEAP_DATA idx, MYREAL t){
+    MQ_QUEUE *q = mq + mq_rand(seed, nq);
+    mq_lock(q);
+    DHeapPush(q->heap, idx, t, NULL);
+    mq_set_top(q);
+    mq_unlock(q);
+}
+
+
+/**
+ * 从随机选取的两个堆中堆首走时较小者弹出，多次未成功时依次检查所有堆
+ *
+ * @return     是否弹出了元素
+ */
+static bool mq_pop(MQ_QUEUE *mq, MYINT nq, unsigned int *seed, HEAP_DATA *pidx, MYREAL *pt){
+    for(MYINT attempt=0; attempt<nq; ++attempt){
+        MQ_QUEUE *q1 = mq + mq_rand(seed, nq);
+        MQ_QUEUE *q2 = mq + mq_rand(seed, nq);
+        MQ_QUEUE *q = (mq_top(q2) < mq_top(q1))? q2 : q1;
+        if(mq_top(q) >= MQ_EMPTY) continue;
+
+        mq_lock(q);
+        bool got = (q->heap->size > 0);
+        if(got){
+            *pidx = DHeapPop(q->heap, pt, NULL);
+            mq_set_top(q);
+        }
+        mq_unlock(q);
+        if(got) return true;
+    }
+
+    for(MYINT i=0; i<nq; ++i){
+        MQ_QUEUE *q = mq + i;
+        if(mq_top(q) >= MQ_EMPTY) continue;
+
+        mq_lock(q);
+        bool got = (q->heap->size > 0);
+        if(got){
+            *pidx = DHeapPop(q->heap, pt, NULL);
+            mq_set_top(q);
+        }
+        mq_unlock(q);
+        if(got) return true;
+    }
+    return false;
+}
+
+
+/**
+ * 以原子操作将 *p 更新为 min(*p, t)
+ *
+ * @param      p        (inout)走时地址
+ * @param      t        (in)新走时
+ * @param      pold     (out)更新前的走时
+ *
+ * @return     是否更新
+ */
+static inline bool atomic_min_real(MYREAL *p, MYREAL t, MYREAL *pold){
+    MYREAL old;
+    __atomic_load(p, &old, __ATOMIC_RELAXED);
+    while(t < old){
+        if(__atomic_compare_exchange(p, &old, &t, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+            *pold = old;
+            return true;
+        }
+    }
+    *pold = old;
+    return false;
+}
+
+
+void FastMarching_mq(
+    const double *rs, MYINT nr,
+    const double *ts, MYINT nt,
+    const double *ps, MYINT np,
+    MYINT maxodr,  const MYREAL *Slw, MYREAL *TT,
+    NODE_STAT *FMM_stat, bool sphcoord,
+    const HEAP_DATA *FMM_data, MYINT size, MYINT Ndots,
+    const GRID_LAYOUT *lay, MYINT nthreads, bool printbar)
+{
+    double dr = (nr>1)? rs[1] - rs[0] : 0.0;
+    double dt = (nt>1)? ts[1] - ts[0] : 0.0;
+    double dp = (np>1)? ps[1] - ps[0] : 0.0;
+
+    // DON'T CHANGE.
+    static const MYINT xr[6] = {-1, 1,  0, 0,  0, 0};
+    static const MYINT xt[6] = { 0, 0, -1, 1,  0, 0};
+    static const MYINT xp[6] = { 0, 0,  0, 0, -1, 1};
+
+    // convenient arrays
+    double sin_ts[nt];
+    if(sphcoord){
+        for(MYINT it=0; it<nt; ++it){
+            sin_ts[it] = fabs(sin(ts[it]));
+            if(sin_ts[it] < 1e-12) sin_ts[it] += 1e-12;
+        }
+    }
+
+    // 未指定排布时使用行优先排布
+    GRID_LAYOUT lay0;
+    if(lay==NULL){
+        grid_layout_init(&lay0, nr, nt, np, false, 0);
+        lay = &lay0;
+    }
+
+    // 有幽灵层时，幽灵节点在初始化时即为alive，属于下面的固定节点，邻点循环中不需要检查索引范围
+    const bool padded = (lay->pad > 0);
+    const NEIGHBOUR_TRAVT_FUNC neighbour_travt = get_neighbour_travt_func(maxodr, padded);
+
+    // 允许乱序的走时段宽度，球坐标下按最大半径计算
+    double hmin = fabs(dr);
+    double ht = fabs(dt), hp = fabs(dp);
+    if(sphcoord){
+        double rmax = (fabs(rs[0]) > fabs(rs[nr-1]))? fabs(rs[0]) : fabs(rs[nr-1]);
+        ht *= rmax;
+        hp *= rmax;
+    }
+    if(hmin <= 0.0 || (ht > 0.0 && ht < hmin)) hmin = ht;
+    if(hmin <= 0.0 || (hp > 0.0 && hp < hmin)) hmin = hp;
+    if(hmin <= 0.0) hmin = 1.0;
+    MYREAL smin = Slw[0];
+    for(MYINT i=1; i<lay->size; ++i){
+        if(Slw[i] < smin) smin = Slw[i];
+    }
+    double band = FMMMQ_BAND_CELLS * hmin * smin;
+
+    int nth = 1;
+#ifdef _OPENMP
+    nth = (nthreads > 0)? nthreads : omp_get_max_threads();
+#endif
+
+    // 初始波前依次分配到各个堆
+    MYINT nq = FMMMQ_QUEUES_PER_THREAD * nth;
+    MQ_QUEUE *mq = (MQ_QUEUE *)malloc1d(nq, sizeof(MQ_QUEUE));
+    for(MYINT i=0; i<nq; ++i){
+        mq[i].heap = DHeap_create(size/nq + 1);
+#ifdef _OPENMP
+        omp_init_lock(&mq[i].lock);
+#endif
+    }
+    for(MYINT i=0; i<size; ++i){
+        DHeapPush(mq[i%nq].heap, FMM_data[i], TT[FMM_data[i]], NULL);
+    }
+    for(MYINT i=0; i<nq; ++i)  mq_set_top(mq + i);
+
+    // 初始化时已确定的节点(如加密网格计算的源点附近区域)不再重新打开，按比特记录
+    NODE_MASK *fixed = NULL;
+    for(MYINT i=0; i<lay->size; ++i){
+        if(nodestat_get(FMM_stat, i) != FMM_ALV) continue;
+        if(fixed==NULL)  fixed = nodemask_alloc(lay->size);
+        nodemask_set(fixed, i);
+    }
+
+    // 各线程正在处理的节点走时
+    MYREAL *busy = (MYREAL *)malloc1d(nth, sizeof(MYREAL));
+    for(int i=0; i<nth; ++i)  busy[i] = MQ_EMPTY;
+
+    // 堆中元素与正在处理的节点总数，为0时结束
+    MYINT pending = size;
+    MYINT size_bak = nr*nt*np;
+    MYINT last_barpercent = 0;
+
+    #pragma omp parallel num_threads(nth) default(shared)
+    {
+        int tid = 0;
+#ifdef _OPENMP
+        tid = omp_get_thread_num();
+#endif
+        unsigned int seed = 2463534242u + 97u*(unsigned int)tid;
+        const MYREAL tempty = MQ_EMPTY;
+
+        HEAP_DATA idx0;
+        MYINT ir0, it0, ip0, ir, it, ip, idx;
+        MYREAL s, travt0, travt1, travt, told;
+        double h;
+        char nstat, travt_stat;
+
+        // 连续空转次数。波前较窄时多数线程取不到节点，持续自旋会与工作线程争抢锁和处理器
+        MYINT nidle = 0;
+
+        while(true){
+            if(nidle > MQ_SPIN)  sched_yield();
+
+            if(! mq_pop(mq, nq, &seed, &idx0, &travt0)){
+                MYINT p;
+                #pragma omp atomic read
+                p = pending;
+                if(p == 0) break;
+                nidle++;
+                continue;
+            }
+
+            // 跳过过期的元素，该节点已以更小的走时重新入堆
+            MYREAL tcur;
+            __atomic_load(TT+idx0, &tcur, __ATOMIC_RELAXED);
+            if(travt0 > tcur){
+                #pragma omp atomic
+                pending--;
+                continue;
+            }
+
+            // 比所有堆首及其它线程正在处理的节点晚一个走时段以上的节点放回，限制乱序的程度
+            __atomic_store(busy + tid, &travt0, __ATOMIC_RELAXED);
+            if(travt0 > mq_min_top(mq, nq, busy, nth) + band){
+                mq_push(mq, nq, &seed, idx0, travt0);
+                __atomic_store(busy + tid, &tempty, __ATOMIC_RELAXED);
+                nidle++;
+                continue;
+            }
+            nidle = 0;
+
+            nodestat_set_atomic(FMM_stat, idx0, FMM_ALV);
+            grid_unravel(lay, idx0, &ir0, &it0, &ip0);
+
+            // get neighbours (max 6)
+            for(MYINT k=0; k<6; ++k){
+                ir = ir0 + xr[k];
+                it = it0 + xt[k];
+                ip = ip0 + xp[k];
+
+                if(!padded){
+                    if(ir<0 || ir>nr-1) continue;
+                    if(it<0 || it>nt-1) continue;
+                    if(ip<0 || ip>np-1) continue;
+                }
+
+                idx = grid_ravel(lay, ir, it, ip);
+                if(fixed!=NULL && nodemask_get(fixed, idx)) continue;
+
+                if(k<2){
+                    h = dr;
+                } else if(k<4){
+                    h = dt;
+                    if(sphcoord) h *= rs[ir];
+                } else {
+                    h = dp;
+                    if(sphcoord) h *= rs[ir]*sin_ts[it];
+                }
+
+                s = Slw[idx];
+                travt1 = travt0 + h*s;
+                __atomic_load(TT+idx, &told, __ATOMIC_RELAXED);
+
+                if(sphcoord){
+                    travt = neighbour_travt(
+                        lay, ir, it, ip, idx, maxodr, TT,
+                        FMM_stat, s, dr, dt*rs[ir], dp*rs[ir]*sin_ts[it],
+                        (travt1 < told)? travt1 : told, &travt_stat);
+                } else {
+                    travt = neighbour_travt(
+                        lay, ir, it, ip, idx, maxodr, TT,
+                        FMM_stat, s, dr, dt, dp,
+                        (travt1 < told)? travt1 : told, &travt_stat);
+                }
+                if(travt_stat<0 || travt<0)  travt = travt1;
+
+                // 已确定的节点只在走时明显减小时重新打开
+                nstat = nodestat_get(FMM_stat, idx);
+                if(nstat == FMM_ALV && travt >= told*(1.0 - FMM_REOPEN_RTOL)) continue;
+
+                if(atomic_min_real(TT+idx, travt, &told)){
+                    if(told >= MQ_EMPTY){
+                        #pragma omp atomic
+                        Ndots--;
+                    }
+                    nodestat_set_atomic(FMM_stat, idx, FMM_CLS);
+
+                    #pragma omp atomic
+                    pending++;
+                    mq_push(mq, nq, &seed, idx, travt);
+                }
+            }
+
+            __atomic_store(busy + tid, &tempty, __ATOMIC_RELAXED);
+            #pragma omp atomic
+            pending--;
+
+            // 打印进度条
+            if(printbar && tid == 0){
+                MYINT nd;
+                #pragma omp atomic read
+                nd = Ndots;
+                MYINT barpercent = 100.0 - (double)nd / (double)(size_bak) * 100.0;
+                if(barpercent != last_barpercent){
+                    printprogressBar("Fast Marching (multiqueue)...  ", barpercent);
+                    last_barpercent = barpercent;
+                }
+            }
+        }
+    }
+    if(printbar && last_barpercent != 100)  printprogressBar("Fast Marching (multiqueue)...  ", 100);
+
+    for(MYINT i=0; i<nq; ++i){
+        DHeap_free(mq[i].heap);
+#ifdef _OPENMP
+        omp_destroy_lock(&mq[i].lock);
+#endif
+    }
+    free(mq);
+    free(busy);
+    if(fixed!=NULL) free(fixed);
+
+    if(lay==&lay0) grid_layout_free(&lay0);
+}
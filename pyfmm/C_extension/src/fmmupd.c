@@ -0,0 +1,297 @@
+/**
+ * @file   fmmupd.c
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "const.h"
+#include "mallocfree.h"
+#include "heapsort.h"
+#include "index.h"
+#include "layout.h"
+#include "nodestat.h"
+#include "fmm.h"
+#include "fmmupd.h"
+
+
+#define UPD_UNREACHED  9.9e30f   ///< 未计算节点的走时
+
+
+// DON'T CHANGE.
+static const MYINT xr[6] = {-1, 1,  0, 0,  0, 0};
+static const MYINT xt[6] = { 0, 0, -1, 1,  0, 0};
+static const MYINT xp[6] = { 0, 0,  0, 0, -1, 1};
+
+
+/**
+ * 节点处各维度的网格间距，球坐标下已乘以半径
+ */
+static inline void upd_spacing(
+    const double *rs, const double *sin_ts, bool sphcoord,
+    double dr, double dt, double dp, MYINT ir, MYINT it, double h[3])
+{
+    h[0] = dr;
+    h[1] = dt;
+    h[2] = dp;
+    if(sphcoord){
+        h[1] *= rs[ir];
+        h[2] *= rs[ir]*sin_ts[it];
+    }
+}
+
+
+/**
+ * 根据alive邻点计算节点的走时。按走时从小到大依次取alive邻点，
+ * 与FMM中这些邻点依次确定时对该节点的更新相同：差分模板中不包括之后才确定的邻点，
+ * 结果不小于刚确定的邻点的走时，取各次结果的最小值
+ *
+ * @return    走时，没有alive邻点时为9.9e30
+ */
+static MYREAL upd_node_travt(
+    const GRID_LAYOUT *lay, NEIGHBOUR_TRAVT_FUNC neighbour_travt, MYINT maxodr,
+    const MYREAL *Slw, const MYREAL *TT, NODE_STAT *FMM_stat,
+    MYINT ir, MYINT it, MYINT ip, MYINT idx, const double h[3])
+{
+    MYREAL slw = Slw[idx];
+
+    // alive邻点按走时插入排序
+    MYINT nnb = 0;
+    MYREAL tnb[6];
+    MYINT knb[6];
+    MYINT jnb[6];
+    for(MYINT k=0; k<6; ++k){
+        MYINT jdx = grid_ravel(lay, ir+xr[k], it+xt[k], ip+xp[k]);
+        if(nodestat_get(FMM_stat, jdx) != FMM_ALV)  continue;
+        MYREAL T = TT[jdx];
+        if(T >= UPD_UNREACHED)  continue;
+        MYINT m = nnb++;
+        for(; m>0 && tnb[m-1] > T; --m){
+            tnb[m] = tnb[m-1];
+            knb[m] = knb[m-1];
+            jnb[m] = jnb[m-1];
+        }
+        tnb[m] = T;
+        knb[m] = k;
+        jnb[m] = jdx;
+    }
+
+    // 暂时将邻点置为far，依次确定
+    for(MYINT m=0; m<nnb; ++m)  nodestat_set(FMM_stat, jnb[m], FMM_FAR);
+
+    MYREAL travt_min = UPD_UNREACHED;
+    for(MYINT m=0; m<nnb; ++m){
+        nodestat_set(FMM_stat, jnb[m], FMM_ALV);
+        MYREAL travt1 = tnb[m] + h[knb[m]/2] * slw;
+        MYREAL travt_bak = (travt1 < travt_min)? travt1 : travt_min;
+        char travt_stat;
+        MYREAL travt = neighbour_travt(
+            lay, ir, it, ip, idx, maxodr, TT,
+            FMM_stat, slw, h[0], h[1], h[2], travt_bak, &travt_stat);
+        if(travt_stat < 0 || travt < 0)  travt = travt1;
+        if(travt < tnb[m])  travt = tnb[m];
+        if(travt < travt_min)  travt_min = travt;
+    }
+    return travt_min;
+}
+
+
+/**
+ * 从down中第n0个节点开始广度优先搜索，扩大下游区域。
+ * TT为NULL时加入原走时不小于当前节点的邻点，即原先在其之后确定的节点；
+ * 否则加入走时比原走时减小的邻点
+ *
+ * @param     lay       (in)排布方式
+ * @param     TT0       (in)原走时场
+ * @param     TT        (in)当前走时场，可为NULL
+ * @param     down      (inout)下游区域的节点
+ * @param     pndown    (inout)下游区域的节点数
+ * @param     n0        (in)开始搜索的位置
+ * @param     indown    (inout)节点是否在下游区域内
+ */
+static void upd_grow_down(
+    const GRID_LAYOUT *lay, const MYREAL *TT0, const MYREAL *TT,
+    MYINT *down, MYINT *pndown, MYINT n0, NODE_MASK *indown)
+{
+    for(MYINT i=n0; i<*pndown; ++i){
+        MYINT idx = down[i];
+        MYINT ir, it, ip;
+        grid_unravel(lay, idx, &ir, &it, &ip);
+        for(MYINT k=0; k<6; ++k){
+            MYINT jr = ir+xr[k], jt = it+xt[k], jp = ip+xp[k];
+            if(jr<0 || jr>lay->nr-1 || jt<0 || jt>lay->nt-1 || jp<0 || jp>lay->np-1)  continue;
+            MYINT jdx = grid_ravel(lay, jr, jt, jp);
+            if(nodemask_get(indown, jdx))  continue;
+            if((TT==NULL)? TT0[jdx] < TT0[idx] : TT[jdx] >= TT0[jdx])  continue;
+            nodemask_set(indown, jdx);
+            down[(*pndown)++] = jdx;
+        }
+    }
+}
+
+
+MYINT FastMarching_update(
+    const double *rs, MYINT nr,
+    const double *ts, MYINT nt,
+    const double *ps, MYINT np,
+    MYINT maxodr,  const MYREAL *Slw, MYREAL *TT,
+    bool sphcoord, const bool *changed, bool printbar)
+{
+    // 程序运行开始时间
+    struct timeval begin_t;
+    gettimeofday(&begin_t, NULL);
+
+    MYINT nrtp = nr*nt*np;
+    for(MYINT i=0; i<nrtp; ++i){
+        if(changed[i] && TT[i] == 0.0)  return -1;
+    }
+
+    double dr = (nr>1)? rs[1] - rs[0] : 0.0;
+    double dt = (nt>1)? ts[1] - ts[0] : 0.0;
+    double dp = (np>1)? ps[1] - ps[0] : 0.0;
+
+    double sin_ts[nt];
+    if(sphcoord){
+        for(MYINT it=0; it<nt; ++it){
+            sin_ts[it] = fabs(sin(ts[it]));
+            if(sin_ts[it] < 1e-12) sin_ts[it] += 1e-12;
+        }
+    }
+
+    // 与 FastMarching 相同，在带幽灵层的行优先排布上计算，幽灵节点为走时9.9e30的alive节点
+    GRID_LAYOUT lay;
+    grid_layout_init(&lay, nr, nt, np, false, FMM_GHOST_LAYERS);
+    MYREAL *TT_lay = (MYREAL *)malloc1d(lay.size, sizeof(MYREAL));
+    grid_to_layout(&lay, TT, TT_lay, UPD_UNREACHED);
+    MYREAL *Slw_lay = (MYREAL *)malloc1d(lay.size, sizeof(MYREAL));
+    grid_to_layout(&lay, Slw, Slw_lay, Slw[0]);
+    NODE_STAT *FMM_stat = nodestat_alloc(lay.size);
+    nodestat_fill(FMM_stat, lay.size, FMM_ALV);
+
+    // 下游区域：从慢度改变的节点出发，沿原走时不减的方向搜索相邻节点。
+    // 区域内的节点按加入顺序记录在down中，标记数组用于去重
+    MYREAL *TT0_lay = (MYREAL *)malloc1d(lay.size, sizeof(MYREAL));
+    for(MYINT i=0; i<lay.size; ++i)  TT0_lay[i] = TT_lay[i];
+    MYINT *down = (MYINT *)malloc1d(nrtp, sizeof(MYINT));
+    NODE_MASK *indown = nodemask_alloc(lay.size);
+    MYINT ndown = 0;
+    {
+        MYINT ir, it, ip;
+        for(MYINT i=0; i<nrtp; ++i){
+            if(! changed[i])  continue;
+            unravel_index(i, nt*np, np, &ir, &it, &ip);
+            MYINT idx = grid_ravel(&lay, ir, it, ip);
+            nodemask_set(indown, idx);
+            down[ndown++] = idx;
+        }
+    }
+    upd_grow_down(&lay, TT0_lay, NULL, down, &ndown, 0, indown);
+
+    MYINT heapsize = 0;
+    MYINT heapcap = nr*nt + nt*np + nr*np;
+    HEAP_DATA *FMM_data = (HEAP_DATA *)malloc1d(heapcap, sizeof(HEAP_DATA));
+    MYINT *NroIdx = (MYINT *)malloc1d(lay.size, sizeof(MYINT));
+    NEIGHBOUR_TRAVT_FUNC neighbour_travt = get_neighbour_travt_func(maxodr, true);
+
+    while(true){
+        // 重置下游区域，区域外的节点均保持原走时
+        for(MYINT i=0; i<ndown; ++i){
+            TT_lay[down[i]] = UPD_UNREACHED;
+            nodestat_set(FMM_stat, down[i], FMM_FAR);
+        }
+
+        // 与下游区域相邻的alive节点以原走时作为初始波前面。这些节点与下游节点按走时顺序交替确定，
+        // 每个下游节点更新时已确定的邻点与完整计算时相同
+        MYINT Ndots = ndown;
+        for(MYINT i=0; i<ndown; ++i){
+            MYINT ir, it, ip;
+            grid_unravel(&lay, down[i], &ir, &it, &ip);
+            for(MYINT k=0; k<6; ++k){
+                MYINT jr = ir+xr[k], jt = it+xt[k], jp = ip+xp[k];
+                if(jr<0 || jr>nr-1 || jt<0 || jt>nt-1 || jp<0 || jp>np-1)  continue;
+                MYINT jdx = grid_ravel(&lay, jr, jt, jp);
+                if(nodestat_get(FMM_stat, jdx) != FMM_ALV)  continue;
+                FMM_data = HeapPush(FMM_data, &heapsize, &heapcap, jdx, NroIdx, TT_lay);
+                nodestat_set(FMM_stat, jdx, FMM_CLS);
+            }
+        }
+
+        // 下游区域内与完整计算相同，按走时顺序推进
+        FMM_data = FastMarching_with_initial(
+            rs, nr, ts, nt, ps, np,
+            maxodr, Slw_lay, TT_lay,
+            FMM_stat, sphcoord, NULL, printbar,
+            FMM_data, &heapsize, &heapcap, NroIdx, &Ndots,
+            FMM_QUEUE_HEAP, &lay, -1.0, false, NULL, NULL, NULL, NULL);
+
+        // 下游区域之外，差分模板可能用到区域内节点的节点(沿各坐标轴maxodr个节点以内)走时可能改变，
+        // 包括推进中被下游节点更新的初始波前面节点，这些节点并入下游区域。
+        // 其中走时减小的节点还标记为重新打开并入堆，慢度减小时走时的减小可能继续传播到更上游的节点
+        MYINT ndown0 = ndown;
+        bool grown = false;
+        for(MYINT i=0; i<ndown0; ++i){
+            MYINT ir, it, ip;
+            grid_unravel(&lay, down[i], &ir, &it, &ip);
+            for(MYINT k=0; k<6; ++k){
+            for(MYINT o=1; o<=maxodr; ++o){
+                MYINT jr = ir+o*xr[k], jt = it+o*xt[k], jp = ip+o*xp[k];
+                if(jr<0 || jr>nr-1 || jt<0 || jt>nt-1 || jp<0 || jp>np-1)  break;
+                MYINT jdx = grid_ravel(&lay, jr, jt, jp);
+                if(nodemask_get(indown, jdx) || nodestat_get(FMM_stat, jdx) != FMM_ALV)  continue;
+                double h[3];
+                upd_spacing(rs, sin_ts, sphcoord, dr, dt, dp, jr, jt, h);
+                MYREAL travt = upd_node_travt(&lay, neighbour_travt, maxodr, Slw_lay, TT_lay, FMM_stat, jr, jt, jp, jdx, h);
+                if(travt > TT_lay[jdx])  travt = TT_lay[jdx];
+                if(TT_lay[jdx] == TT0_lay[jdx] && 
+                   fabs(travt - TT_lay[jdx]) <= TT_lay[jdx]*FMM_REOPEN_RTOL)  continue;
+                nodemask_set(indown, jdx);
+                down[ndown++] = jdx;
+                grown = true;
+                if(travt >= TT0_lay[jdx])  continue;
+                TT_lay[jdx] = travt;
+                FMM_data = HeapPush(FMM_data, &heapsize, &heapcap, jdx, NroIdx, TT_lay);
+                nodestat_set(FMM_stat, jdx, FMM_RCL);
+            }}
+        }
+        if(! grown)  break;
+
+        // 以重新打开的方式传播走时的减小，找出走时减小的区域。
+        // 重新打开的节点使用未修正的上游节点构成二阶差分模板，走时偏小，
+        // 因此只用于确定区域，将其及其下游并入下游区域后重新按走时顺序推进
+        FMM_data = FastMarching_with_initial(
+            rs, nr, ts, nt, ps, np,
+            maxodr, Slw_lay, TT_lay,
+            FMM_stat, sphcoord, NULL, false,
+            FMM_data, &heapsize, &heapcap, NroIdx, &Ndots,
+            FMM_QUEUE_HEAP, &lay, -1.0, true, NULL, NULL, NULL, NULL);
+
+        upd_grow_down(&lay, TT0_lay, TT_lay, down, &ndown, 0, indown);
+        upd_grow_down(&lay, TT0_lay, NULL, down, &ndown, ndown0, indown);
+    }
+
+    grid_from_layout(&lay, TT_lay, TT);
+
+    grid_layout_free(&lay);
+    free(TT_lay);
+    free(Slw_lay);
+    free(FMM_stat);
+    free(TT0_lay);
+    free(down);
+    free(indown);
+    free(FMM_data);
+    free(NroIdx);
+
+    // 程序运行结束时间
+    struct timeval end_t;
+    gettimeofday(&end_t, NULL);
+    if(printbar) printf("Runtime: %.3f s\n", (end_t.tv_sec - begin_t.tv_sec) + (end_t.tv_usec - begin_t.tv_usec) / 1e6);
+    fflush(stdout);
+
+    return ndown;
+}
@@ -16,10 +16,687 @@
 #include "fmm.h"
 #include "const.h"
 #include "index.h"
+#include "layout.h"
+#include "nodestat.h"
 #include "mallocfree.h"
 #include "progressbar.h"
 
 
+// 走时不小于该值的节点视为尚未到达，不参与最小邻点的比较
+#define FSM_TT_UNREACHED 1e30
+
+
+/**
+ * 比较一个邻点，更新最小邻点走时及由其得到的走时上限(内联函数)，
+ * 以选择代替分支，便于在行扫描中向量化
+ *
+ * @param     T      (in)邻点走时
+ * @param     h      (in)与邻点的距离
+ * @param     slw    (in)当前节点慢度
+ * @param     mint   (inout)最小邻点走时，负数表示尚无有效邻点
+ * @param     tbak   (inout)走时上限，负数表示尚无
+ */
+static inline void sweep_pick_neighbour(MYREAL T, double h, MYREAL slw, MYREAL *mint, MYREAL *tbak)
+{
+    bool ok = (T < FSM_TT_UNREACHED) && (*mint > T || *mint < 0);
+    MYREAL t_bak0 = T + h * slw;
+    *mint = (ok)? T : *mint;
+    *tbak = (ok && (*tbak > t_bak0 || *tbak < 0))? t_bak0 : *tbak;
+}
+
+
+/**
+ * 对一整行节点，依次比较r、t方向的4个邻点 (r-, r+, t-, t+)。
+ * 这些邻点位于相邻的行或面上，不受本行更新的影响，各节点互相独立，
+ * 可按SIMD通道并行计算，沿p方向的依赖留给逐点扫描处理
+ *
+ * @param     n      (in)行长度
+ * @param     Trm    (in)r-方向邻点所在行的走时，以下同
+ * @param     Trp    (in)
+ * @param     Ttm    (in)
+ * @param     Ttp    (in)
+ * @param     hr     (in)r方向网格间距
+ * @param     ht     (in)t方向网格间距，球坐标下已乘以半径
+ * @param     slw    (in)本行慢度
+ * @param     mint   (out)最小邻点走时，无有效邻点时为负数
+ * @param     tbak   (out)走时上限
+ */
+SIMD_CLONES
+static void sweep_row_rt(
+    MYINT n, const MYREAL *restrict Trm, const MYREAL *restrict Trp,
+    const MYREAL *restrict Ttm, const MYREAL *restrict Ttp, double hr, double ht,
+    const MYREAL *restrict slw, MYREAL *restrict mint, MYREAL *restrict tbak)
+{
+    #pragma omp simd
+    for(MYINT i=0; i<n; ++i){
+        MYREAL s = slw[i];
+        MYREAL m = -999.0, b = -999.9;
+        sweep_pick_neighbour(Trm[i], hr, s, &m, &b);
+        sweep_pick_neighbour(Trp[i], hr, s, &m, &b);
+        sweep_pick_neighbour(Ttm[i], ht, s, &m, &b);
+        sweep_pick_neighbour(Ttp[i], ht, s, &m, &b);
+        mint[i] = m;
+        tbak[i] = b;
+    }
+}
+
+
+// DON'T CHANGE.
+static const bool direcr_arr[8] = {1, 0, 0, 1, 1, 0, 0, 1};
+static const bool direct_arr[8] = {1, 1, 0, 0, 1, 1, 0, 0};
+static const bool direcp_arr[8] = {1, 1, 1, 1, 0, 0, 0, 0};
+
+
+/**
+ * 扫描时用到的网格信息，各种扫描方式共用
+ */
+typedef struct {
+    const GRID_LAYOUT *lay;                 ///< 带一层幽灵节点的行优先排布
+    NEIGHBOUR_TRAVT_FUNC neighbour_travt;   ///< 邻点走时更新函数
+    MYINT maxodr;                           ///< 使用的最大差分阶数
+    MYINT dnb[6];                           ///< 6个邻点相对于当前节点的索引偏移量
+    const MYREAL *Slw;                      ///< 带幽灵层的慢度场
+    bool sphcoord;                          ///< 是否使用球坐标
+    const double *rs;                       ///< 维度1坐标数组
+    const double *sin_ts;                   ///< 维度2坐标的正弦绝对值，仅球坐标使用
+    double dr, dt, dp;                      ///< 各维度网格间距
+    NODE_MASK *active;                      ///< 锁定扫描时需要计算的节点，NULL表示不锁定
+} SWEEP_GRID;
+
+
+/**
+ * 分块扫描时各块的状态
+ */
+typedef struct {
+    MYINT nbr, nbt, nbp;   ///< 各维度的块数
+    char *dirty;           ///< 每块是否需要扫描，块内或相邻块的走时有更新时置1
+} SWEEP_TILES;
+
+
+/**
+ * 超平面和分块并行的第一遍扫描中close节点的状态。
+ * 串行扫描访问到close节点的第一个邻点时将其置为alive，之后计算的节点才能在差分模板中用到它，
+ * 节点看到的状态取决于逐行扫描的先后，而同一超平面上的节点在逐行扫描中有先有后。
+ * 因此差分模板可能用到close节点的节点不参与并行，逐个计算，
+ * 计算前按逐行扫描的先后设置模板中close节点的状态
+ */
+typedef struct {
+    MYINT ncls;         ///< 扫描前close节点的个数
+    MYINT *clist;       ///< 扫描前的close节点
+    NODE_MASK *cls;     ///< 仍为close且未更新的节点
+    NODE_MASK *near;    ///< 差分模板可能用到close节点的节点
+    MYINT *list;        ///< near中的节点，按所在超平面排序
+    MYINT *levbeg;      ///< 各超平面的节点在list中的起始位置，长度为超平面数加1
+} SWEEP_CLOSE;
+
+
+/**
+ * 锁定扫描中节点走时或状态有更新时，解锁差分模板可能用到它的节点，
+ * 即沿各坐标轴 maxodr 个节点以内的节点(内联函数)
+ *
+ * @param     g         (in)网格信息
+ * @param     ir        (in)第1维索引
+ * @param     it        (in)第2维索引
+ * @param     ip        (in)第3维索引
+ * @param     idx       (in)展开后的索引
+ * @param     atomicmask (in)是否以原子操作写入标记
+ */
+static inline void sweep_unlock_neighbours(
+    const SWEEP_GRID *g, MYINT ir, MYINT it, MYINT ip, MYINT idx, bool atomicmask)
+{
+    const MYINT ii[3] = {ir, it, ip};
+    const MYINT nn[3] = {g->lay->nr, g->lay->nt, g->lay->np};
+    for(MYINT d=0; d<3; ++d){
+        MYINT stride = g->dnb[2*d+1];
+        for(MYINT k=1; k<=g->maxodr; ++k){
+            if(ii[d]-k >= 0){
+                if(atomicmask)  nodemask_set_atomic(g->active, idx - k*stride);
+                else            nodemask_set(g->active, idx - k*stride);
+            }
+            if(ii[d]+k < nn[d]){
+                if(atomicmask)  nodemask_set_atomic(g->active, idx + k*stride);
+                else            nodemask_set(g->active, idx + k*stride);
+            }
+        }
+    }
+}
+
+
+/**
+ * 在已比较过r、t方向邻点的基础上，补上p方向的2个邻点，再用差分格式更新一个节点的走时(内联函数)
+ *
+ * @param     g         (in)网格信息
+ * @param     TT        (inout)走时场
+ * @param     FMM_stat  (inout)节点状态
+ * @param     ir        (in)第1维索引
+ * @param     it        (in)第2维索引
+ * @param     ip        (in)第3维索引
+ * @param     idx       (in)展开后的索引
+ * @param     mintravt  (in)r、t方向邻点中的最小走时，负数表示没有有效邻点
+ * @param     t_bak     (in)由其得到的走时上限
+ * @param     hp        (in)p方向邻点的距离，用于比较邻点
+ * @param     markalive (in)是否将非far的邻点置为alive
+ * @param     atomicstat (in)是否以原子操作写入状态和锁定标记，其它线程同时更新相邻节点时使用
+ *
+ * @return    走时的减小量，未更新或跳过时为0
+ */
+static inline MYREAL sweep_update_node(
+    const SWEEP_GRID *g, MYREAL *TT, NODE_STAT *FMM_stat,
+    MYINT ir, MYINT it, MYINT ip, MYINT idx, MYREAL mintravt, MYREAL t_bak, double hp, 
+    bool markalive, bool atomicstat)
+{
+    const MYINT *dnb = g->dnb;
+    MYREAL slw = g->Slw[idx];
+
+    if(markalive){
+        for(MYINT k=0; k<6; ++k){
+            MYINT jdx = idx + dnb[k];
+            // forever
+            char jstat = nodestat_get(FMM_stat, jdx);
+            if(jstat==FMM_FAR || jstat==FMM_ALV)  continue;
+            nodestat_set(FMM_stat, jdx, FMM_ALV);
+            // 邻点变为alive后可进入差分模板，同样需要解锁其附近的节点
+            if(g->active != NULL){
+                MYINT sgn = (k%2==0)? -1 : 1;
+                sweep_unlock_neighbours(
+                    g, ir + (k/2==0)*sgn, it + (k/2==1)*sgn, ip + (k/2==2)*sgn, jdx, atomicstat);
+            }
+        }
+    }
+
+    // 锁定扫描：上次计算之后附近没有节点更新，再算一次也不会变化
+    if(g->active != NULL){
+        if(! nodemask_get(g->active, idx))  return 0.0;
+        if(atomicstat)  nodemask_clear_atomic(g->active, idx);
+        else            nodemask_clear(g->active, idx);
+    }
+
+    // 补上p方向的2个邻点，得到6个邻点中的最小走时
+    sweep_pick_neighbour(TT[idx+dnb[4]], hp, slw, &mintravt, &t_bak);
+    sweep_pick_neighbour(TT[idx+dnb[5]], hp, slw, &mintravt, &t_bak);
+
+    if(mintravt < 0.0) return 0.0;
+
+    // if(mintravt > maxnghT)  continue;
+
+    MYREAL travt;
+    char travt_stat;
+
+    // temporary set 
+    MYREAL t_bak0 = TT[idx];
+    if(t_bak0 > t_bak) TT[idx] = t_bak;
+
+    if(g->sphcoord){
+        travt = g->neighbour_travt(
+            g->lay, ir, it, ip, idx, g->maxodr, TT,
+            FMM_stat, slw, g->dr, g->dt*g->rs[ir], g->dp*g->rs[ir]*g->sin_ts[it], 
+            TT[idx], &travt_stat);
+    } else {
+        travt = g->neighbour_travt(
+            g->lay, ir, it, ip, idx, g->maxodr, TT,
+            FMM_stat, slw, g->dr, g->dt, g->dp, 
+            TT[idx], &travt_stat);
+    }
+    
+    // set back
+    TT[idx] = t_bak0;
+
+    if(travt_stat>=0 && travt>0){
+        if(t_bak < travt) travt = t_bak;
+    } else {
+        travt = t_bak;
+    }
+
+    MYREAL update0 = 0.0;
+    if(travt < TT[idx]) {
+        update0 = fabs(TT[idx] - travt);
+        TT[idx] = travt;
+        if(atomicstat)  nodestat_set_atomic(FMM_stat, idx, FMM_ALV);
+        else            nodestat_set(FMM_stat, idx, FMM_ALV);
+        // 差分模板的试探走时随节点自身的走时变化，下次仍需计算该节点
+        if(g->active != NULL){
+            sweep_unlock_neighbours(g, ir, it, ip, idx, atomicstat);
+            if(atomicstat)  nodemask_set_atomic(g->active, idx);
+            else            nodemask_set(g->active, idx);
+        }
+    }
+
+    return update0;
+}
+
+
+/**
+ * 按某一扫描方向逐行扫描一个长方体区域 [r0,r1)x[t0,t1)x[p0,p1) 内的节点。
+ * 每行先向量化地比较r、t方向的邻点，再沿p方向逐点更新
+ *
+ * @param     g         (in)网格信息
+ * @param     TT        (inout)走时场
+ * @param     FMM_stat  (inout)节点状态
+ * @param     isweep    (in)扫描方向，0~7
+ * @param     r0, r1    (in)维度1的索引范围
+ * @param     t0, t1    (in)维度2的索引范围
+ * @param     p0, p1    (in)维度3的索引范围
+ * @param     markalive (in)是否将非far的邻点置为alive
+ * @param     atomicstat (in)是否以原子操作写入状态
+ * @param     row_mint  (out)工作数组，长度至少为 p1-p0
+ * @param     row_tbak  (out)工作数组，长度至少为 p1-p0
+ *
+ * @return    区域内走时的最大更新量
+ */
+static MYREAL sweep_box(
+    const SWEEP_GRID *g, MYREAL *TT, NODE_STAT *FMM_stat, MYINT isweep,
+    MYINT r0, MYINT r1, MYINT t0, MYINT t1, MYINT p0, MYINT p1,
+    bool markalive, bool atomicstat, MYREAL *row_mint, MYREAL *row_tbak)
+{
+    const MYINT *dnb = g->dnb;
+    MYINT begr, stepr, endr;
+    MYINT begt, stept, endt;
+    MYINT begp, stepp, endp;
+
+    if(direcr_arr[isweep]) {
+        begr = r0; stepr = 1; endr = r1;
+    } else {
+        begr = r1-1; stepr = -1; endr = r0-1;
+    }
+    if(direct_arr[isweep]) {
+        begt = t0; stept = 1; endt = t1;
+    } else {
+        begt = t1-1; stept = -1; endt = t0-1;
+    }
+    if(direcp_arr[isweep]) {
+        begp = 0; stepp = 1; endp = p1-p0;
+    } else {
+        begp = p1-p0-1; stepp = -1; endp = -1;
+    }
+
+    MYREAL maxUpdate = 0.0;
+
+    for(MYINT ir=begr; ir!=endr; ir+=stepr){
+    for(MYINT it=begt; it!=endt; it+=stept){
+        // 本行的网格间距
+        double hr = g->dr, ht = g->dt, hp = g->dp;
+        if(g->sphcoord){
+            ht *= g->rs[ir];
+            hp *= g->rs[ir]*g->sin_ts[it];
+        }
+
+        MYINT row = grid_ravel(g->lay, ir, it, p0);
+        sweep_row_rt(
+            p1-p0, TT+row+dnb[0], TT+row+dnb[1], TT+row+dnb[2], TT+row+dnb[3], 
+            hr, ht, g->Slw+row, row_mint, row_tbak);
+
+        for(MYINT i=begp; i!=endp; i+=stepp){
+            MYREAL update0 = sweep_update_node(
+                g, TT, FMM_stat, ir, it, p0+i, row+i, 
+                row_mint[i], row_tbak[i], hp, markalive, atomicstat);
+            if(update0 > maxUpdate)  maxUpdate = update0;
+        }
+    }}
+
+    return maxUpdate;
+}
+
+
+/**
+ * 比较6个邻点并更新一个节点的走时，不标记邻点，以原子操作写入状态(内联函数)
+ *
+ * @param     g         (in)网格信息
+ * @param     TT        (inout)走时场
+ * @param     FMM_stat  (inout)节点状态
+ * @param     ir        (in)第1维索引
+ * @param     it        (in)第2维索引
+ * @param     ip        (in)第3维索引
+ * @param     idx       (in)展开后的索引
+ *
+ * @return    走时的减小量，未更新或跳过时为0
+ */
+static inline MYREAL sweep_update_node_atomic(
+    const SWEEP_GRID *g, MYREAL *TT, NODE_STAT *FMM_stat, MYINT ir, MYINT it, MYINT ip, MYINT idx)
+{
+    const MYINT *dnb = g->dnb;
+    MYREAL slw = g->Slw[idx];
+
+    double hr = g->dr, ht = g->dt, hp = g->dp;
+    if(g->sphcoord){
+        ht *= g->rs[ir];
+        hp *= g->rs[ir]*g->sin_ts[it];
+    }
+
+    MYREAL mintravt = -999.0, t_bak = -999.9;
+    sweep_pick_neighbour(TT[idx+dnb[0]], hr, slw, &mintravt, &t_bak);
+    sweep_pick_neighbour(TT[idx+dnb[1]], hr, slw, &mintravt, &t_bak);
+    sweep_pick_neighbour(TT[idx+dnb[2]], ht, slw, &mintravt, &t_bak);
+    sweep_pick_neighbour(TT[idx+dnb[3]], ht, slw, &mintravt, &t_bak);
+
+    return sweep_update_node(g, TT, FMM_stat, ir, it, ip, idx, mintravt, t_bak, hp, false, true);
+}
+
+
+/**
+ * 第一遍扫描(扫描方向0，各维度索引均递增)中，串行扫描第一个访问到的邻点在逐行扫描中的序号(内联函数)
+ *
+ * @param     lay       (in)网格排布
+ * @param     ir        (in)第1维索引
+ * @param     it        (in)第2维索引
+ * @param     ip        (in)第3维索引
+ *
+ * @return    邻点的序号 (ir*nt+it)*np+ip ，没有邻点时为-1
+ */
+static inline MYINT sweep_close_first(const GRID_LAYOUT *lay, MYINT ir, MYINT it, MYINT ip)
+{
+    MYINT nt = lay->nt, np = lay->np;
+    MYINT key = (ir*nt + it)*np + ip;
+    if(ir > 0)            return key - nt*np;
+    if(it > 0)            return key - np;
+    if(ip > 0)            return key - 1;
+    if(ip < np-1)         return key + 1;
+    if(it < nt-1)         return key + np;
+    if(ir < lay->nr-1)    return key + nt*np;
+    return -1;
+}
+
+
+/**
+ * 记录close节点，标记差分模板可能用到它们的节点，并按超平面 ir+it+ip 排序。
+ * 没有close节点时不申请内存
+ *
+ * @param     g         (in)网格信息
+ * @param     FMM_stat  (in)节点状态
+ * @param     cl        (out)close节点的状态
+ */
+static void sweep_close_init(const SWEEP_GRID *g, const NODE_STAT *FMM_stat, SWEEP_CLOSE *cl)
+{
+    const GRID_LAYOUT *lay = g->lay;
+    MYINT nr = lay->nr, nt = lay->nt, np = lay->np;
+    MYINT nlev = nr + nt + np - 2;
+    *cl = (SWEEP_CLOSE){0};
+
+    for(MYINT ir=0; ir<nr; ++ir){
+    for(MYINT it=0; it<nt; ++it){
+    for(MYINT ip=0; ip<np; ++ip){
+        char stat = nodestat_get(FMM_stat, grid_ravel(lay, ir, it, ip));
+        if(stat!=FMM_FAR && stat!=FMM_ALV)  cl->ncls++;
+    }}}
+    if(cl->ncls == 0)  return;
+
+    cl->clist = (MYINT *)malloc1d(cl->ncls, sizeof(MYINT));
+    cl->cls = nodemask_alloc(lay->size);
+    cl->near = nodemask_alloc(lay->size);
+    cl->levbeg = (MYINT *)calloc(nlev+1, sizeof(MYINT));
+
+    // 节点自身及沿各坐标轴 maxodr 个节点以内的节点
+    MYINT nnear = 0, n = 0;
+    for(MYINT ir=0; ir<nr; ++ir){
+    for(MYINT it=0; it<nt; ++it){
+    for(MYINT ip=0; ip<np; ++ip){
+        MYINT idx = grid_ravel(lay, ir, it, ip);
+        char stat = nodestat_get(FMM_stat, idx);
+        if(stat==FMM_FAR || stat==FMM_ALV)  continue;
+        cl->clist[n++] = idx;
+        nodemask_set(cl->cls, idx);
+
+        const MYINT ii[3] = {ir, it, ip};
+        const MYINT nn[3] = {nr, nt, np};
+        for(MYINT d=0; d<3; ++d){
+            MYINT stride = g->dnb[2*d+1];
+            for(MYINT k=-g->maxodr; k<=g->maxodr; ++k){
+                if(ii[d]+k < 0 || ii[d]+k >= nn[d])  continue;
+                MYINT jdx = idx + k*stride;
+                if(nodemask_get(cl->near, jdx))  continue;
+                nodemask_set(cl->near, jdx);
+                cl->levbeg[ir+it+ip+k+1]++;
+                nnear++;
+            }
+        }
+    }}}
+
+    for(MYINT lev=0; lev<nlev; ++lev)  cl->levbeg[lev+1] += cl->levbeg[lev];
+    cl->list = (MYINT *)malloc1d(nnear, sizeof(MYINT));
+    MYINT *pos = (MYINT *)malloc1d(nlev, sizeof(MYINT));
+    for(MYINT lev=0; lev<nlev; ++lev)  pos[lev] = cl->levbeg[lev];
+    for(MYINT ir=0; ir<nr; ++ir){
+    for(MYINT it=0; it<nt; ++it){
+    for(MYINT ip=0; ip<np; ++ip){
+        MYINT idx = grid_ravel(lay, ir, it, ip);
+        if(nodemask_get(cl->near, idx))  cl->list[pos[ir+it+ip]++] = idx;
+    }}}
+    free(pos);
+}
+
+
+/**
+ * 释放close节点状态的内存
+ *
+ * @param     cl        (inout)close节点的状态
+ */
+static void sweep_close_free(SWEEP_CLOSE *cl)
+{
+    free(cl->clist);
+    free(cl->cls);
+    free(cl->near);
+    free(cl->list);
+    free(cl->levbeg);
+    *cl = (SWEEP_CLOSE){0};
+}
+
+
+/**
+ * 按逐行扫描的先后设置差分模板中close节点的状态，再更新该节点
+ *
+ * @param     g         (in)网格信息
+ * @param     cl        (inout)close节点的状态
+ * @param     TT        (inout)走时场
+ * @param     FMM_stat  (inout)节点状态
+ * @param     idx       (in)展开后的索引
+ *
+ * @return    走时的减小量
+ */
+static MYREAL sweep_close_update(const SWEEP_GRID *g, SWEEP_CLOSE *cl, MYREAL *TT, NODE_STAT *FMM_stat, MYINT idx)
+{
+    const GRID_LAYOUT *lay = g->lay;
+    MYINT ir, it, ip;
+    grid_unravel(lay, idx, &ir, &it, &ip);
+    MYINT key = (ir*lay->nt + it)*lay->np + ip;
+
+    const MYINT ii[3] = {ir, it, ip};
+    const MYINT nn[3] = {lay->nr, lay->nt, lay->np};
+    for(MYINT d=0; d<3; ++d){
+        MYINT stride = g->dnb[2*d+1];
+        for(MYINT k=-g->maxodr; k<=g->maxodr; ++k){
+            if(k==0 || ii[d]+k < 0 || ii[d]+k >= nn[d])  continue;
+            MYINT jdx = idx + k*stride;
+            if(! nodemask_get(cl->cls, jdx))  continue;
+            MYINT jj[3] = {ir, it, ip};
+            jj[d] += k;
+            MYINT first = sweep_close_first(lay, jj[0], jj[1], jj[2]);
+            nodestat_set_atomic(FMM_stat, jdx, (first >= 0 && key >= first)? FMM_ALV : FMM_CLS);
+        }
+    }
+
+    MYREAL update0 = sweep_update_node_atomic(g, TT, FMM_stat, ir, it, ip, idx);
+    // 走时更新后即为alive，之后不再改变
+    if(update0 > 0.0 && nodemask_get(cl->cls, idx))  nodemask_clear(cl->cls, idx);
+    return update0;
+}
+
+
+/**
+ * 第一遍扫描结束后，将close节点置为alive，并补上串行扫描标记它们时对附近节点的解锁。
+ * 串行扫描在访问第一个邻点时解锁，此后才计算的节点本来就未锁定，只需解锁在此之前计算过的节点
+ *
+ * @param     g         (in)网格信息
+ * @param     cl        (inout)close节点的状态，释放内存
+ * @param     FMM_stat  (inout)节点状态
+ */
+static void sweep_close_finish(const SWEEP_GRID *g, SWEEP_CLOSE *cl, NODE_STAT *FMM_stat)
+{
+    const GRID_LAYOUT *lay = g->lay;
+    MYINT nt = lay->nt, np = lay->np;
+
+    for(MYINT n=0; n<cl->ncls; ++n){
+        MYINT idx = cl->clist[n];
+        MYINT ir, it, ip;
+        grid_unravel(lay, idx, &ir, &it, &ip);
+        MYINT key = (ir*nt + it)*np + ip;
+        MYINT first = sweep_close_first(lay, ir, it, ip);
+        if(first < 0)  continue;
+
+        // 节点在第一个邻点之前访问并已更新时，串行扫描不再标记它
+        bool updated = ! nodemask_get(cl->cls, idx);
+        if(updated && first > key)  continue;
+        nodestat_set(FMM_stat, idx, FMM_ALV);
+
+        if(g->active == NULL)  continue;
+        const MYINT ii[3] = {ir, it, ip};
+        const MYINT nn[3] = {lay->nr, nt, np};
+        const MYINT kk[3] = {nt*np, np, 1};
+        for(MYINT d=0; d<3; ++d){
+            MYINT stride = g->dnb[2*d+1];
+            for(MYINT k=-g->maxodr; k<=g->maxodr; ++k){
+                if(k==0 || ii[d]+k < 0 || ii[d]+k >= nn[d])  continue;
+                if(key + k*kk[d] < first)  nodemask_set(g->active, idx + k*stride);
+            }
+        }
+    }
+
+    sweep_close_free(cl);
+}
+
+
+/**
+ * 超平面并行扫描：沿扫描方向第 a, b, c 个节点所在的平面 a+b+c=lev 上，
+ * 节点的邻点和差分模板都在其它平面上，同一平面的节点可同时更新，
+ * 平面之间依次推进，每个节点看到的邻点走时与逐行扫描相同
+ *
+ * @param     g         (in)网格信息
+ * @param     TT        (inout)走时场
+ * @param     FMM_stat  (inout)节点状态
+ * @param     isweep    (in)扫描方向，0~7
+ * @param     cl        (inout)第一遍扫描时close节点的状态，isweep须为0；
+ *                      为NULL时非far的节点须已是alive
+ *
+ * @return    走时的最大更新量
+ */
+static MYREAL sweep_plane(const SWEEP_GRID *g, MYREAL *TT, NODE_STAT *FMM_stat, MYINT isweep, SWEEP_CLOSE *cl)
+{
+    const GRID_LAYOUT *lay = g->lay;
+    MYINT nr = lay->nr, nt = lay->nt, np = lay->np;
+    MYINT nlev = nr + nt + np - 2;
+    MYREAL maxUpdate = 0.0;
+
+    #pragma omp parallel default(shared) reduction(max:maxUpdate)
+    for(MYINT lev=0; lev<nlev; ++lev){
+        MYINT amin = lev - (nt-1) - (np-1);
+        if(amin < 0)  amin = 0;
+        MYINT amax = (lev < nr-1)? lev : nr-1;
+
+        #pragma omp for schedule(dynamic, 1)
+        for(MYINT a=amin; a<=amax; ++a){
+            MYINT ir = (direcr_arr[isweep])? a : nr-1-a;
+            MYINT bmin = lev - a - (np-1);
+            if(bmin < 0)  bmin = 0;
+            MYINT bmax = (lev - a < nt-1)? lev - a : nt-1;
+
+            for(MYINT b=bmin; b<=bmax; ++b){
+                MYINT it = (direct_arr[isweep])? b : nt-1-b;
+                MYINT ip = (direcp_arr[isweep])? lev-a-b : np-1-(lev-a-b);
+                MYINT idx = grid_ravel(lay, ir, it, ip);
+                if(cl != NULL && cl->near != NULL && nodemask_get(cl->near, idx))  continue;
+
+                MYREAL update0 = sweep_update_node_atomic(g, TT, FMM_stat, ir, it, ip, idx);
+                if(update0 > maxUpdate)  maxUpdate = update0;
+            }
+        }
+
+        // 差分模板可能用到close节点的节点，同一平面上只有它们会读写close节点的状态
+        if(cl != NULL && cl->near != NULL && cl->levbeg[lev+1] > cl->levbeg[lev]){
+            #pragma omp single
+            for(MYINT n=cl->levbeg[lev]; n<cl->levbeg[lev+1]; ++n){
+                MYREAL update0 = sweep_close_update(g, cl, TT, FMM_stat, cl->list[n]);
+                if(update0 > maxUpdate)  maxUpdate = update0;
+            }
+        }
+    }
+
+    return maxUpdate;
+}
+
+
+/**
+ * 分块扫描：网格划分为 FSM_TILE_RT x FSM_TILE_RT x FSM_TILE_P 的块，
+ * 块按扫描方向上的块序号之和 A+B+C 分层推进，同一层的块互不相邻，可同时扫描，
+ * 每个节点看到的邻点走时与逐行扫描相同。
+ * 上一遍扫描没有更新、且之后相邻块也没有更新的块已达到局部不动点，直接跳过
+ *
+ * @param     g         (in)网格信息
+ * @param     TT        (inout)走时场
+ * @param     FMM_stat  (inout)节点状态，非far的节点须已是alive
+ * @param     isweep    (in)扫描方向，0~7
+ * @param     tl        (inout)各块状态
+ *
+ * @return    走时的最大更新量
+ */
+static MYREAL sweep_tiles(const SWEEP_GRID *g, MYREAL *TT, NODE_STAT *FMM_stat, MYINT isweep, SWEEP_TILES *tl)
+{
+    const GRID_LAYOUT *lay = g->lay;
+    MYINT nbr = tl->nbr, nbt = tl->nbt, nbp = tl->nbp;
+    MYINT nlev = nbr + nbt + nbp - 2;
+    MYREAL maxUpdate = 0.0;
+
+    #pragma omp parallel default(shared) reduction(max:maxUpdate)
+    {
+        MYREAL *row_mint = (MYREAL *)malloc1d(FSM_TILE_P, sizeof(MYREAL));
+        MYREAL *row_tbak = (MYREAL *)malloc1d(FSM_TILE_P, sizeof(MYREAL));
+
+        for(MYINT lev=0; lev<nlev; ++lev){
+            #pragma omp for schedule(dynamic, 1)
+            for(MYINT ab=0; ab<nbr*nbt; ++ab){
+                MYINT a = ab / nbt, b = ab % nbt, c = lev - a - b;
+                if(c < 0 || c >= nbp)  continue;
+
+                MYINT br = (direcr_arr[isweep])? a : nbr-1-a;
+                MYINT bt = (direct_arr[isweep])? b : nbt-1-b;
+                MYINT bp = (direcp_arr[isweep])? c : nbp-1-c;
+                MYINT itl = (br*nbt + bt)*nbp + bp;
+                if(! tl->dirty[itl])  continue;
+                tl->dirty[itl] = 0;
+
+                MYINT r0 = br*FSM_TILE_RT, t0 = bt*FSM_TILE_RT, p0 = bp*FSM_TILE_P;
+                MYINT r1 = (r0+FSM_TILE_RT < lay->nr)? r0+FSM_TILE_RT : lay->nr;
+                MYINT t1 = (t0+FSM_TILE_RT < lay->nt)? t0+FSM_TILE_RT : lay->nt;
+                MYINT p1 = (p0+FSM_TILE_P < lay->np)? p0+FSM_TILE_P : lay->np;
+
+                MYREAL update = sweep_box(
+                    g, TT, FMM_stat, isweep, r0, r1, t0, t1, p0, p1, 
+                    false, true, row_mint, row_tbak);
+                if(update > maxUpdate)  maxUpdate = update;
+
+                // 一遍扫描中没有节点更新，说明块内已是不动点，在相邻块更新前再扫描也不会有变化
+                if(update <= 0.0)  continue;
+
+                // 走时有更新，本块和相邻块都需要再扫描。
+                // 同一层的块互不相邻，但可能同时写入下一层同一块的标记
+                tl->dirty[itl] = 1;
+                const MYINT nbidx[6][3] = {
+                    {br-1, bt, bp}, {br+1, bt, bp}, {br, bt-1, bp}, 
+                    {br, bt+1, bp}, {br, bt, bp-1}, {br, bt, bp+1}};
+                for(MYINT k=0; k<6; ++k){
+                    MYINT jr = nbidx[k][0], jt = nbidx[k][1], jp = nbidx[k][2];
+                    if(jr < 0 || jr >= nbr || jt < 0 || jt >= nbt || jp < 0 || jp >= nbp)  continue;
+                    #pragma omp atomic write
+                    tl->dirty[(jr*nbt + jt)*nbp + jp] = 1;
+                }
+            }
+        }
+
+        free(row_mint);
+        free(row_tbak);
+    }
+
+    return maxUpdate;
+}
+
+
 void set_fsm_num_threads(MYINT num_threads){
 #ifdef _OPENMP
     omp_set_num_threads(num_threads);
@@ -34,26 +711,61 @@ MYINT FastSweeping(
     MYINT maxodr,  const MYREAL *Slw, 
     MYREAL *TT, bool sphcoord, 
     MYINT rfgfac, MYINT rfgn, bool printbar, 
-    double eps, MYINT maxLoops, bool isparallel)
+    double eps, MYINT maxLoops, MYINT parallel, bool locking)
 {
     // 程序运行开始时间
     struct timeval begin_t;
     gettimeofday(&begin_t, NULL);
 
+    NODE_STAT *FMM_stat = nodestat_alloc(nr*nt*np);
+
+    MYINT nsweep;
+    nsweep = FastSweeping_stat(
+        rs, nr, ts, nt, ps, np, rr, tt, pp,
+        maxodr, Slw, TT, FMM_stat, sphcoord,
+        rfgfac, rfgn, printbar, eps, maxLoops, parallel, locking, true);
+
+    free(FMM_stat);
+
+
+    // 程序运行结束时间
+    struct timeval end_t;
+    gettimeofday(&end_t, NULL);
+    if(printbar) printf("Runtime: %.3f s\n", (end_t.tv_sec - begin_t.tv_sec) + (end_t.tv_usec - begin_t.tv_usec) / 1e6);
+    fflush(stdout);
+
+    return nsweep;
+}
+
+
+MYINT FastSweeping_stat(
+    const double *rs, MYINT nr, 
+    const double *ts, MYINT nt, 
+    const double *ps, MYINT np,
+    double rr,  double tt, double pp,
+    MYINT maxodr,  const MYREAL *Slw, 
+    MYREAL *TT, NODE_STAT *FMM_stat, bool sphcoord, 
+    MYINT rfgfac, MYINT rfgn, bool printbar, 
+    double eps, MYINT maxLoops, MYINT parallel, bool locking, bool useseeds)
+{
     MYINT ntp=nt*np;
     MYINT nrtp=nr*ntp;
-    char *FMM_stat = (char *)malloc1d(nrtp, sizeof(char));
+    nodestat_fill(FMM_stat, nrtp, FMM_FAR);
 
     // All non-zero value of TT will be treated as efficient value,
     // and set FMM_ALV
     bool allzeroTT = true; 
-    for(MYINT i=0; i<nrtp; ++i){
-        if(TT[i] == 0.0){
-            TT[i] = 9.9e30f;// init FAR Traveltime 
-            FMM_stat[i] = FMM_FAR;
-        } else {
-            FMM_stat[i] = FMM_ALV;
-            allzeroTT = false;
+    if(! useseeds){
+        for(MYINT i=0; i<nrtp; ++i)  TT[i] = 9.9e30f;
+    } 
+    else {
+        for(MYINT i=0; i<nrtp; ++i){
+            if(TT[i] == 0.0){
+                TT[i] = 9.9e30f;// init FAR Traveltime 
+            } else {
+                nodestat_set(FMM_stat, i, FMM_ALV);
+                allzeroTT = false;
+            }
         }
     }
 
@@ -67,7 +779,7 @@ MYINT FastSweeping(
                 maxodr, Slw, TT, 
                 FMM_stat, sphcoord,
                 rfgfac, rfgn, printbar,
-                NULL, NULL, NULL, NULL, NULL);
+                NULL, NULL, NULL, NULL, NULL, FMM_QUEUE_HEAP);
         } else {
             init_source_TT(
             rs, nr, ts, nt, ps, np, 
@@ -85,16 +797,7 @@ MYINT FastSweeping(
         ps, np,
         maxodr, Slw, TT,
         FMM_stat, sphcoord, printbar, 
-        eps, maxLoops, isparallel);
-
-    free(FMM_stat);
-
-
-    // 程序运行结束时间
-    struct timeval end_t;
-    gettimeofday(&end_t, NULL);
-    if(printbar) printf("Runtime: %.3f s\n", (end_t.tv_sec - begin_t.tv_sec) + (end_t.tv_usec - begin_t.tv_usec) / 1e6);
-    fflush(stdout);
+        eps, maxLoops, parallel, locking);
 
     return nsweep;
 }
@@ -106,10 +809,12 @@ MYINT FastSweeping_with_initial(
     const double *ts, MYINT nt, 
     const double *ps, MYINT np,
     MYINT maxodr,  const MYREAL *Slw, MYREAL *TT, 
-    char *FMM_stat, bool sphcoord, bool printbar, 
-    double eps, MYINT maxLoops, bool isparallel)
+    NODE_STAT *FMM_stat, bool sphcoord, bool printbar, 
+    double eps, MYINT maxLoops, MYINT parallel, bool locking)
 {
-    if(! isparallel) set_fsm_num_threads(1);
+    const bool iscopies = (parallel == FSM_PARALLEL_COPIES);
+    const bool isplane = (parallel == FSM_PARALLEL_PLANE);
+    const bool istiles = (parallel == FSM_PARALLEL_TILES);
 
     double dr = (nr>1)? rs[1] - rs[0] : 0.0;
     double dt = (nt>1)? ts[1] - ts[0] : 0.0;
@@ -124,27 +829,69 @@ MYINT FastSweeping_with_initial(
         }
     }
 
-    MYINT ntp=nt*np;
-    MYINT nrtp=nr*ntp;
-
 
-    // DON'T CHANGE.
-    static const char xr[6] = {-1, 1,  0, 0,  0, 0};
-    static const char xt[6] = { 0, 0, -1, 1,  0, 0};
-    static const char xp[6] = { 0, 0,  0, 0, -1, 1};
-    const double hrtp[6] = {dr, dr, dt, dt, dp, dp};
-    static const bool direcr_arr[8] = {1, 0, 0, 1, 1, 0, 0, 1};
-    static const bool direct_arr[8] = {1, 1, 0, 0, 1, 1, 0, 0};
-    static const bool direcp_arr[8] = {1, 1, 1, 1, 0, 0, 0, 0};
+    // 按行优先顺序扫描，在带一层幽灵节点的行优先数组上计算。
+    // 幽灵节点走时为9.9e30，初始为far，与未到达的节点一样不会被选为最小邻点，也不会用于差分模板，
+    // 邻点和差分模板的访问都不需要检查索引范围
+    GRID_LAYOUT lay;
+    grid_layout_init(&lay, nr, nt, np, false, 1);
+    MYINT nlay = lay.size;
+
+    MYREAL *TT_in = TT;
+    NODE_STAT *FMM_stat_in = FMM_stat;
+    TT = (MYREAL *)malloc1d(nlay, sizeof(MYREAL));
+    grid_to_layout(&lay, TT_in, TT, 9.9e30f);
+    MYREAL *Slw_pad = (MYREAL *)malloc1d(nlay, sizeof(MYREAL));
+    grid_to_layout(&lay, Slw, Slw_pad, Slw[0]);
+    FMM_stat = nodestat_alloc(nlay);
+    nodestat_fill(FMM_stat, nlay, FMM_FAR);
+    grid_to_layout_stat(&lay, FMM_stat_in, FMM_stat);
+
+    SWEEP_GRID g = {
+        .lay = &lay, 
+        .neighbour_travt = get_neighbour_travt_func(maxodr, true),
+        .maxodr = maxodr,
+        // 6个邻点相对于当前节点的索引偏移量
+        .dnb = {
+            lay.offr[-1] - lay.offr[0], lay.offr[1] - lay.offr[0], 
+            lay.offt[-1] - lay.offt[0], lay.offt[1] - lay.offt[0], 
+            lay.offp[-1] - lay.offp[0], lay.offp[1] - lay.offp[0]},
+        .Slw = Slw_pad,
+        .sphcoord = sphcoord,
+        .rs = rs, .sin_ts = sin_ts,
+        .dr = dr, .dt = dt, .dp = dp,
+        .active = NULL};
+
+    // 锁定扫描时，一开始所有节点都需要计算。多份数组的并行方式不支持锁定
+    if(locking && !iscopies){
+        g.active = nodemask_alloc(nlay);
+        for(MYINT i=0; i<nlay; ++i)  nodemask_set(g.active, i);
+    }
 
 
     MYREAL *TT_thread_all = NULL;
-    char *FMM_stat_thread_all = NULL;
+    NODE_STAT *FMM_stat_thread_all = NULL;
+    MYINT nstatw = nodestat_words(nlay);
     
 
-    if(isparallel){
-        TT_thread_all = (MYREAL *)malloc1d(nrtp*8, sizeof(MYREAL));
-        FMM_stat_thread_all = (char *)malloc1d(nrtp*8, sizeof(char));
+    if(iscopies){
+        TT_thread_all = (MYREAL *)malloc1d(nlay*8, sizeof(MYREAL));
+        FMM_stat_thread_all = (NODE_STAT *)malloc1d(nstatw*8, sizeof(NODE_STAT));
+    }
+
+    // 超平面和分块并行时多个节点同时更新，第一遍扫描按逐行扫描的先后将close节点置为alive，
+    // 结果与串行扫描相同，也与线程数无关
+    SWEEP_CLOSE cl = {0};
+    if(isplane || istiles)  sweep_close_init(&g, FMM_stat, &cl);
+
+    SWEEP_TILES tl = {0};
+    if(istiles){
+        tl.nbr = (nr + FSM_TILE_RT - 1) / FSM_TILE_RT;
+        tl.nbt = (nt + FSM_TILE_RT - 1) / FSM_TILE_RT;
+        tl.nbp = (np + FSM_TILE_P - 1) / FSM_TILE_P;
+        MYINT ntile = tl.nbr*tl.nbt*tl.nbp;
+        tl.dirty = (char *)malloc1d(ntile, sizeof(char));
+        for(MYINT i=0; i<ntile; ++i)  tl.dirty[i] = 1;
     }
     
 
@@ -156,166 +903,66 @@ MYINT FastSweeping_with_initial(
 
     while(iloop++ < nloop){
 
-        if(isparallel){
+        if(iscopies){
             // init and copy data 
-            for(MYINT i=0; i<nrtp; ++i){
-                char stat = FMM_FAR;
-                if(FMM_stat[i]!=FMM_FAR) stat = FMM_ALV;
+            for(MYINT i=0; i<nlay; ++i){
+                for(MYINT k=0; k<8; ++k){
+                    TT_thread_all[i+k*nlay] = TT[i];
+                }
+            }
+            // 非 far 的节点均设为 alive，按字节处理：2比特中任一位非零则置为 alive(2)
+            for(MYINT i=0; i<nstatw; ++i){
+                NODE_STAT w = FMM_stat[i];
+                w = (NODE_STAT)(((w | (w>>1)) & 0x55) << 1);
                 for(MYINT k=0; k<8; ++k){
-                    TT_thread_all[i+k*nrtp] = TT[i];
-                    FMM_stat_thread_all[i+k*nrtp] = stat;
+                    FMM_stat_thread_all[i+k*nstatw] = w;
                 }
             }
         }
 
+        // 第一轮扫描时需将到达过的邻点置为alive，之后所有节点都已是alive
+        const bool markalive = (iloop == 1);
 
-        #pragma omp parallel for default(shared)
+        #pragma omp parallel for default(shared) if(iscopies)
         for(MYINT isweep=0; isweep<8; ++isweep){
             // not use break, but continue, to make thread safe
             // break in advance for sequential mode
-            if(!isparallel && iloop > 1 && eps > 0.0 && maxUpdate <= eps) continue;
+            if(!iscopies && iloop > 1 && eps > 0.0 && maxUpdate <= eps) continue;
+
+            // 第一遍扫描以超平面的方式计算，之后所有close节点都已是alive
+            if(isplane || (istiles && markalive && isweep == 0)){
+                maxUpdate = sweep_plane(&g, TT, FMM_stat, isweep, (markalive && isweep == 0)? &cl : NULL);
+                if(markalive && isweep == 0)  sweep_close_finish(&g, &cl, FMM_stat);
+                continue;
+            }
+            if(istiles){
+                maxUpdate = sweep_tiles(&g, TT, FMM_stat, isweep, &tl);
+                continue;
+            }
 
             MYREAL *TT_thread = NULL;
-            char *FMM_stat_thread = NULL;
+            NODE_STAT *FMM_stat_thread = NULL;
 
-            if(isparallel){
-                TT_thread = TT_thread_all + isweep*nrtp;
-                FMM_stat_thread = FMM_stat_thread_all + isweep*nrtp;
+            if(iscopies){
+                TT_thread = TT_thread_all + isweep*nlay;
+                FMM_stat_thread = FMM_stat_thread_all + isweep*nstatw;
             } else {
                 TT_thread = TT;
                 FMM_stat_thread = FMM_stat;
-                maxUpdate = 0.0;
-            }
-            
-
-            MYINT begr, stepr, endr;
-            MYINT begt, stept, endt;
-            MYINT begp, stepp, endp;
-            begr = begt = begp = 0;
-            stepr = stept = stepp = 1;
-            endr = nr;
-            endt = nt;
-            endp = np;
-            bool direcr, direct, direcp;
-            direcr = direct = direcp = false;
-            MYINT idx;
-
-
-            direcr = direcr_arr[isweep];
-            direct = direct_arr[isweep];
-            direcp = direcp_arr[isweep];
-
-            if(direcr) {
-                begr = 0; stepr = 1; endr = nr;
-            } else {
-                begr = nr-1; stepr = -1; endr = -1;
-            }
-            if(direct) {
-                begt = 0; stept = 1; endt = nt;
-            } else {
-                begt = nt-1; stept = -1; endt = -1;
-            }
-            if(direcp) {
-                begp = 0; stepp = 1; endp = np;
-            } else {
-                begp = np-1; stepp = -1; endp = -1;
             }
 
-            MYREAL mintravt=-999.0;
-            double mintravt_h=0.0;
-            MYREAL slw;
-            MYREAL update0;
+            // 每行r、t方向邻点的比较结果
+            MYREAL *row_mint = (MYREAL *)malloc1d(np, sizeof(MYREAL));
+            MYREAL *row_tbak = (MYREAL *)malloc1d(np, sizeof(MYREAL));
 
             // Start Sweeping
-            for(MYINT ir=begr; ir!=endr; ir+=stepr){
-            for(MYINT it=begt; it!=endt; it+=stept){
-            for(MYINT ip=begp; ip!=endp; ip+=stepp){
-                ravel_index(&idx, ntp, np, ir, it, ip);
-                slw = Slw[idx];
-
-                // find minimum traveltime in 6 neighbours
-                MYREAL t_bak=-999.9, t_bak0=-999.9;
-                mintravt=-999.0;
-                mintravt_h=0.0;
-                for(MYINT k=0; k<6; ++k){
-                    MYINT jdx, iir, iit, iip;
-                    iir = ir+xr[k];
-                    iit = it+xt[k];
-                    iip = ip+xp[k];
-
-                    if(iir<0 || iir>nr-1) continue;
-                    if(iit<0 || iit>nt-1) continue;
-                    if(iip<0 || iip>np-1) continue;
-
-                    ravel_index(&jdx, ntp, np, iir, iit, iip);
-
-                    if(FMM_stat_thread[jdx]==FMM_FAR) continue; 
-
-                    // forever
-                    FMM_stat_thread[jdx] = FMM_ALV;
-
-                    if(mintravt > TT_thread[jdx] || mintravt < 0) {
-                        mintravt = TT_thread[jdx];
-                        mintravt_h = hrtp[k];
-                        // modify interval for spherical coordinate
-                        if(sphcoord && k>=2){
-                            if(k<4) mintravt_h *= rs[ir];
-                            else if(k<6) mintravt_h *= rs[ir]*sin_ts[it];
-                        }
-
-                        t_bak0 = mintravt + mintravt_h * slw;
-                        if(t_bak > t_bak0 || t_bak < 0){
-                            t_bak = t_bak0;
-                        }
-                    }
-                }
-                if(mintravt < 0.0) continue;
-            
-                // if(mintravt > maxnghT)  continue;
-
-                MYREAL travt;
-                char travt_stat;
-
-                // temporary set 
-                t_bak0 = TT_thread[idx];
-                if(t_bak0 > t_bak) TT_thread[idx] = t_bak;
-
-                if(sphcoord){
-                    travt = get_neighbour_travt(
-                        nr, nt, np, ntp,
-                        ir, it, ip, idx,
-                        maxodr, TT_thread,
-                        FMM_stat_thread, slw, dr, dt*rs[ir], dp*rs[ir]*sin_ts[it], 
-                        &travt_stat);
-                } else {
-                    travt = get_neighbour_travt(
-                        nr, nt, np, ntp,
-                        ir, it, ip, idx,
-                        maxodr, TT_thread,
-                        FMM_stat_thread, slw, dr, dt, dp, 
-                        &travt_stat);
-                }
-                // set back
-                TT_thread[idx] = t_bak0;
-
-                if(travt_stat>=0 && travt>0){
-                    if(t_bak < travt) travt = t_bak;
-                } else {
-                    travt = t_bak;
-                }
-                
-
-                if(travt < TT_thread[idx]) {
-                    if(! isparallel){
-                        update0 = fabs(TT_thread[idx] - travt);
-                        if(update0 > maxUpdate) maxUpdate = update0;
-                    }
+            MYREAL update = sweep_box(
+                &g, TT_thread, FMM_stat_thread, isweep, 0, nr, 0, nt, 0, np, 
+                markalive, false, row_mint, row_tbak);
+            if(! iscopies)  maxUpdate = update;
 
-                    TT_thread[idx] = travt;
-                    FMM_stat_thread[idx] = FMM_ALV;
-                }
-                
-            }}} // end sweep in one direction
+            free(row_mint);
+            free(row_tbak);
 
             // if(!isparallel)  printf("isweep=%d, maxUpdate=%f\n", isweep, maxUpdate);
 
@@ -323,14 +970,14 @@ MYINT FastSweeping_with_initial(
 
         nsweep += 8;
 
-        if(isparallel){
+        if(iscopies){
             // merge results
             maxUpdate = 0.0;
             MYREAL minTT, update;
-            for(MYINT i=0; i<nrtp; ++i){
+            for(MYINT i=0; i<nlay; ++i){
                 minTT = 9.9e30;
                 for(MYINT k=0; k<8; ++k){
-                    update = TT_thread_all[i+k*nrtp];
+                    update = TT_thread_all[i+k*nlay];
                     if(minTT > update) minTT = update;
                 }
 
@@ -348,16 +995,23 @@ MYINT FastSweeping_with_initial(
         // break in advance
         if(eps > 0.0 && maxUpdate <= eps) break;
 
-        for(MYINT i=0; i<nrtp; ++i){
-            FMM_stat[i] = FMM_ALV;
-        }
+        nodestat_fill(FMM_stat, nlay, FMM_ALV);
 
     }  // end while loop
 
+    grid_from_layout(&lay, TT, TT_in);
+    grid_from_layout_stat(&lay, FMM_stat, FMM_stat_in);
+    free(TT);
+    free(Slw_pad);
+    free(FMM_stat);
+
+    grid_layout_free(&lay);
     if(TT_thread_all!=NULL)          free(TT_thread_all);
     if(FMM_stat_thread_all!=NULL)    free(FMM_stat_thread_all);
+    if(tl.dirty!=NULL)               free(tl.dirty);
+    sweep_close_free(&cl);
+    if(g.active!=NULL)               free(g.active);
 
 
     return nsweep;
 }
-
@@ -0,0 +1,114 @@
+/**
+ * @file   gradient.c
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "const.h"
+#include "mallocfree.h"
+#include "diff.h"
+#include "index.h"
+#include "layout.h"
+#include "nodestat.h"
+#include "fmm.h"
+#include "gradient.h"
+
+
+void upwind_stencil(
+    const GRID_LAYOUT *lay, MYINT ir, MYINT it, MYINT ip, MYINT maxodr,
+    const MYREAL *TT, const NODE_STAT *FMM_stat, const double h[3],
+    double dif[3], double acoef[3], char sgn[3], MYINT odrs[3], MYINT jdxs[3][3])
+{
+    MYINT idx = grid_ravel(lay, ir, it, ip);
+    MYREAL t0 = TT[idx];
+    MYREAL tarr[2][4];
+    MYINT jarr[2][3];
+    MYINT odr[2];
+    double a[2], d[2];
+
+    for(MYINT dim=0; dim<3; ++dim){
+        for(MYINT side=0; side<2; ++side){
+            MYINT s = (side==0)? -1 : 1;
+            MYREAL tprev = t0;
+            tarr[side][0] = t0;
+            for(odr[side]=0; odr[side]<maxodr; ++odr[side]){
+                MYINT n = s*(odr[side]+1);
+                MYINT jdx = grid_ravel(lay, ir+(dim==0)*n, it+(dim==1)*n, ip+(dim==2)*n);
+                if(FMM_stat!=NULL && nodestat_get(FMM_stat, jdx)!=FMM_ALV) break;
+                if(TT[jdx] >= tprev) break;
+                tarr[side][odr[side]+1] = tprev = TT[jdx];
+                jarr[side][odr[side]] = jdx;
+            }
+            get_diff_odr123(odr[side], tarr[side], h[dim], &a[side], NULL, &d[side]);
+        }
+        MYINT side = (d[0] < d[1])? 1 : 0;
+        if(d[side] < 0.0)  odr[side] = 0;
+        odrs[dim] = odr[side];
+        sgn[dim] = (odr[side] > 0)? ((side==0)? -1 : 1) : 0;
+        dif[dim] = (odr[side] > 0)? d[side] : 0.0;
+        acoef[dim] = (odr[side] > 0)? a[side] : 0.0;
+        for(MYINT i=0; i<odr[side]; ++i)  jdxs[dim][i] = jarr[side][i];
+    }
+}
+
+
+void traveltime_gradient(
+    const double *rs, MYINT nr,
+    const double *ts, MYINT nt,
+    const double *ps, MYINT np,
+    MYINT maxodr, const MYREAL *TT, bool sphcoord,
+    MYREAL *gTr, MYREAL *gTt, MYREAL *gTp)
+{
+    MYINT ntp = nt*np;
+    MYINT nrtp = nr*ntp;
+    double dr = (nr>1)? rs[1] - rs[0] : 0.0;
+    double dt = (nt>1)? ts[1] - ts[0] : 0.0;
+    double dp = (np>1)? ps[1] - ps[0] : 0.0;
+
+    // convenient arrays
+    double sin_ts[nt];
+    if(sphcoord){
+        for(MYINT it=0; it<nt; ++it){
+            sin_ts[it] = fabs(sin(ts[it]));
+            if(sin_ts[it] < 1e-12) sin_ts[it] += 1e-12;
+        }
+    }
+
+    // 带幽灵层的排布，差分模板遇到走时为9.9e30的幽灵节点即停止，不需要检查索引范围
+    GRID_LAYOUT lay;
+    grid_layout_init(&lay, nr, nt, np, false, FMM_GHOST_LAYERS);
+    MYREAL *TT_lay = (MYREAL *)malloc1d(lay.size, sizeof(MYREAL));
+    grid_to_layout(&lay, TT, TT_lay, 9.9e30f);
+
+    #pragma omp parallel for schedule(static) default(shared)
+    for(MYINT idx=0; idx<nrtp; ++idx){
+        MYINT ir, it, ip;
+        unravel_index(idx, ntp, np, &ir, &it, &ip);
+        gTr[idx] = gTt[idx] = gTp[idx] = 0.0;
+        if(TT[idx] >= 9.9e30)  continue;
+
+        double h[3] = {dr, dt, dp};
+        if(sphcoord){
+            h[1] *= rs[ir];
+            h[2] *= rs[ir]*sin_ts[it];
+        }
+        double dif[3], acoef[3];
+        char sgn[3];
+        MYINT odrs[3], jdxs[3][3];
+        upwind_stencil(&lay, ir, it, ip, maxodr, TT_lay, NULL, h, dif, acoef, sgn, odrs, jdxs);
+
+        // 上游节点在索引减小的一侧时，走时沿该维度增大
+        gTr[idx] = - sgn[0] * dif[0];
+        gTt[idx] = - sgn[1] * dif[1];
+        gTp[idx] = - sgn[2] * dif[2];
+    }
+
+    free(TT_lay);
+    grid_layout_free(&lay);
+}
@@ -9,19 +9,28 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 
 #include "const.h"
 #include "heapsort.h"
 #include "index.h"
 
 
+/**
+ * 比较两个节点的先后：走时小者优先，走时相等时节点索引小者优先，
+ * 使二叉堆与d叉堆的弹出顺序完全确定且一致
+ */
+static inline bool heap_less(MYREAL t1, HEAP_DATA i1, MYREAL t2, HEAP_DATA i2){
+    return (t1 < t2) || (t1 == t2 && i1 < i2);
+}
+
 void MinHeap_AdjustUp(HEAP_DATA * HEAP_data, MYINT child, MYINT *NroIdx, const MYREAL *TT){
     MYINT parent = (child-1)/2; 
     HEAP_DATA *pdata1, *pdata2;
     while(child > 0){
         pdata1 = HEAP_data+child;
         pdata2 = HEAP_data+parent;
-        if(TT[*pdata1] >= TT[*pdata2]) break;
+        if(! heap_less(TT[*pdata1], *pdata1, TT[*pdata2], *pdata2)) break;
 
         if(NroIdx!=NULL){
             NroIdx[*pdata1] = parent;
@@ -40,12 +49,12 @@ void MinHeap_AdjustDown(HEAP_DATA * HEAP_data, MYINT size, MYINT root, MYINT *Nr
     while(child < size){
         pdata1 = HEAP_data+child;
         pdata2 = HEAP_data+parent;
-        if(child+1 < size && TT[*(pdata1+1)] < TT[*pdata1]){
+        if(child+1 < size && heap_less(TT[*(pdata1+1)], *(pdata1+1), TT[*pdata1], *pdata1)){
             child++;
             pdata1++;
         }
 
-        if(TT[*pdata1] >= TT[*pdata2]) break;
+        if(! heap_less(TT[*pdata1], *pdata1, TT[*pdata2], *pdata2)) break;
 
         if(NroIdx!=NULL){
             NroIdx[*pdata1] = parent;
@@ -98,6 +107,117 @@ void HeapBuild(HEAP_DATA * HEAP_data, MYINT size, MYINT idx, MYINT *NroIdx, cons
 }
 
 
+
+/**
+ * 申请按缓存行对齐的堆内存，堆首位于对齐块的最后一个元素，
+ * 从而下标 1, D+1, 2D+1, ... 的元素（即每组子节点的第一个）都位于缓存行起始处
+ */
+static DHEAP_NODE * dheap_alloc(MYINT cap, void **praw){
+    size_t nbytes = (size_t)(cap + DHEAP_D) * sizeof(DHEAP_NODE) + DHEAP_CACHELINE;
+    char *raw = (char *)malloc(nbytes);
+    if(raw==NULL){
+        fprintf(stderr, "allocation failed in d-ary heap. exit.");
+        exit(EXIT_FAILURE);
+    }
+    size_t addr = (size_t)raw;
+    size_t aligned = (addr + DHEAP_CACHELINE - 1) / DHEAP_CACHELINE * DHEAP_CACHELINE;
+    *praw = raw;
+    return (DHEAP_NODE *)(aligned + DHEAP_CACHELINE - sizeof(DHEAP_NODE));
+}
+
+static void DHeap_AdjustUp(DARY_HEAP *heap, MYINT child, MYINT *NroIdx){
+    DHEAP_NODE *data = heap->data;
+    DHEAP_NODE node = data[child];
+    MYINT parent;
+    while(child > 0){
+        parent = (child-1)/DHEAP_D;
+        if(! heap_less(node.t, node.idx, data[parent].t, data[parent].idx)) break;
+        data[child] = data[parent];
+        if(NroIdx!=NULL) NroIdx[data[child].idx] = child;
+        child = parent;
+    }
+    data[child] = node;
+    if(NroIdx!=NULL) NroIdx[node.idx] = child;
+}
+
+static void DHeap_AdjustDown(DARY_HEAP *heap, MYINT root, MYINT *NroIdx){
+    DHEAP_NODE *data = heap->data;
+    MYINT size = heap->size;
+    DHEAP_NODE node = data[root];
+    MYINT parent = root;
+    MYINT child, cend, minchild;
+    while((child = parent*DHEAP_D + 1) < size){
+        // 在同一缓存行内的D个子节点中找最小者
+        cend = child + DHEAP_D;
+        if(cend > size) cend = size;
+        minchild = child;
+        for(++child; child<cend; ++child){
+            if(heap_less(data[child].t, data[child].idx, data[minchild].t, data[minchild].idx)) minchild = child;
+        }
+        if(! heap_less(data[minchild].t, data[minchild].idx, node.t, node.idx)) break;
+
+        data[parent] = data[minchild];
+        if(NroIdx!=NULL) NroIdx[data[parent].idx] = parent;
+        parent = minchild;
+    }
+    data[parent] = node;
+    if(NroIdx!=NULL) NroIdx[node.idx] = parent;
+}
+
+DARY_HEAP * DHeap_create(MYINT cap){
+    DARY_HEAP *heap = (DARY_HEAP *)malloc(sizeof(DARY_HEAP));
+    if(heap==NULL){
+        fprintf(stderr, "allocation failed in d-ary heap. exit.");
+        exit(EXIT_FAILURE);
+    }
+    if(cap < 8) cap = 8;
+    heap->data = dheap_alloc(cap, &heap->raw);
+    heap->size = 0;
+    heap->cap = cap;
+    return heap;
+}
+
+void DHeap_free(DARY_HEAP *heap){
+    free(heap->raw);
+    free(heap);
+}
+
+void DHeapPush(DARY_HEAP *heap, HEAP_DATA newdata, MYREAL t, MYINT *NroIdx){
+    if(heap->size == heap->cap){
+        MYINT newcap = heap->cap*2;
+        void *raw;
+        DHEAP_NODE *data = dheap_alloc(newcap, &raw);
+        for(MYINT i=0; i<heap->size; ++i)  data[i] = heap->data[i];
+        free(heap->raw);
+        heap->raw = raw;
+        heap->data = data;
+        heap->cap = newcap;
+    }
+    heap->data[heap->size].t = t;
+    heap->data[heap->size].idx = newdata;
+    heap->size++;
+
+    DHeap_AdjustUp(heap, heap->size-1, NroIdx);
+}
+
+HEAP_DATA DHeapPop(DARY_HEAP *heap, MYREAL *pt, MYINT *NroIdx){
+    DHEAP_NODE top = heap->data[0];
+    heap->size--;
+    if(heap->size > 0){
+        heap->data[0] = heap->data[heap->size];
+        DHeap_AdjustDown(heap, 0, NroIdx);
+    }
+    if(pt!=NULL) *pt = top.t;
+    return top.idx;
+}
+
+void DHeap_DecreaseKey(DARY_HEAP *heap, MYINT pos, MYREAL t, MYINT *NroIdx){
+    heap->data[pos].t = t;
+    DHeap_AdjustUp(heap, pos, NroIdx);
+}
+
+
+
 /**
  * 仅用于debug
  */
@@ -0,0 +1,115 @@
+/**
+ * @file   layout.c
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "const.h"
+#include "mallocfree.h"
+#include "layout.h"
+
+
+// 内联函数的外部定义
+extern inline MYINT grid_ravel(const GRID_LAYOUT *lay, MYINT ir, MYINT it, MYINT ip);
+extern inline void grid_unravel(const GRID_LAYOUT *lay, MYINT idx, MYINT *ir, MYINT *it, MYINT *ip);
+
+
+void grid_layout_init(GRID_LAYOUT *lay, MYINT nr, MYINT nt, MYINT np, bool brick, MYINT pad){
+    lay->nr = nr;
+    lay->nt = nt;
+    lay->np = np;
+    lay->pad = pad;
+
+    // 分块和偏移量均按包括幽灵层的网格计算
+    MYINT Nr = nr + 2*pad, Nt = nt + 2*pad, Np = np + 2*pad;
+    lay->br = (brick && Nr >= BRICK_LEN)? BRICK_BITS : 0;
+    lay->bt = (brick && Nt >= BRICK_LEN)? BRICK_BITS : 0;
+    lay->bp = (brick && Np >= BRICK_LEN)? BRICK_BITS : 0;
+
+    MYINT br=lay->br, bt=lay->bt, bp=lay->bp;
+    MYINT nb = br + bt + bp;
+    MYINT nbr = (Nr + ((MYINT)1<<br) - 1) >> br;
+    lay->nbt = (Nt + ((MYINT)1<<bt) - 1) >> bt;
+    lay->nbp = (Np + ((MYINT)1<<bp) - 1) >> bp;
+    lay->size = (nbr * lay->nbt * lay->nbp) << nb;
+
+    MYINT *offr = (MYINT *)malloc1d(Nr, sizeof(MYINT));
+    MYINT *offt = (MYINT *)malloc1d(Nt, sizeof(MYINT));
+    MYINT *offp = (MYINT *)malloc1d(Np, sizeof(MYINT));
+    for(MYINT ir=0; ir<Nr; ++ir){
+        offr[ir] = (((ir>>br) * lay->nbt * lay->nbp) << nb) | ((ir & (((MYINT)1<<br)-1)) << (bt+bp));
+    }
+    for(MYINT it=0; it<Nt; ++it){
+        offt[it] = (((it>>bt) * lay->nbp) << nb) | ((it & (((MYINT)1<<bt)-1)) << bp);
+    }
+    for(MYINT ip=0; ip<Np; ++ip){
+        offp[ip] = ((ip>>bp) << nb) | (ip & (((MYINT)1<<bp)-1));
+    }
+    lay->offr = offr + pad;
+    lay->offt = offt + pad;
+    lay->offp = offp + pad;
+}
+
+
+void grid_layout_free(GRID_LAYOUT *lay){
+    free(lay->offr - lay->pad);
+    free(lay->offt - lay->pad);
+    free(lay->offp - lay->pad);
+    lay->offr = lay->offt = lay->offp = NULL;
+}
+
+
+void grid_to_layout(const GRID_LAYOUT *lay, const MYREAL *src, MYREAL *dst, MYREAL fill){
+    MYINT nrtp = lay->nr*lay->nt*lay->np;
+    if(lay->size > nrtp){
+        for(MYINT i=0; i<lay->size; ++i)  dst[i] = fill;
+    }
+    MYINT i=0;
+    for(MYINT ir=0; ir<lay->nr; ++ir){
+    for(MYINT it=0; it<lay->nt; ++it){
+        MYINT off = lay->offr[ir] + lay->offt[it];
+        for(MYINT ip=0; ip<lay->np; ++ip){
+            dst[off + lay->offp[ip]] = src[i++];
+        }
+    }}
+}
+
+
+void grid_from_layout(const GRID_LAYOUT *lay, const MYREAL *src, MYREAL *dst){
+    MYINT i=0;
+    for(MYINT ir=0; ir<lay->nr; ++ir){
+    for(MYINT it=0; it<lay->nt; ++it){
+        MYINT off = lay->offr[ir] + lay->offt[it];
+        for(MYINT ip=0; ip<lay->np; ++ip){
+            dst[i++] = src[off + lay->offp[ip]];
+        }
+    }}
+}
+
+
+void grid_to_layout_stat(const GRID_LAYOUT *lay, const NODE_STAT *src, NODE_STAT *dst){
+    MYINT i=0;
+    for(MYINT ir=0; ir<lay->nr; ++ir){
+    for(MYINT it=0; it<lay->nt; ++it){
+        MYINT off = lay->offr[ir] + lay->offt[it];
+        for(MYINT ip=0; ip<lay->np; ++ip){
+            nodestat_set(dst, off + lay->offp[ip], nodestat_get(src, i++));
+        }
+    }}
+}
+
+
+void grid_from_layout_stat(const GRID_LAYOUT *lay, const NODE_STAT *src, NODE_STAT *dst){
+    MYINT i=0;
+    for(MYINT ir=0; ir<lay->nr; ++ir){
+    for(MYINT it=0; it<lay->nt; ++it){
+        MYINT off = lay->offr[ir] + lay->offt[it];
+        for(MYINT ip=0; ip<lay->np; ++ip){
+            nodestat_set(dst, i++, nodestat_get(src, off + lay->offp[ip]));
+        }
+    }}
+}
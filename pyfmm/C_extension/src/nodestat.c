@@ -0,0 +1,54 @@
+/**
+ * @file   nodestat.c
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "const.h"
+#include "mallocfree.h"
+#include "nodestat.h"
+
+
+// 内联函数的外部定义
+extern inline char nodestat_get(const NODE_STAT *st, MYINT i);
+extern inline void nodestat_set(NODE_STAT *st, MYINT i, char s);
+extern inline void nodestat_set_atomic(NODE_STAT *st, MYINT i, char s);
+extern inline char nodemask_get(const NODE_MASK *m, MYINT i);
+extern inline void nodemask_set(NODE_MASK *m, MYINT i);
+extern inline void nodemask_clear(NODE_MASK *m, MYINT i);
+extern inline char nodemask_set_atomic(NODE_MASK *m, MYINT i);
+extern inline void nodemask_clear_atomic(NODE_MASK *m, MYINT i);
+
+
+MYINT nodestat_words(MYINT n){
+    return (n + NODESTAT_PER_WORD - 1) / NODESTAT_PER_WORD;
+}
+
+
+NODE_STAT * nodestat_alloc(MYINT n){
+    MYINT nw = nodestat_words(n);
+    NODE_STAT *st = (NODE_STAT *)malloc1d(nw, sizeof(NODE_STAT));
+    memset(st, 0, nw*sizeof(NODE_STAT));
+    return st;
+}
+
+
+void nodestat_fill(NODE_STAT *st, MYINT n, char s){
+    // 将2比特的状态值复制到字节的4个位置
+    NODE_STAT c = (NODE_STAT)(s - FMM_FAR);
+    c |= c << 2;
+    c |= c << 4;
+    memset(st, c, nodestat_words(n)*sizeof(NODE_STAT));
+}
+
+
+NODE_MASK * nodemask_alloc(MYINT n){
+    MYINT nw = (n + 7) / 8;
+    NODE_MASK *m = (NODE_MASK *)malloc1d(nw, sizeof(NODE_MASK));
+    memset(m, 0, nw*sizeof(NODE_MASK));
+    return m;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file   solver.c
+ * @author Zhu Dengda (zhudengda@mail.iggcas.ac.cn)
+ * @date   2026-10
+ *
+*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "const.h"
+#include "mallocfree.h"
+#include "layout.h"
+#include "nodestat.h"
+#include "fmm.h"
+#include "fmmdd.h"
+#include "fsm.h"
+#include "solver.h"
+
+
+FMM_SOLVER * fmm_solver_create(
+    const double *rs, MYINT nr, 
+    const double *ts, MYINT nt, 
+    const double *ps, MYINT np,
+    MYINT maxodr,  const MYREAL *Slw, bool sphcoord,
+    MYINT fmmqueue, bool bricklayout)
+{
+    FMM_SOLVER *sv = (FMM_SOLVER *)malloc1d(1, sizeof(FMM_SOLVER));
+    sv->nr = nr;
+    sv->nt = nt;
+    sv->np = np;
+    sv->rs = (double *)malloc1d(nr, sizeof(double));
+    sv->ts = (double *)malloc1d(nt, sizeof(double));
+    sv->ps = (double *)malloc1d(np, sizeof(double));
+    memcpy(sv->rs, rs, nr*sizeof(double));
+    memcpy(sv->ts, ts, nt*sizeof(double));
+    memcpy(sv->ps, ps, np*sizeof(double));
+    sv->maxodr = maxodr;
+    sv->sphcoord = sphcoord;
+
+    fmm_workspace_init(&sv->ws, nr, nt, np, fmmqueue, bricklayout, true);
+    sv->Slw = (MYREAL *)malloc1d(nr*nt*np, sizeof(MYREAL));
+    // 行优先排布时内部慢度场即为Slw
+    sv->Slw_lay = (sv->ws.inplace)? sv->Slw : (MYREAL *)malloc1d(sv->ws.lay.size, sizeof(MYREAL));
+    fmm_solver_set_slowness(sv, Slw);
+
+    sv->FSM_stat = NULL;
+    return sv;
+}
+
+
+void fmm_solver_set_slowness(FMM_SOLVER *sv, const MYREAL *Slw)
+{
+    memcpy(sv->Slw, Slw, sv->nr*sv->nt*sv->np*sizeof(MYREAL));
+    if(! sv->ws.inplace)  grid_to_layout(&sv->ws.lay, Slw, sv->Slw_lay, Slw[0]);
+}
+
+
+void fmm_solver_fmm(
+    FMM_SOLVER *sv, double rr,  double tt, double pp, MYREAL *TT, 
+    MYINT rfgfac, MYINT rfgn, bool printbar, bool isparallel)
+{
+    // 网格太小或只有一个线程时仍使用串行FMM
+    if(sv->ws.bricklayout || fmmdd_ndomain(sv->nr, sv->maxodr, 0) <= 1)  isparallel = false;
+
+    FastMarching_ws(
+        &sv->ws, sv->rs, sv->nr, sv->ts, sv->nt, sv->ps, sv->np, rr, tt, pp, 
+        sv->maxodr, sv->Slw, sv->Slw_lay, 
+        TT, sv->sphcoord, rfgfac, rfgn, printbar, isparallel, -1.0, NULL, 0, NULL, false);
+}
+
+
+MYINT fmm_solver_fsm(
+    FMM_SOLVER *sv, double rr,  double tt, double pp, MYREAL *TT, 
+    MYINT rfgfac, MYINT rfgn, bool printbar, 
+    double eps, MYINT maxLoops, MYINT parallel, bool locking)
+{
+    if(sv->FSM_stat==NULL)  sv->FSM_stat = nodestat_alloc(sv->nr*sv->nt*sv->np);
+
+    return FastSweeping_stat(
+        sv->rs, sv->nr, sv->ts, sv->nt, sv->ps, sv->np, rr, tt, pp, 
+        sv->maxodr, sv->Slw, TT, sv->FSM_stat, sv->sphcoord, 
+        rfgfac, rfgn, printbar, eps, maxLoops, parallel, locking, false);
+}
+
+
+void fmm_solver_free(FMM_SOLVER *sv)
+{
+    fmm_workspace_free(&sv->ws);
+    free(sv->rs);
+    free(sv->ts);
+    free(sv->ps);
+    if(! sv->ws.inplace)  free(sv->Slw_lay);
+    free(sv->Slw);
+    if(sv->FSM_stat!=NULL) free(sv->FSM_stat);
+    free(sv);
+}
@@ -13,41 +13,158 @@ from typing import Any
 
 PDOUBLE = POINTER(c_double)
 PFLOAT = POINTER(c_float)
+PBOOL = POINTER(c_bool)
 
 USE_FLOAT:bool = False
 """libfmm库中走时和慢度数组是否使用单精度浮点数"""
 NPCT_REAL_TYPE:str = 'f8'
 
 USE_LONG:bool = True 
-"""使用长整型整数避免统计网格点数量时溢出"""
+"""使用长整型整数避免统计网格点数量时溢出，网格点数较少时会自动切换为32位整型版本"""
 INT = c_long if USE_LONG else c_int
 PINT = POINTER(INT)
 
+INT32_MAX:int = 2**31 - 1
+"""32位整型版本C库可处理的最大数组长度"""
+
+FMM_QUEUE:dict = {
+    'heap': 0,
+    'bucket': 1,
+    'dheap': 2,
+    'multi': 3,
+    'group': 4,
+}
+"""Fast Marching Method 波前优先队列类型，与C库中 FMM_QUEUE_* 宏对应"""
+
+FSM_PARALLEL:dict = {
+    'none': 0,
+    'copies': 1,
+    'plane': 2,
+    'tiles': 3,
+}
+"""Fast Sweeping Method 并行方式，与C库中 FSM_PARALLEL_* 宏对应"""
+
+FMM_RAY_STATUS:dict = {
+    'ok': 0,
+    'truncated': 1,
+    'outside': 2,
+    'unreached': 3,
+}
+"""射线追踪状态，与C库中 FMM_RAY_* 宏对应"""
+
+SOLVER_METHODS:tuple = ('fmm', 'fsm', 'fim')
+"""全局走时场的求解方法：Fast Marching, Fast Sweeping, Fast Iterative"""
+
 
 C_FastMarching:Any = None
+C_FastMarching_batch:Any = None
+C_FastMarching_bounded:Any = None
+C_FastMarching_resume:Any = None
+C_FastMarching_state_free:Any = None
+C_fmm_solver_create:Any = None
+C_fmm_solver_set_slowness:Any = None
+C_fmm_solver_fmm:Any = None
+C_fmm_solver_fsm:Any = None
+C_fmm_solver_free:Any = None
 C_FMM_raytracing:Any = None
+C_FMM_raytracing_batch:Any = None
+C_FMM_rays_free:Any = None
 C_FastSweeping:Any = None
+C_FastIterative:Any = None
+C_FastMarching_update:Any = None
+C_FastMarching_adjoint:Any = None
+C_traveltime_gradient:Any = None
 C_set_fsm_num_threads:Any = None
 
+_C_LIBS:dict = {}
+"""已加载的C库函数接口，键为 USE_LONG"""
+
 def load_c_lib(use_float:bool=False):
     r'''
-        加载单精度或双精度的C库，修改c_interfaces下的NPCT_REAL_TYPE变量和C函数接口
+        加载单精度或双精度的C库，修改c_interfaces下的NPCT_REAL_TYPE变量和C函数接口。
+        同时加载长整型和32位整型两个版本（若存在），默认启用长整型版本，
+        计算时由 :func:`select_c_lib` 根据网格大小切换
 
         :param       use_float:    是否使用单精度
     '''
-    global USE_FLOAT, NPCT_REAL_TYPE, C_FastMarching, C_FMM_raytracing, C_FastSweeping, C_set_fsm_num_threads
+    global USE_FLOAT, NPCT_REAL_TYPE, _C_LIBS
 
     USE_FLOAT = use_float
     NPCT_REAL_TYPE = 'f4' if USE_FLOAT else 'f8'
     _suffix = 'float' if USE_FLOAT else 'double'
 
+    libdir = os.path.join(os.path.abspath(os.path.dirname(__file__)), "C_extension/lib")
+    _C_LIBS = {}
+    _C_LIBS[True] = _bind_c_lib(os.path.join(libdir, f"libfmm_{_suffix}.so"), c_long)
+    libpath_i32 = os.path.join(libdir, f"libfmm_{_suffix}_i32.so")
+    if os.path.exists(libpath_i32):
+        _C_LIBS[False] = _bind_c_lib(libpath_i32, c_int)
+
+    _activate_c_lib(True)
+
+
+def select_c_lib(npts:int, fmmqueue:str='heap'):
+    r'''
+        根据网格点数选择C库的整型版本。32位整型版本的堆、索引数组占用内存减半，
+        当数组长度可能超出32位整型范围时使用长整型版本
+
+        :param       npts:        数组长度（分块排布时包括填充部分）
+        :param       fmmqueue:    波前优先队列类型，惰性删除的队列中一个节点可能重复入队，
+                                  最多为邻点个数加1次
+    '''
+    nmax = npts if fmmqueue == 'heap' else 7*npts
+    _activate_c_lib(not (False in _C_LIBS and nmax <= INT32_MAX))
+
+
+def _activate_c_lib(use_long:bool):
+    r'''
+        将某个整型版本C库的函数接口设为c_interfaces下的全局变量
+
+        :param       use_long:    是否使用长整型版本
+    '''
+    global USE_LONG, INT, PINT, C_FastMarching, C_FastMarching_batch, C_FMM_raytracing, C_FMM_raytracing_batch, C_FMM_rays_free, C_FastSweeping, C_FastIterative, C_set_fsm_num_threads
+    global C_FastMarching_bounded, C_FastMarching_resume, C_FastMarching_state_free, C_FastMarching_update, C_FastMarching_adjoint, C_traveltime_gradient
+    global C_fmm_solver_create, C_fmm_solver_set_slowness, C_fmm_solver_fmm, C_fmm_solver_fsm, C_fmm_solver_free
+
+    lib = _C_LIBS[use_long]
+    USE_LONG = use_long
+    INT = lib['INT']
+    PINT = POINTER(INT)
+    C_FastMarching = lib['FastMarching']
+    C_FastMarching_batch = lib['FastMarching_batch']
+    C_FastMarching_bounded = lib['FastMarching_bounded']
+    C_FastMarching_resume = lib['FastMarching_resume']
+    C_FastMarching_state_free = lib['FastMarching_state_free']
+    C_FastMarching_update = lib['FastMarching_update']
+    C_FastMarching_adjoint = lib['FastMarching_adjoint']
+    C_traveltime_gradient = lib['traveltime_gradient']
+    C_fmm_solver_create = lib['fmm_solver_create']
+    C_fmm_solver_set_slowness = lib['fmm_solver_set_slowness']
+    C_fmm_solver_fmm = lib['fmm_solver_fmm']
+    C_fmm_solver_fsm = lib['fmm_solver_fsm']
+    C_fmm_solver_free = lib['fmm_solver_free']
+    C_FMM_raytracing = lib['FMM_raytracing']
+    C_FMM_raytracing_batch = lib['FMM_raytracing_batch']
+    C_FMM_rays_free = lib['FMM_rays_free']
+    C_FastSweeping = lib['FastSweeping']
+    C_FastIterative = lib['FastIterative']
+    C_set_fsm_num_threads = lib['set_fsm_num_threads']
+
+
+def _bind_c_lib(libpath:str, INT):
+    r'''
+        加载C库并设置函数接口的参数类型
+
+        :param       libpath:    C库路径
+        :param       INT:        C库中 MYINT 对应的ctypes整型
+
+        :return:     函数接口字典
+    '''
+    PINT = POINTER(INT)
     REAL = c_float if USE_FLOAT else c_double
     PREAL = POINTER(REAL)
 
-    libfmm = cdll.LoadLibrary(
-        os.path.join(
-            os.path.abspath(os.path.dirname(__file__)), 
-            f"C_extension/lib/libfmm_{_suffix}.so"))
+    libfmm = cdll.LoadLibrary(libpath)
     """libfmm库"""
 
 
@@ -66,10 +183,89 @@ def load_c_lib(use_float:bool=False):
         c_double, c_double, c_double, 
         INT, PREAL,
         PREAL, c_bool,
-        INT, INT, c_bool
+        INT, INT, c_bool, INT, c_bool, c_bool,
+        PDOUBLE, INT, PREAL
     ]
 
 
+    C_FastMarching_batch = libfmm.FastMarching_batch
+    """C库中多个源点批量计算走时场的函数 FastMarching_batch, 详见C API同名函数"""
+
+    C_FastMarching_batch.restype = None 
+    C_FastMarching_batch.argtypes = [
+        PDOUBLE, INT, 
+        PDOUBLE, INT,
+        PDOUBLE, INT,
+        PDOUBLE, INT, 
+        INT, PREAL,
+        PREAL, c_bool,
+        INT, INT, c_bool, INT, c_bool,
+        INT
+    ]
+
+
+    C_FastMarching_bounded = libfmm.FastMarching_bounded
+    """C库中计算到指定最大走时并返回计算状态的函数 FastMarching_bounded, 详见C API同名函数"""
+
+    C_FastMarching_bounded.restype = c_void_p
+    C_FastMarching_bounded.argtypes = [
+        PDOUBLE, INT, 
+        PDOUBLE, INT,
+        PDOUBLE, INT,
+        c_double, c_double, c_double, 
+        INT, PREAL,
+        PREAL, c_bool,
+        INT, INT, c_bool, INT, c_bool,
+        c_double, PINT
+    ]
+
+    C_FastMarching_resume = libfmm.FastMarching_resume
+    """C库中从计算状态继续计算的函数 FastMarching_resume, 详见C API同名函数"""
+
+    C_FastMarching_resume.restype = INT
+    C_FastMarching_resume.argtypes = [c_void_p, c_double, PREAL, c_bool]
+
+    C_FastMarching_state_free = libfmm.FastMarching_state_free
+    C_FastMarching_state_free.restype = None
+    C_FastMarching_state_free.argtypes = [c_void_p]
+
+
+    C_fmm_solver_create = libfmm.fmm_solver_create
+    """C库中创建可重复使用的求解器 fmm_solver_create, 详见C API同名函数"""
+
+    C_fmm_solver_create.restype = c_void_p
+    C_fmm_solver_create.argtypes = [
+        PDOUBLE, INT, 
+        PDOUBLE, INT,
+        PDOUBLE, INT,
+        INT, PREAL, c_bool,
+        INT, c_bool
+    ]
+
+    C_fmm_solver_set_slowness = libfmm.fmm_solver_set_slowness
+    C_fmm_solver_set_slowness.restype = None
+    C_fmm_solver_set_slowness.argtypes = [c_void_p, PREAL]
+
+    C_fmm_solver_fmm = libfmm.fmm_solver_fmm
+    C_fmm_solver_fmm.restype = None
+    C_fmm_solver_fmm.argtypes = [
+        c_void_p, c_double, c_double, c_double, PREAL,
+        INT, INT, c_bool, c_bool
+    ]
+
+    C_fmm_solver_fsm = libfmm.fmm_solver_fsm
+    C_fmm_solver_fsm.restype = INT
+    C_fmm_solver_fsm.argtypes = [
+        c_void_p, c_double, c_double, c_double, PREAL,
+        INT, INT, c_bool, 
+        c_double, INT, INT, c_bool
+    ]
+
+    C_fmm_solver_free = libfmm.fmm_solver_free
+    C_fmm_solver_free.restype = None
+    C_fmm_solver_free.argtypes = [c_void_p]
+
+
     C_FMM_raytracing.restype = REAL 
     C_FMM_raytracing.argtypes = [
         PDOUBLE, INT,
@@ -81,6 +277,22 @@ def load_c_lib(use_float:bool=False):
         PDOUBLE, PINT
     ]
 
+    C_FMM_raytracing_batch = libfmm.FMM_raytracing_batch
+    C_FMM_raytracing_batch.restype = INT 
+    C_FMM_raytracing_batch.argtypes = [
+        PDOUBLE, INT,
+        PDOUBLE, INT,
+        PDOUBLE, INT,
+        c_double, c_double, c_double, 
+        PDOUBLE, INT, c_double, c_double, 
+        PREAL, PREAL, c_bool, INT, INT, 
+        PREAL, PINT, PINT, POINTER(PDOUBLE)
+    ]
+
+    C_FMM_rays_free = libfmm.FMM_rays_free
+    C_FMM_rays_free.restype = None
+    C_FMM_rays_free.argtypes = [PDOUBLE]
+
     C_FastSweeping = libfmm.FastSweeping
     C_FastSweeping.restype = INT 
     C_FastSweeping.argtypes = [
@@ -91,13 +303,119 @@ def load_c_lib(use_float:bool=False):
         INT, PREAL,
         PREAL, c_bool,
         INT, INT, c_bool, 
-        c_double, INT, c_bool
+        c_double, INT, INT, c_bool
+    ]
+
+    C_FastIterative = libfmm.FastIterative
+    C_FastIterative.restype = INT 
+    C_FastIterative.argtypes = [
+        PDOUBLE, INT,
+        PDOUBLE, INT,
+        PDOUBLE, INT,
+        c_double, c_double, c_double, 
+        INT, PREAL,
+        PREAL, c_bool,
+        INT, INT, c_bool, 
+        c_double
+    ]
+
+    C_FastMarching_update = libfmm.FastMarching_update
+    C_FastMarching_update.restype = INT 
+    C_FastMarching_update.argtypes = [
+        PDOUBLE, INT,
+        PDOUBLE, INT,
+        PDOUBLE, INT,
+        INT, PREAL, PREAL, 
+        c_bool, PBOOL, c_bool
+    ]
+
+    C_FastMarching_adjoint = libfmm.FastMarching_adjoint
+    C_FastMarching_adjoint.restype = None 
+    C_FastMarching_adjoint.argtypes = [
+        PDOUBLE, INT,
+        PDOUBLE, INT,
+        PDOUBLE, INT,
+        c_double, c_double, c_double, 
+        INT, PREAL, PREAL, 
+        c_bool, PDOUBLE, INT, 
+        PREAL, PREAL, PREAL, c_bool
+    ]
+
+    C_traveltime_gradient = libfmm.traveltime_gradient
+    C_traveltime_gradient.restype = None 
+    C_traveltime_gradient.argtypes = [
+        PDOUBLE, INT,
+        PDOUBLE, INT,
+        PDOUBLE, INT,
+        INT, PREAL, c_bool, 
+        PREAL, PREAL, PREAL
     ]
 
     C_set_fsm_num_threads = libfmm.set_fsm_num_threads
     C_set_fsm_num_threads.restype = None
     C_set_fsm_num_threads.argtypes = [INT]
 
+    return dict(
+        INT=INT, 
+        FastMarching=C_FastMarching, 
+        FastMarching_batch=C_FastMarching_batch, 
+        FastMarching_bounded=C_FastMarching_bounded, 
+        FastMarching_resume=C_FastMarching_resume, 
+        FastMarching_state_free=C_FastMarching_state_free, 
+        FastMarching_update=C_FastMarching_update, 
+        FastMarching_adjoint=C_FastMarching_adjoint, 
+        traveltime_gradient=C_traveltime_gradient, 
+        fmm_solver_create=C_fmm_solver_create, 
+        fmm_solver_set_slowness=C_fmm_solver_set_slowness, 
+        fmm_solver_fmm=C_fmm_solver_fmm, 
+        fmm_solver_fsm=C_fmm_solver_fsm, 
+        fmm_solver_free=C_fmm_solver_free, 
+        FMM_raytracing=C_FMM_raytracing, 
+        FMM_raytracing_batch=C_FMM_raytracing_batch, 
+        FMM_rays_free=C_FMM_rays_free, 
+        FastSweeping=C_FastSweeping, 
+        FastIterative=C_FastIterative, 
+        set_fsm_num_threads=C_set_fsm_num_threads)
+
+
+def get_fmm_queue(name:str):
+    r'''
+        将波前优先队列名称转为C库中对应的整数
+
+        :param       name:    队列名称，'heap', 'bucket', 'dheap', 'multi' 或 'group'
+    '''
+    if name not in FMM_QUEUE:
+        raise ValueError(f"FMMqueue should be one of {list(FMM_QUEUE.keys())}, but '{name}'.")
+    return FMM_QUEUE[name]
+
+
+def get_fsm_parallel(mode):
+    r'''
+        将Fast Sweeping Method并行方式转为C库中对应的整数
+
+        :param       mode:    并行方式，'none', 'copies', 'plane' 或 'tiles'，
+                              也可以是布尔值，False即'none'，True即'copies'
+    '''
+    if not isinstance(mode, str):
+        mode = 'copies' if mode else 'none'
+    if mode not in FSM_PARALLEL:
+        raise ValueError(f"FSMparallel should be a bool or one of {list(FSM_PARALLEL.keys())}, but '{mode}'.")
+    return FSM_PARALLEL[mode]
+
+
+def get_solver_method(method, useFSM:bool=False):
+    r'''
+        确定全局走时场的求解方法
+
+        :param       method:    求解方法，'fmm', 'fsm' 或 'fim'，None时由useFSM决定
+        :param       useFSM:    method为None时，是否使用Fast Sweeping Method
+    '''
+    if method is None:
+        method = 'fsm' if useFSM else 'fmm'
+    if method not in SOLVER_METHODS:
+        raise ValueError(f"method should be None or one of {list(SOLVER_METHODS)}, but '{method}'.")
+    return method
+
 
 def set_fsm_num_threads(n):
     r'''
@@ -105,4 +423,5 @@ def set_fsm_num_threads(n):
 
         :param       n:    线程数
     '''
-    C_set_fsm_num_threads(n)
\ No newline at end of file
+    for lib in _C_LIBS.values():
+        lib['set_fsm_num_threads'](n)
\ No newline at end of file
@@ -25,11 +25,31 @@ def get_FSM_nsweep():
     global FSM_nsweep 
     return FSM_nsweep
 
+FIM_niter = 0
+
+def get_FIM_niter():
+    r'''
+        返回使用FIM计算走时场时，活动列表的迭代次数
+    '''
+    global FIM_niter
+    return FIM_niter
+
+FMM_nupdate = 0
+
+def get_FMM_nupdate():
+    r'''
+        返回使用 :func:`travel_time_update` 更新走时场时，重新计算的下游节点数
+    '''
+    global FMM_nupdate
+    return FMM_nupdate
+
 def travel_time_source(
     srcloc:list, 
     xarr:np.ndarray, yarr:np.ndarray, zarr:np.ndarray, slw:np.ndarray,
     maxodr:int=2, sphcoord:bool=False, rfgfac:int=0, rfgn:int=0, printbar:bool=False,
-    useFSM:bool=False, FSMeps:float=0.0, FSMmaxLoops:int=1, FSMparallel:bool=False):
+    useFSM:bool=False, FSMeps:float=0.0, FSMmaxLoops:int=1, FSMparallel:Union[bool,str]=False,
+    FSMlocking:bool=False, FMMqueue:str='heap', FMMbrick:bool=False, FMMparallel:bool=False,
+    method:Union[str,None]=None, FIMeps:float=0.0, gradient:bool=False):
     r'''
         给定源点坐标，计算全局走时场
 
@@ -50,17 +70,51 @@ def travel_time_source(
         :param     useFSM:    是否改用Fast Sweeping Method计算全局走时场
         :param     FSMeps:    Fast Sweeping Method收敛条件，衡量Sweep后的最大更新量
         :param  FSMmaxLoops:  Fast Sweeping Method整体迭代次数（对于3D模型，向8个方向各Sweep一次为迭代一次）  
-        :param  FSMparallel:  是否使用并行Fast Sweeping Method
-
-        :return:   三维走时场
+        :param  FSMparallel:  并行Fast Sweeping Method的方式。False或'none'为串行；True或'copies'为8个扫描方向
+                              各用一份走时数组同时扫描再合并，至少迭代2次，最多使用8个线程，需要8份额外的走时数组；
+                              'plane'为在每个扫描方向内，同一超平面 :math:`i+j+k=const` 上的节点同时更新，
+                              第一遍扫描按逐行扫描的先后将波前节点置为alive，结果与串行FSM完全相同，
+                              不需要额外内存，线程数不受限制；'tiles'与'plane'结果相同，
+                              但以缓存大小的块为单位分层并行扫描，并跳过已收敛的块，内存访问更连续。
+                              线程数由 :func:`set_fsm_num_threads` 设置
+        :param  FSMlocking:   是否使用锁定扫描 (Bak et al., 2010)。节点走时更新或邻点变为alive时，
+                              解锁该节点及差分模板范围内的节点，每次扫描只计算未锁定的节点，跳过已收敛的区域，
+                              多次迭代时可大幅减少计算量。节点的更新只依赖自身及差分模板范围内节点的走时和状态，
+                              这些都未变化时再算也不会变化，因此结果与不锁定时相同；FSMparallel为'copies'时不使用
+        :param   FMMqueue:    Fast Marching Method波前优先队列类型。'heap'为二叉堆，严格按走时顺序计算；
+                              'bucket'为untidy桶队列，入队出队为O(1)，节点计算顺序的乱序不超过桶宽(最小单个网格走时)，
+                              引入的误差与一阶差分误差同量级；'dheap'为按缓存行对齐的d叉堆，走时与节点索引连续存放，
+                              结果与'heap'一致，且不再需要为每个节点记录堆中位置；'multi'为多个线程共用的多个d叉堆(multiqueue)，
+                              源点附近初始化后并行计算，节点近似按走时顺序确定，乱序确定的节点走时减小后重新入堆修正，
+                              线程数由 :func:`set_fsm_num_threads` 设置，不需要划分子区域，结果与'heap'的最大相对差别约1e-2，强非均匀介质中可达3e-2；'group'为Group Marching Method (Kim, 2001)，
+                              不使用堆，每步将走时不超过波前最小走时加 :math:`h s/\sqrt{3}` 的波前节点作为一组同时确定，
+                              组内节点及其邻点并行更新两遍，结果与线程数无关，与'heap'的差别不超过差分误差的量级
+        :param   FMMbrick:    Fast Marching Method内部是否使用4x4x4分块排布的数组，使差分模板的邻点集中在少数缓存行内，
+                              适用于大模型，需要额外一份带幽灵层的慢度、走时和状态数组的内存(单精度时每节点约8字节)。
+                              不分块且FMMqueue不为'group'时直接在慢度场和走时场上计算，不需要这些额外数组
+        :param FMMparallel:   是否使用区域分解的并行Fast Marching Method。网格沿x(r)方向分为多个子区域，
+                              各线程同步推进并交换边界走时，直到走时不再变化。线程数由 :func:`set_fsm_num_threads` 设置，
+                              此时固定使用二叉堆，忽略FMMqueue和FMMbrick；结果与串行FMM略有差别，不超过差分误差的量级
+        :param     method:    求解全局走时场的方法。'fmm'为Fast Marching Method；'fsm'为Fast Sweeping Method；
+                              'fim'为Fast Iterative Method (Jeong and Whitaker, 2008)，维护一个活动节点列表并行地同时更新，
+                              收敛的节点移出列表并激活其邻点，结果与线程数无关，线程数由 :func:`set_fsm_num_threads` 设置。
+                              None时由useFSM决定
+        :param     FIMeps:    Fast Iterative Method收敛条件，节点走时的减小量不超过该值时移出活动列表
+        :param   gradient:    是否同时返回由迎风差分模板得到的走时梯度场，详见 :func:`get_traveltime_gradient`
+
+        :return:   三维走时场；gradient为True时返回(走时场, 形状为(nx, ny, nz, 3)的梯度场)
     '''
-    global FSM_nsweep 
+    global FSM_nsweep, FIM_niter
 
     check_xyz_arr(xarr, yarr, zarr, sphcoord)
     check_slowness(xarr, yarr, zarr, slw)
 
-    # 对于并行情况，至少迭代两次
-    if FSMparallel:
+    method = c_interfaces.get_solver_method(method, useFSM)
+    useFSM = (method == 'fsm')
+
+    # 对于多份数组的并行情况，至少迭代两次
+    FSMparallel = c_interfaces.get_fsm_parallel(FSMparallel)
+    if FSMparallel == c_interfaces.FSM_PARALLEL['copies']:
         if FSMmaxLoops <= 1:
             myLogger.warning("For parallel FSM, maxLoops must set at least 2 (already changed).")
             FSMmaxLoops = 2
@@ -94,7 +148,11 @@ def travel_time_source(
     TT_ravel = TT.ravel()
     c_TT = npct.as_ctypes(TT_ravel)
 
-    FastFunc = c_interfaces.C_FastMarching if not useFSM else c_interfaces.C_FastSweeping
+    c_interfaces.select_c_lib(_layout_npts(slw.shape, FMMbrick and method == 'fmm'), FMMqueue)
+    FastFunc = dict(
+        fmm=c_interfaces.C_FastMarching, 
+        fsm=c_interfaces.C_FastSweeping, 
+        fim=c_interfaces.C_FastIterative)[method]
     parse_args = [
         c_xarr, len(xarr),
         c_yarr, len(yarr),
@@ -104,10 +162,20 @@ def travel_time_source(
         c_TT, sphcoord,
         rfgfac, rfgn, printbar
     ]
-    if useFSM:
-        parse_args.extend([FSMeps, FSMmaxLoops, FSMparallel])
+    if method == 'fsm':
+        parse_args.extend([FSMeps, FSMmaxLoops, FSMparallel, FSMlocking])
+    elif method == 'fim':
+        parse_args.append(FIMeps)
+    else:
+        parse_args.extend([c_interfaces.get_fmm_queue(FMMqueue), FMMbrick, FMMparallel, None, 0, None])
+
+    if method == 'fim':
+        FIM_niter = FastFunc(*parse_args)
+    else:
+        FSM_nsweep = FastFunc(*parse_args)
 
-    FSM_nsweep = FastFunc(*parse_args)
+    if gradient:
+        return TT, get_traveltime_gradient(TT, xarr, yarr, zarr, maxodr, sphcoord)
 
     return TT
 
@@ -116,7 +184,9 @@ def travel_time_iniTT(
     iniTT:np.ndarray,
     xarr:np.ndarray, yarr:np.ndarray, zarr:np.ndarray, slw:np.ndarray,
     maxodr:int=2, sphcoord:bool=False, printbar:bool=False,
-    useFSM:bool=False, FSMeps:float=0.0, FSMmaxLoops:int=1, FSMparallel:bool=False):
+    useFSM:bool=False, FSMeps:float=0.0, FSMmaxLoops:int=1, FSMparallel:Union[bool,str]=False,
+    FSMlocking:bool=False, FMMqueue:str='heap', FMMbrick:bool=False, FMMparallel:bool=False,
+    method:Union[str,None]=None, FIMeps:float=0.0):
     r'''
         给定走时场初始状态，计算全局走时场
 
@@ -133,17 +203,27 @@ def travel_time_iniTT(
         :param     useFSM:    是否改用Fast Sweeping Method计算全局走时场
         :param     FSMeps:    Fast Sweeping Method收敛条件，衡量Sweep后的最大更新量
         :param  FSMmaxLoops:  Fast Sweeping Method整体迭代次数（对于3D模型，向8个方向各Sweep一次为迭代一次）  
-        :param  FSMparallel:  是否使用并行Fast Sweeping Method
+        :param  FSMparallel:  并行Fast Sweeping Method的方式，详见 :func:`travel_time_source`
+        :param  FSMlocking:   是否使用锁定扫描，详见 :func:`travel_time_source`
+        :param   FMMqueue:    Fast Marching Method波前优先队列类型，'heap', 'bucket', 'dheap', 'multi' 或 'group'，详见 :func:`travel_time_source`
+        :param   FMMbrick:    Fast Marching Method内部是否使用分块排布的数组，详见 :func:`travel_time_source`
+        :param FMMparallel:   是否使用区域分解的并行Fast Marching Method，详见 :func:`travel_time_source`
+        :param     method:    求解全局走时场的方法，'fmm', 'fsm' 或 'fim'，None时由useFSM决定，详见 :func:`travel_time_source`
+        :param     FIMeps:    Fast Iterative Method收敛条件，详见 :func:`travel_time_source`
 
         :return:   三维走时场
     '''
-    global FSM_nsweep
+    global FSM_nsweep, FIM_niter
 
     check_xyz_arr(xarr, yarr, zarr, sphcoord)
     check_slowness(xarr, yarr, zarr, slw)
 
-    # 对于并行情况，至少迭代两次
-    if FSMparallel:
+    method = c_interfaces.get_solver_method(method, useFSM)
+    useFSM = (method == 'fsm')
+
+    # 对于多份数组的并行情况，至少迭代两次
+    FSMparallel = c_interfaces.get_fsm_parallel(FSMparallel)
+    if FSMparallel == c_interfaces.FSM_PARALLEL['copies']:
         if FSMmaxLoops <= 1:
             myLogger.warning("For parallel FSM, maxLoops must set at least 2 (already changed).")
             FSMmaxLoops = 2
@@ -159,7 +239,11 @@ def travel_time_iniTT(
     TT_ravel = iniTT.ravel().astype(c_interfaces.NPCT_REAL_TYPE)
     c_TT = npct.as_ctypes(TT_ravel)
 
-    FastFunc = c_interfaces.C_FastMarching if not useFSM else c_interfaces.C_FastSweeping
+    c_interfaces.select_c_lib(_layout_npts(slw.shape, FMMbrick and method == 'fmm'), FMMqueue)
+    FastFunc = dict(
+        fmm=c_interfaces.C_FastMarching, 
+        fsm=c_interfaces.C_FastSweeping, 
+        fim=c_interfaces.C_FastIterative)[method]
     parse_args = [
         c_xarr, len(xarr),
         c_yarr, len(yarr),
@@ -169,16 +253,610 @@ def travel_time_iniTT(
         c_TT, sphcoord,
         0, 0, printbar
     ]
-    if useFSM:
-        parse_args.extend([FSMeps, FSMmaxLoops, FSMparallel])
-
-    FSM_nsweep = FastFunc(*parse_args)
+    if method == 'fsm':
+        parse_args.extend([FSMeps, FSMmaxLoops, FSMparallel, FSMlocking])
+    elif method == 'fim':
+        parse_args.append(FIMeps)
+    else:
+        parse_args.extend([c_interfaces.get_fmm_queue(FMMqueue), FMMbrick, FMMparallel, None, 0, None])
+
+    if method == 'fim':
+        FIM_niter = FastFunc(*parse_args)
+    else:
+        FSM_nsweep = FastFunc(*parse_args)
     
 
     return TT_ravel.reshape(iniTT.shape)
 
 
 
+def travel_time_update(
+    TT:np.ndarray, changed:np.ndarray,
+    xarr:np.ndarray, yarr:np.ndarray, zarr:np.ndarray, slw:np.ndarray,
+    maxodr:int=2, sphcoord:bool=False, printbar:bool=False):
+    r'''
+        慢度场局部改变后，使用Fast Marching Method增量更新已有的全局走时场。
+        已有走时场中的走时大小即为原先节点的确定顺序，只重新计算慢度改变的节点的下游区域，
+        即从这些节点出发沿走时不减的方向可以到达的节点，计算量与该区域大小相当。
+        慢度减小时，走时的减小可能传播到原先的上游，需要重新计算的区域也相应扩大。
+        适用于反演中每次只改变一小块慢度、所有源点都需要重新计算走时的情况
+
+        .. note::  改变的区域不能包括源点及源点附近初始化(如加密网格)的区域，否则应重新计算全局走时场。
+                   结果与使用堆( ``FMMqueue='heap'`` )重新计算的全局走时场一致，但需使用相同的maxodr。
+
+        :param         TT:    改变前慢度场对应的FMM三维走时场，不会被修改
+        :param    changed:    形状为(nx, ny, nz)的布尔数组，标记慢度改变的节点
+        :param       xarr:    :math:`x` 或 :math:`r` 节点坐标数组，要求等距升序排列 
+        :param       yarr:    :math:`y` 或 :math:`\theta` 节点坐标数组，要求等距升序排列 
+        :param       zarr:    :math:`z` 或 :math:`\phi` 节点坐标数组，要求等距升序排列 
+        :param        slw:    形状为(nx, ny, nz)的三维慢度场，改变后的值
+        :param     maxodr:    使用的最大差分阶数, 1 or 2 or 3，应与计算TT时相同
+        :param   sphcoord:    是否为球坐标系
+        :param   printbar:    是否打印进度条
+
+        :return:   更新后的三维走时场，重新计算的节点数由 :func:`get_FMM_nupdate` 返回
+    '''
+    global FMM_nupdate
+
+    check_xyz_arr(xarr, yarr, zarr, sphcoord)
+    check_slowness(xarr, yarr, zarr, slw)
+    if TT.shape != slw.shape or changed.shape != slw.shape:
+        raise ValueError(f"Shape of TT and changed should be {slw.shape}, but {TT.shape} and {changed.shape}.")
+
+    c_xarr = npct.as_ctypes(xarr.astype('f8'))
+    c_yarr = npct.as_ctypes(yarr.astype('f8'))
+    c_zarr = npct.as_ctypes(zarr.astype('f8'))
+    slw_ravel = slw.ravel().astype(c_interfaces.NPCT_REAL_TYPE)
+    c_slw = npct.as_ctypes(slw_ravel)
+    changed_ravel = np.ascontiguousarray(changed, dtype=np.bool_).ravel()
+
+    TT_ravel = TT.ravel().astype(c_interfaces.NPCT_REAL_TYPE)
+    c_TT = npct.as_ctypes(TT_ravel)
+
+    c_interfaces.select_c_lib(_layout_npts(slw.shape))
+    nupdate = c_interfaces.C_FastMarching_update(
+        c_xarr, len(xarr),
+        c_yarr, len(yarr),
+        c_zarr, len(zarr),
+        int(maxodr), c_slw, c_TT, 
+        sphcoord, npct.as_ctypes(changed_ravel), printbar
+    )
+    if nupdate < 0:
+        raise ValueError("The changed region contains the source, please recompute the global traveltime field.")
+    FMM_nupdate = nupdate
+
+    return TT_ravel.reshape(TT.shape)
+
+
+
+def travel_time_receivers(
+    srcloc:list, rcvlocs:np.ndarray,
+    xarr:np.ndarray, yarr:np.ndarray, zarr:np.ndarray, slw:np.ndarray,
+    maxodr:int=2, sphcoord:bool=False, rfgfac:int=0, rfgn:int=0, printbar:bool=False,
+    FMMqueue:str='heap', FMMbrick:bool=False, FMMparallel:bool=False):
+    r'''
+        给定源点和多个接收点坐标，使用Fast Marching Method计算接收点走时。
+        当各接收点三次线性插值所需的8个节点均已确定时提前结束，不再计算更远处的走时场，
+        接收点距源点较近时可节省大部分计算量。结果与从全局走时场中插值得到的走时一致
+
+        :param     srcloc:    源点坐标，直角坐标系 :math:`(x,y,z)` 或球坐标系 :math:`(r,\theta,\phi)` 
+        :param    rcvlocs:    形状为(nrcv, 3)的接收点坐标数组
+        :param       xarr:    :math:`x` 或 :math:`r` 节点坐标数组，要求等距升序排列 
+        :param       yarr:    :math:`y` 或 :math:`\theta` 节点坐标数组，要求等距升序排列 
+        :param       zarr:    :math:`z` 或 :math:`\phi` 节点坐标数组，要求等距升序排列 
+        :param        slw:    形状为(nx, ny, nz)的三维慢度场
+        :param     maxodr:    使用的最大差分阶数, 1 or 2 or 3
+        :param   sphcoord:    是否为球坐标系
+        :param     rfgfac:    对于源点附近的格点间加密倍数，>1
+        :param       rfgn:    对于源点附近的格点间加密处理的辐射半径，>=1
+        :param   printbar:    是否打印进度条
+        :param   FMMqueue:    Fast Marching Method波前优先队列类型，'heap', 'bucket', 'dheap', 'multi' 或 'group'，详见 :func:`travel_time_source` 。
+                              'multi'和'group'时已确定的节点可能被修正，不提前结束
+        :param   FMMbrick:    Fast Marching Method内部是否使用分块排布的数组，详见 :func:`travel_time_source`
+        :param FMMparallel:   是否使用区域分解的并行Fast Marching Method，详见 :func:`travel_time_source` ，此时不提前结束
+
+        :return:   形状为(nrcv,)的接收点走时
+    '''
+    check_xyz_arr(xarr, yarr, zarr, sphcoord)
+    check_slowness(xarr, yarr, zarr, slw)
+
+    xx, yy, zz = np.array(srcloc).astype('f8')
+    if xx < xarr[0] or xx > xarr[-1]:
+        raise ValueError("xx out of bound.")
+    if yy < yarr[0] or yy > yarr[-1]:
+        raise ValueError("yy out of bound.")
+    if zz < zarr[0] or zz > zarr[-1]:
+        raise ValueError("zz out of bound.")
+
+    rcvs = np.ascontiguousarray(rcvlocs, dtype='f8').reshape(-1, 3)
+    for k, arr, name in zip(range(3), (xarr, yarr, zarr), ('x', 'y', 'z')):
+        if np.any(rcvs[:,k] < arr[0]) or np.any(rcvs[:,k] > arr[-1]):
+            raise ValueError(f"Receiver {name} out of bound.")
+    if rcvs.shape[0] == 0:
+        return np.zeros((0,), dtype=c_interfaces.NPCT_REAL_TYPE)
+
+    c_xarr = npct.as_ctypes(xarr.astype('f8'))
+    c_yarr = npct.as_ctypes(yarr.astype('f8'))
+    c_zarr = npct.as_ctypes(zarr.astype('f8'))
+    slw_ravel = slw.ravel().astype(c_interfaces.NPCT_REAL_TYPE)
+    c_slw = npct.as_ctypes(slw_ravel)
+
+    TT_ravel = np.zeros((slw.size,), dtype=c_interfaces.NPCT_REAL_TYPE)
+    c_TT = npct.as_ctypes(TT_ravel)
+    rcvTT = np.zeros((rcvs.shape[0],), dtype=c_interfaces.NPCT_REAL_TYPE)
+
+    c_interfaces.select_c_lib(_layout_npts(slw.shape, FMMbrick), FMMqueue)
+    c_interfaces.C_FastMarching(
+        c_xarr, len(xarr),
+        c_yarr, len(yarr),
+        c_zarr, len(zarr),
+        xx, yy, zz,
+        int(maxodr), c_slw, 
+        c_TT, sphcoord,
+        int(rfgfac), int(rfgn), printbar,
+        c_interfaces.get_fmm_queue(FMMqueue), FMMbrick, FMMparallel,
+        npct.as_ctypes(rcvs.ravel()), rcvs.shape[0], npct.as_ctypes(rcvTT)
+    )
+
+    return rcvTT
+
+
+def travel_time_gradient(
+    srcloc:list, rcvlocs:np.ndarray,
+    xarr:np.ndarray, yarr:np.ndarray, zarr:np.ndarray, slw:np.ndarray,
+    rcvTTobs:Union[np.ndarray,None]=None,
+    maxodr:int=2, sphcoord:bool=False, printbar:bool=False):
+    r'''
+        给定源点和多个接收点坐标，使用Fast Marching Method计算接收点走时，
+        并使用伴随状态法计算目标函数对慢度场的梯度。正演时记录节点的确定顺序，
+        伴随方程按相反顺序扫描一遍即可求得，计算量与一次FMM相当，与接收点个数无关。
+        未给定观测走时时目标函数为各接收点走时之和，单个接收点时梯度即为走时对各节点慢度的敏感核；
+        给定观测走时时目标函数为 :math:`\frac{1}{2}\sum_i (T_i - T^{obs}_i)^2` 
+
+        .. note::  正演使用二叉堆( ``FMMqueue='heap'`` )，不支持源点附近的加密网格。
+                   接收点插值所需的节点均确定后即结束，之后才确定的节点梯度为0
+
+        :param     srcloc:    源点坐标，直角坐标系 :math:`(x,y,z)` 或球坐标系 :math:`(r,\theta,\phi)` 
+        :param    rcvlocs:    形状为(nrcv, 3)的接收点坐标数组
+        :param       xarr:    :math:`x` 或 :math:`r` 节点坐标数组，要求等距升序排列 
+        :param       yarr:    :math:`y` 或 :math:`\theta` 节点坐标数组，要求等距升序排列 
+        :param       zarr:    :math:`z` 或 :math:`\phi` 节点坐标数组，要求等距升序排列 
+        :param        slw:    形状为(nx, ny, nz)的三维慢度场
+        :param   rcvTTobs:    形状为(nrcv,)的接收点观测走时，为None时目标函数为走时之和
+        :param     maxodr:    使用的最大差分阶数, 1 or 2 or 3
+        :param   sphcoord:    是否为球坐标系
+        :param   printbar:    是否打印进度条
+
+        :return:   
+            - **rcvTT** -  形状为(nrcv,)的接收点走时
+            - **grad** -   形状为(nx, ny, nz)的梯度场
+    '''
+    check_xyz_arr(xarr, yarr, zarr, sphcoord)
+    check_slowness(xarr, yarr, zarr, slw)
+
+    xx, yy, zz = np.array(srcloc).astype('f8')
+    if xx < xarr[0] or xx > xarr[-1]:
+        raise ValueError("xx out of bound.")
+    if yy < yarr[0] or yy > yarr[-1]:
+        raise ValueError("yy out of bound.")
+    if zz < zarr[0] or zz > zarr[-1]:
+        raise ValueError("zz out of bound.")
+
+    rcvs = np.ascontiguousarray(rcvlocs, dtype='f8').reshape(-1, 3)
+    for k, arr, name in zip(range(3), (xarr, yarr, zarr), ('x', 'y', 'z')):
+        if np.any(rcvs[:,k] < arr[0]) or np.any(rcvs[:,k] > arr[-1]):
+            raise ValueError(f"Receiver {name} out of bound.")
+    if rcvs.shape[0] == 0:
+        return np.zeros((0,), dtype=c_interfaces.NPCT_REAL_TYPE), np.zeros(slw.shape, dtype=c_interfaces.NPCT_REAL_TYPE)
+    c_obs = None
+    if rcvTTobs is not None:
+        obs = np.ascontiguousarray(rcvTTobs, dtype=c_interfaces.NPCT_REAL_TYPE).ravel()
+        if obs.size != rcvs.shape[0]:
+            raise ValueError(f"Length of rcvTTobs should be {rcvs.shape[0]}, but {obs.size}.")
+        c_obs = npct.as_ctypes(obs)
+
+    c_xarr = npct.as_ctypes(xarr.astype('f8'))
+    c_yarr = npct.as_ctypes(yarr.astype('f8'))
+    c_zarr = npct.as_ctypes(zarr.astype('f8'))
+    slw_ravel = slw.ravel().astype(c_interfaces.NPCT_REAL_TYPE)
+    c_slw = npct.as_ctypes(slw_ravel)
+
+    TT_ravel = np.zeros((slw.size,), dtype=c_interfaces.NPCT_REAL_TYPE)
+    grad_ravel = np.zeros((slw.size,), dtype=c_interfaces.NPCT_REAL_TYPE)
+    rcvTT = np.zeros((rcvs.shape[0],), dtype=c_interfaces.NPCT_REAL_TYPE)
+
+    c_interfaces.select_c_lib(_layout_npts(slw.shape))
+    c_interfaces.C_FastMarching_adjoint(
+        c_xarr, len(xarr),
+        c_yarr, len(yarr),
+        c_zarr, len(zarr),
+        xx, yy, zz,
+        int(maxodr), c_slw, npct.as_ctypes(TT_ravel), 
+        sphcoord, npct.as_ctypes(rcvs.ravel()), rcvs.shape[0], 
+        c_obs, npct.as_ctypes(rcvTT), npct.as_ctypes(grad_ravel), printbar
+    )
+
+    return rcvTT, grad_ravel.reshape(slw.shape)
+
+
+class FMMState:
+    r'''
+        限定最大走时的Fast Marching Method计算状态，由 :func:`travel_time_source_bounded` 创建。
+        C库中保留网格、慢度场、节点状态和波前，可调用 :meth:`resume` 继续计算到更大的走时
+
+        :ivar        TT:    当前的三维走时场，已确定节点为最终走时，波前面节点为临时走时，未到达的节点为9.9e30
+        :ivar      tmax:    当前已计算到的最大走时，<=0表示全局走时场
+        :ivar    nfront:    当前波前面的节点数，为0时表示全局走时场已计算完成
+    '''
+    def __init__(self, handle:int, TT:np.ndarray, tmax:float, nfront:int):
+        self._handle = handle
+        # 保留创建时的C库版本
+        self._resume = c_interfaces.C_FastMarching_resume
+        self._free = c_interfaces.C_FastMarching_state_free
+        self.TT = TT
+        self.tmax = tmax
+        self.nfront = nfront
+
+    @property
+    def finished(self):
+        r'''
+            全局走时场是否已计算完成
+        '''
+        return self.nfront == 0
+
+    def resume(self, tmax:float=0.0, printbar:bool=False):
+        r'''
+            从上次结束的波前继续计算到更大的走时
+
+            :param       tmax:    最大走时，<=0时计算全局走时场
+            :param   printbar:    是否打印进度条
+
+            :return:   三维走时场，即 :attr:`TT`
+        '''
+        if self._handle is None:
+            raise ValueError("FMMState has been freed.")
+        if self.tmax <= 0.0 or (tmax > 0.0 and tmax < self.tmax):
+            myLogger.warning(f"tmax({tmax}) is not larger than previous one({self.tmax}), nothing to do.")
+            return self.TT
+
+        c_TT = npct.as_ctypes(self.TT.reshape(-1))
+        self.nfront = int(self._resume(self._handle, float(tmax), c_TT, printbar))
+        self.tmax = float(tmax)
+        return self.TT
+
+    def free(self):
+        r'''
+            释放C库中的计算状态，之后不能再继续计算
+        '''
+        if self._handle is not None:
+            self._free(self._handle)
+            self._handle = None
+
+    def __del__(self):
+        self.free()
+
+
+def travel_time_source_bounded(
+    srcloc:list, tmax:float,
+    xarr:np.ndarray, yarr:np.ndarray, zarr:np.ndarray, slw:np.ndarray,
+    maxodr:int=2, sphcoord:bool=False, rfgfac:int=0, rfgn:int=0, printbar:bool=False,
+    FMMqueue:str='heap', FMMbrick:bool=False):
+    r'''
+        给定源点坐标，使用Fast Marching Method只计算走时不超过tmax的节点，
+        之后可调用返回对象的 :meth:`FMMState.resume` 继续计算，不需要重新计算已确定的节点。
+        适用于只需要源点附近一定走时范围内结果的情况
+
+        :param     srcloc:    源点坐标，直角坐标系 :math:`(x,y,z)` 或球坐标系 :math:`(r,\theta,\phi)` 
+        :param       tmax:    最大走时，<=0时计算全局走时场
+        :param       xarr:    :math:`x` 或 :math:`r` 节点坐标数组，要求等距升序排列 
+        :param       yarr:    :math:`y` 或 :math:`\theta` 节点坐标数组，要求等距升序排列 
+        :param       zarr:    :math:`z` 或 :math:`\phi` 节点坐标数组，要求等距升序排列 
+        :param        slw:    形状为(nx, ny, nz)的三维慢度场
+        :param     maxodr:    使用的最大差分阶数, 1 or 2 or 3
+        :param   sphcoord:    是否为球坐标系
+        :param     rfgfac:    对于源点附近的格点间加密倍数，>1
+        :param       rfgn:    对于源点附近的格点间加密处理的辐射半径，>=1
+        :param   printbar:    是否打印进度条
+        :param   FMMqueue:    Fast Marching Method波前优先队列类型，'heap', 'bucket' 或 'dheap'，详见 :func:`travel_time_source` ，
+                              'multi'和'group'按'dheap'处理
+        :param   FMMbrick:    Fast Marching Method内部是否使用分块排布的数组，详见 :func:`travel_time_source`
+
+        :return:   计算状态 :class:`FMMState` ，走时场为其 :attr:`TT` 属性
+    '''
+    check_xyz_arr(xarr, yarr, zarr, sphcoord)
+    check_slowness(xarr, yarr, zarr, slw)
+
+    xx, yy, zz = np.array(srcloc).astype('f8')
+    if xx < xarr[0] or xx > xarr[-1]:
+        raise ValueError("xx out of bound.")
+    if yy < yarr[0] or yy > yarr[-1]:
+        raise ValueError("yy out of bound.")
+    if zz < zarr[0] or zz > zarr[-1]:
+        raise ValueError("zz out of bound.")
+
+    c_xarr = npct.as_ctypes(xarr.astype('f8'))
+    c_yarr = npct.as_ctypes(yarr.astype('f8'))
+    c_zarr = npct.as_ctypes(zarr.astype('f8'))
+    slw_ravel = slw.ravel().astype(c_interfaces.NPCT_REAL_TYPE)
+    c_slw = npct.as_ctypes(slw_ravel)
+
+    TT = np.zeros(slw.shape, dtype=c_interfaces.NPCT_REAL_TYPE)
+    c_TT = npct.as_ctypes(TT.reshape(-1))
+
+    c_interfaces.select_c_lib(_layout_npts(slw.shape, FMMbrick), FMMqueue)
+    c_nfront = c_interfaces.INT(0)
+    handle = c_interfaces.C_FastMarching_bounded(
+        c_xarr, len(xarr),
+        c_yarr, len(yarr),
+        c_zarr, len(zarr),
+        xx, yy, zz,
+        int(maxodr), c_slw, 
+        c_TT, sphcoord,
+        int(rfgfac), int(rfgn), printbar,
+        c_interfaces.get_fmm_queue(FMMqueue), FMMbrick,
+        float(tmax), byref(c_nfront)
+    )
+
+    return FMMState(handle, TT, float(tmax), c_nfront.value)
+
+
+class FMMSolver:
+    r'''
+        可重复使用的走时求解器。创建时在C库中保存网格坐标和慢度场，并申请状态数组、堆等内存，
+        之后对不同源点多次计算时不再重新申请内存、转换数组，也不再检查走时场的非零初始值，
+        适用于同一慢度模型下大量小规模的走时计算
+
+        :param       xarr:    :math:`x` 或 :math:`r` 节点坐标数组，要求等距升序排列 
+        :param       yarr:    :math:`y` 或 :math:`\theta` 节点坐标数组，要求等距升序排列 
+        :param       zarr:    :math:`z` 或 :math:`\phi` 节点坐标数组，要求等距升序排列 
+        :param        slw:    形状为(nx, ny, nz)的三维慢度场
+        :param     maxodr:    使用的最大差分阶数, 1 or 2 or 3
+        :param   sphcoord:    是否为球坐标系
+        :param   FMMqueue:    Fast Marching Method波前优先队列类型，详见 :func:`travel_time_source`
+        :param   FMMbrick:    Fast Marching Method内部是否使用分块排布的数组，详见 :func:`travel_time_source`
+    '''
+    def __init__(
+        self, xarr:np.ndarray, yarr:np.ndarray, zarr:np.ndarray, slw:np.ndarray,
+        maxodr:int=2, sphcoord:bool=False, FMMqueue:str='heap', FMMbrick:bool=False):
+        
+        self._handle = None
+        check_xyz_arr(xarr, yarr, zarr, sphcoord)
+        check_slowness(xarr, yarr, zarr, slw)
+
+        self.xarr = np.array(xarr, dtype='f8')
+        self.yarr = np.array(yarr, dtype='f8')
+        self.zarr = np.array(zarr, dtype='f8')
+        self.shape = slw.shape
+
+        c_interfaces.select_c_lib(_layout_npts(slw.shape, FMMbrick), FMMqueue)
+        # 保留创建时的C库版本
+        self._C = dict(
+            set_slowness=c_interfaces.C_fmm_solver_set_slowness,
+            fmm=c_interfaces.C_fmm_solver_fmm,
+            fsm=c_interfaces.C_fmm_solver_fsm,
+            free=c_interfaces.C_fmm_solver_free)
+
+        slw_ravel = np.ascontiguousarray(slw, dtype=c_interfaces.NPCT_REAL_TYPE).ravel()
+        self._handle = c_interfaces.C_fmm_solver_create(
+            npct.as_ctypes(self.xarr), len(self.xarr),
+            npct.as_ctypes(self.yarr), len(self.yarr),
+            npct.as_ctypes(self.zarr), len(self.zarr),
+            int(maxodr), npct.as_ctypes(slw_ravel), sphcoord,
+            c_interfaces.get_fmm_queue(FMMqueue), FMMbrick)
+
+    def set_slowness(self, slw:np.ndarray):
+        r'''
+            更新慢度场，网格不变
+
+            :param        slw:    形状为(nx, ny, nz)的三维慢度场
+        '''
+        self._check_handle()
+        if slw.shape != self.shape:
+            raise ValueError(f"Shape of slw should be {self.shape}, but {slw.shape}.")
+        slw_ravel = np.ascontiguousarray(slw, dtype=c_interfaces.NPCT_REAL_TYPE).ravel()
+        self._C['set_slowness'](self._handle, npct.as_ctypes(slw_ravel))
+
+    def travel_time_source(
+        self, srcloc:list, rfgfac:int=0, rfgn:int=0, printbar:bool=False,
+        useFSM:bool=False, FSMeps:float=0.0, FSMmaxLoops:int=1, FSMparallel:Union[bool,str]=False,
+        FSMlocking:bool=False, FMMparallel:bool=False, out:Union[np.ndarray,None]=None):
+        r'''
+            给定源点坐标，计算全局走时场，参数含义同 :func:`travel_time_source <pyfmm.traveltime.travel_time_source>`
+
+            :param     srcloc:    源点坐标，直角坐标系 :math:`(x,y,z)` 或球坐标系 :math:`(r,\theta,\phi)` 
+            :param     rfgfac:    对于源点附近的格点间加密倍数，>1
+            :param       rfgn:    对于源点附近的格点间加密处理的辐射半径，>=1
+            :param   printbar:    是否打印进度条
+            :param     useFSM:    是否改用Fast Sweeping Method计算全局走时场
+            :param     FSMeps:    Fast Sweeping Method收敛条件，衡量Sweep后的最大更新量
+            :param  FSMmaxLoops:  Fast Sweeping Method整体迭代次数
+            :param  FSMparallel:  并行Fast Sweeping Method的方式，详见 :func:`travel_time_source <pyfmm.traveltime.travel_time_source>`
+            :param  FSMlocking:   是否使用锁定扫描，详见 :func:`travel_time_source <pyfmm.traveltime.travel_time_source>`
+            :param FMMparallel:   是否使用区域分解的并行Fast Marching Method，分块排布时不使用
+            :param        out:    形状为(nx, ny, nz)的C连续数组，数据类型与C库精度一致，
+                                  若给定则走时场直接写入其中，避免每次申请内存
+
+            :return:   三维走时场
+        '''
+        global FSM_nsweep
+
+        self._check_handle()
+        xx, yy, zz = np.array(srcloc).astype('f8')
+        for v, arr, name in zip((xx, yy, zz), (self.xarr, self.yarr, self.zarr), ('xx', 'yy', 'zz')):
+            if v < arr[0] or v > arr[-1]:
+                raise ValueError(f"{name} out of bound.")
+
+        FSMparallel = c_interfaces.get_fsm_parallel(FSMparallel)
+        if FSMparallel == c_interfaces.FSM_PARALLEL['copies'] and FSMmaxLoops <= 1:
+            myLogger.warning("For parallel FSM, maxLoops must set at least 2 (already changed).")
+            FSMmaxLoops = 2
+
+        TT = _get_batch_out(out, self.shape)
+        c_TT = npct.as_ctypes(TT.reshape(-1))
+        if useFSM:
+            FSM_nsweep = self._C['fsm'](
+                self._handle, xx, yy, zz, c_TT, 
+                int(rfgfac), int(rfgn), printbar, 
+                float(FSMeps), int(FSMmaxLoops), FSMparallel, bool(FSMlocking))
+        else:
+            self._C['fmm'](
+                self._handle, xx, yy, zz, c_TT, 
+                int(rfgfac), int(rfgn), printbar, FMMparallel)
+
+        return TT
+
+    def free(self):
+        r'''
+            释放C库中的求解器，之后不能再计算
+        '''
+        if self._handle is not None:
+            self._C['free'](self._handle)
+            self._handle = None
+
+    def _check_handle(self):
+        if self._handle is None:
+            raise ValueError("FMMSolver has been freed.")
+
+    def __del__(self):
+        self.free()
+
+
+def travel_time_sources(
+    srclocs:np.ndarray, 
+    xarr:np.ndarray, yarr:np.ndarray, zarr:np.ndarray, slw:np.ndarray,
+    maxodr:int=2, sphcoord:bool=False, rfgfac:int=0, rfgn:int=0, printbar:bool=False,
+    FMMqueue:str='heap', FMMbrick:bool=False, nthreads:int=0, out:Union[np.ndarray,None]=None):
+    r'''
+        给定多个源点坐标，使用Fast Marching Method批量计算全局走时场。
+        源点之间在C库中使用OpenMP动态调度并行计算，每个线程的中间数组在其分到的源点间重复使用，
+        适用于同一慢度模型下大量台站的走时计算
+
+        :param    srclocs:    形状为(nsrc, 3)的源点坐标数组，每行含义同 :func:`travel_time_source` 的srcloc
+        :param       xarr:    :math:`x` 或 :math:`r` 节点坐标数组，要求等距升序排列 
+        :param       yarr:    :math:`y` 或 :math:`\theta` 节点坐标数组，要求等距升序排列 
+        :param       zarr:    :math:`z` 或 :math:`\phi` 节点坐标数组，要求等距升序排列 
+        :param        slw:    形状为(nx, ny, nz)的三维慢度场
+        :param     maxodr:    使用的最大差分阶数, 1 or 2 or 3
+        :param   sphcoord:    是否为球坐标系
+        :param     rfgfac:    对于源点附近的格点间加密倍数，>1
+        :param       rfgn:    对于源点附近的格点间加密处理的辐射半径，>=1
+        :param   printbar:    是否打印进度条，按完成的源点个数计
+        :param   FMMqueue:    Fast Marching Method波前优先队列类型，'heap', 'bucket', 'dheap', 'multi' 或 'group'，详见 :func:`travel_time_source`
+        :param   FMMbrick:    Fast Marching Method内部是否使用分块排布的数组，详见 :func:`travel_time_source`
+        :param   nthreads:    线程数，<=0时使用OpenMP当前设置的线程数
+        :param        out:    形状为(nsrc, nx, ny, nz)的C连续数组，数据类型与C库精度一致，
+                              若给定则走时场直接写入其中，避免额外的内存
+
+        :return:   形状为(nsrc, nx, ny, nz)的走时场
+    '''
+    check_xyz_arr(xarr, yarr, zarr, sphcoord)
+    check_slowness(xarr, yarr, zarr, slw)
+
+    srcs = np.ascontiguousarray(srclocs, dtype='f8').reshape(-1, 3)
+    nsrc = srcs.shape[0]
+    for k, arr, name in zip(range(3), (xarr, yarr, zarr), ('xx', 'yy', 'zz')):
+        if np.any(srcs[:,k] < arr[0]) or np.any(srcs[:,k] > arr[-1]):
+            raise ValueError(f"{name} out of bound.")
+        if np.any(srcs[:,k] == arr[0]) or np.any(srcs[:,k] == arr[-1]):
+            myLogger.warning(f"Some sources are on the boundary.")
+
+    TTs = _get_batch_out(out, (nsrc, *slw.shape))
+    TTs[...] = 0.0
+
+    _travel_time_batch(
+        srcs, TTs, xarr, yarr, zarr, slw, 
+        maxodr, sphcoord, rfgfac, rfgn, printbar, FMMqueue, FMMbrick, nthreads)
+
+    return TTs
+
+
+def travel_time_iniTTs(
+    iniTTs:np.ndarray,
+    xarr:np.ndarray, yarr:np.ndarray, zarr:np.ndarray, slw:np.ndarray,
+    maxodr:int=2, sphcoord:bool=False, printbar:bool=False,
+    FMMqueue:str='heap', FMMbrick:bool=False, nthreads:int=0, out:Union[np.ndarray,None]=None):
+    r'''
+        给定多个走时场初始状态，使用Fast Marching Method批量计算全局走时场，
+        并行方式同 :func:`travel_time_sources`
+
+        :param     iniTTs:    形状为(n, nx, ny, nz)的走时场初始状态，每个初始状态含义同 :func:`travel_time_iniTT` 的iniTT
+        :param       xarr:    :math:`x` 或 :math:`r` 节点坐标数组，要求等距升序排列 
+        :param       yarr:    :math:`y` 或 :math:`\theta` 节点坐标数组，要求等距升序排列 
+        :param       zarr:    :math:`z` 或 :math:`\phi` 节点坐标数组，要求等距升序排列 
+        :param        slw:    形状为(nx, ny, nz)的三维慢度场
+        :param     maxodr:    使用的最大差分阶数, 1 or 2 or 3
+        :param   sphcoord:    是否为球坐标系
+        :param   printbar:    是否打印进度条，按完成的走时场个数计
+        :param   FMMqueue:    Fast Marching Method波前优先队列类型，'heap', 'bucket', 'dheap', 'multi' 或 'group'，详见 :func:`travel_time_source`
+        :param   FMMbrick:    Fast Marching Method内部是否使用分块排布的数组，详见 :func:`travel_time_source`
+        :param   nthreads:    线程数，<=0时使用OpenMP当前设置的线程数
+        :param        out:    形状为(n, nx, ny, nz)的C连续数组，数据类型与C库精度一致，
+                              若给定则走时场直接写入其中，可以与iniTTs为同一数组
+
+        :return:   形状为(n, nx, ny, nz)的走时场
+    '''
+    check_xyz_arr(xarr, yarr, zarr, sphcoord)
+    check_slowness(xarr, yarr, zarr, slw)
+
+    iniTTs = np.asarray(iniTTs)
+    if iniTTs.shape[1:] != slw.shape:
+        raise ValueError(f"Shape of iniTTs should be (n, {', '.join(map(str, slw.shape))}), but {iniTTs.shape}.")
+
+    TTs = _get_batch_out(out, iniTTs.shape)
+    if TTs is not iniTTs:
+        TTs[...] = iniTTs
+
+    _travel_time_batch(
+        None, TTs, xarr, yarr, zarr, slw, 
+        maxodr, sphcoord, 0, 0, printbar, FMMqueue, FMMbrick, nthreads)
+
+    return TTs
+
+
+def _get_batch_out(out:Union[np.ndarray,None], shape:tuple):
+    r'''
+        检查或申请批量计算的输出数组
+    '''
+    if out is None:
+        return np.zeros(shape, dtype=c_interfaces.NPCT_REAL_TYPE)
+
+    if not isinstance(out, np.ndarray) or out.shape != shape:
+        raise ValueError(f"out should be an instance of numpy.ndarray with shape {shape}.")
+    if out.dtype != np.dtype(c_interfaces.NPCT_REAL_TYPE) or not out.flags['C_CONTIGUOUS']:
+        raise ValueError(f"out should be C-contiguous with dtype {c_interfaces.NPCT_REAL_TYPE}.")
+    return out
+
+
+def _travel_time_batch(
+    srcs:Union[np.ndarray,None], TTs:np.ndarray,
+    xarr:np.ndarray, yarr:np.ndarray, zarr:np.ndarray, slw:np.ndarray,
+    maxodr:int, sphcoord:bool, rfgfac:int, rfgn:int, printbar:bool, 
+    FMMqueue:str, FMMbrick:bool, nthreads:int):
+    r'''
+        调用C库批量计算走时场，结果写入TTs
+    '''
+    c_xarr = npct.as_ctypes(xarr.astype('f8'))
+    c_yarr = npct.as_ctypes(yarr.astype('f8'))
+    c_zarr = npct.as_ctypes(zarr.astype('f8'))
+    slw_ravel = slw.ravel().astype(c_interfaces.NPCT_REAL_TYPE)
+    c_slw = npct.as_ctypes(slw_ravel)
+    c_srcs = npct.as_ctypes(srcs.ravel()) if srcs is not None else None
+    c_TTs = npct.as_ctypes(TTs.reshape(-1))
+
+    c_interfaces.select_c_lib(_layout_npts(slw.shape, FMMbrick), FMMqueue)
+    c_interfaces.C_FastMarching_batch(
+        c_xarr, len(xarr),
+        c_yarr, len(yarr),
+        c_zarr, len(zarr),
+        c_srcs, TTs.shape[0],
+        int(maxodr), c_slw, 
+        c_TTs, sphcoord,
+        int(rfgfac), int(rfgn), printbar, 
+        c_interfaces.get_fmm_queue(FMMqueue), FMMbrick, 
+        int(nthreads)
+    )
+
+
 def raytracing(
     TT:np.ndarray, srcloc:list, rcvloc:list,
     xarr:np.ndarray, yarr:np.ndarray, zarr:np.ndarray,
@@ -241,6 +919,7 @@ def raytracing(
 
     rays = np.empty((maxdots*3,), dtype='f8')
     c_rays = npct.as_ctypes(rays)
+    c_interfaces.select_c_lib(TT.size)
     c_ndots = c_interfaces.INT(maxdots)
 
     travt = c_interfaces.C_FMM_raytracing(
@@ -261,6 +940,87 @@ def raytracing(
     return travt, rays.reshape((-1,3))[:c_ndots.value, ]
 
 
+def raytracing_batch(
+    TT:np.ndarray, srcloc:list, rcvlocs:np.ndarray,
+    xarr:np.ndarray, yarr:np.ndarray, zarr:np.ndarray,
+    seglen:float, slw:Union[np.ndarray, None] = None, segfac:int=3, sphcoord:bool=False, 
+    maxdots:int=100000, nthreads:int=0):
+    r'''
+        根据给定源点坐标计算的走时场，对多个接收点并行做射线追踪，方法同 :func:`raytracing` 。
+        走时场和慢度场只转换一次，射线点数组在C库中按需扩容，
+        所有射线按接收点顺序拼接为一个数组，第i条射线为 ``rays[offsets[i]:offsets[i+1]]`` 
+
+        :param         TT:    走时场
+        :param     srcloc:    源点坐标，直角坐标系 :math:`(x,y,z)` 或球坐标系 :math:`(r,\theta,\phi)` 
+        :param    rcvlocs:    形状为(nrcv, 3)的接收点坐标数组
+        :param       xarr:    :math:`x` 或 :math:`r` 节点坐标数组，要求等距升序排列 
+        :param       yarr:    :math:`y` 或 :math:`\theta` 节点坐标数组，要求等距升序排列 
+        :param       zarr:    :math:`z` 或 :math:`\phi` 节点坐标数组，要求等距升序排列 
+        :param     seglen:    射线段长度，与xyz的长度量纲保持一致
+        :param        slw:    形状为(nx, ny, nz)的三维慢度场，若非None则使用累加求和计算走时，否则直接从走时场中插值得到走时
+        :param     segfac:    t < segfac*seglen/v，当射线追踪到在源点附近时，射线直接连接源点
+        :param   sphcoord:    是否使用球坐标
+        :param    maxdots:    每条射线的最大点数，超过时截断并直接连接源点
+        :param   nthreads:    线程数，<=0时使用OpenMP当前设置的线程数
+
+        :return:   
+            - **travt** -    形状为(nrcv,)的射线走时，射线为空时为9.9e30
+            - **status** -   形状为(nrcv,)的射线状态，含义见 :data:`pyfmm.c_interfaces.FMM_RAY_STATUS`
+            - **offsets** -  形状为(nrcv+1,)的各射线起始位置
+            - **rays** -     形状为(ndots, 3)的射线坐标
+    '''
+
+    if isinstance(slw, np.ndarray):
+        check_slowness(xarr, yarr, zarr, slw)
+
+    sx, sy, sz = np.array(srcloc).astype('f8')
+    if sx < xarr[0] or sx > xarr[-1] or \
+       sy < yarr[0] or sy > yarr[-1] or \
+       sz < zarr[0] or sz > zarr[-1]:
+        raise ValueError(f"Source ({str(srcloc)}) is out of bound.")
+
+    rcvs = np.ascontiguousarray(rcvlocs, dtype='f8').reshape(-1, 3)
+    nrcv = rcvs.shape[0]
+
+    # 类型已匹配时不复制
+    TT_ravel = np.ascontiguousarray(TT, dtype=c_interfaces.NPCT_REAL_TYPE).ravel()
+    c_slw = None 
+    if slw is not None:
+        slw_ravel = np.ascontiguousarray(slw, dtype=c_interfaces.NPCT_REAL_TYPE).ravel()
+        c_slw = npct.as_ctypes(slw_ravel)
+
+    c_xarr = npct.as_ctypes(xarr.astype('f8'))
+    c_yarr = npct.as_ctypes(yarr.astype('f8'))
+    c_zarr = npct.as_ctypes(zarr.astype('f8'))
+
+    c_interfaces.select_c_lib(TT.size)
+    travt = np.zeros((nrcv,), dtype=c_interfaces.NPCT_REAL_TYPE)
+    status = np.zeros((nrcv,), dtype=npct.as_ctypes_type(c_interfaces.INT))
+    offsets = np.zeros((nrcv+1,), dtype=npct.as_ctypes_type(c_interfaces.INT))
+    if nrcv == 0:
+        return travt, status, offsets, np.zeros((0, 3), dtype='f8')
+    c_rays = c_interfaces.PDOUBLE()
+
+    ndots = c_interfaces.C_FMM_raytracing_batch(
+        c_xarr, len(xarr),
+        c_yarr, len(yarr),
+        c_zarr, len(zarr),
+        sx, sy, sz,
+        npct.as_ctypes(rcvs.ravel()), nrcv, float(seglen), float(segfac),
+        c_slw, npct.as_ctypes(TT_ravel), sphcoord, int(maxdots), int(nthreads),
+        npct.as_ctypes(travt), npct.as_ctypes(status), npct.as_ctypes(offsets), byref(c_rays)
+    )
+    rays = npct.as_array(c_rays, shape=(max(ndots, 1)*3,))[:ndots*3].copy()
+    c_interfaces.C_FMM_rays_free(c_rays)
+
+    ntrunc = np.count_nonzero(status == c_interfaces.FMM_RAY_STATUS['truncated'])
+    if ntrunc > 0:
+        myLogger.warning(f"{ntrunc} rays exceed {maxdots} dots, and have been truncated. "
+                          "You may need to set larger seglen or set more maxdots.")
+
+    return travt, status, offsets, rays.reshape((-1,3))
+
+
 
 def get_traveltime(
     TT:np.ndarray, rcvloc:list,
@@ -281,6 +1041,94 @@ def get_traveltime(
     return float(interpolate.interpn((xarr, yarr, zarr), TT, np.array(rcvloc)))
 
 
+def get_traveltime_gradient(
+    TT:np.ndarray, xarr:np.ndarray, yarr:np.ndarray, zarr:np.ndarray,
+    maxodr:int=2, sphcoord:bool=False):
+    r'''
+        由走时场重建各节点的迎风差分模板(与求解时 ``get_neighbour_travt`` 的选取规则相同)，得到走时梯度场。
+        梯度与走时场满足同一离散程函方程，适用于FMM、FSM和FIM的结果，只需遍历一次网格
+
+        :param         TT:    走时场
+        :param       xarr:    :math:`x` 或 :math:`r` 节点坐标数组，要求等距升序排列 
+        :param       yarr:    :math:`y` 或 :math:`\theta` 节点坐标数组，要求等距升序排列 
+        :param       zarr:    :math:`z` 或 :math:`\phi` 节点坐标数组，要求等距升序排列 
+        :param     maxodr:    使用的最大差分阶数, 1 or 2 or 3，应与计算走时场时相同
+        :param   sphcoord:    是否为球坐标系
+
+        :return:   形状为(nx, ny, nz, 3)的梯度场，球坐标系下为 
+                   :math:`(\partial_r T, \frac{1}{r}\partial_\theta T, \frac{1}{r\sin\theta}\partial_\phi T)` ，
+                   未到达的节点为0
+    '''
+    check_xyz_arr(xarr, yarr, zarr, sphcoord)
+    shape = (len(xarr), len(yarr), len(zarr))
+    if TT.shape != shape:
+        raise ValueError(f"Shape of TT should be {shape}, but {TT.shape}.")
+
+    c_xarr = npct.as_ctypes(xarr.astype('f8'))
+    c_yarr = npct.as_ctypes(yarr.astype('f8'))
+    c_zarr = npct.as_ctypes(zarr.astype('f8'))
+    TT_ravel = np.ascontiguousarray(TT, dtype=c_interfaces.NPCT_REAL_TYPE).ravel()
+    gT = np.zeros((3, TT.size), dtype=c_interfaces.NPCT_REAL_TYPE)
+
+    c_interfaces.select_c_lib(_layout_npts(shape))
+    c_interfaces.C_traveltime_gradient(
+        c_xarr, len(xarr),
+        c_yarr, len(yarr),
+        c_zarr, len(zarr),
+        int(maxodr), npct.as_ctypes(TT_ravel), sphcoord, 
+        npct.as_ctypes(gT[0]), npct.as_ctypes(gT[1]), npct.as_ctypes(gT[2])
+    )
+
+    return np.moveaxis(gT.reshape((3,)+shape), 0, -1)
+
+
+def get_takeoff_angles(
+    TT:np.ndarray, srclocs:np.ndarray,
+    xarr:np.ndarray, yarr:np.ndarray, zarr:np.ndarray,
+    maxodr:int=2, sphcoord:bool=False, gradT:Union[np.ndarray,None]=None):
+    r'''
+        根据互易性计算震源处的射线出射角。TT为以接收点为源点计算的走时场，
+        从震源出发到达该接收点的射线在震源处沿 :math:`-\nabla T` 方向出射，
+        梯度由 :func:`get_traveltime_gradient` 得到，再线性插值到震源位置。
+        对每个台站计算一次走时场，即可得到所有震源到该台站的出射角
+
+        直角坐标系下将 :math:`(x,y,z)` 视为(北, 东, 向下)，球坐标系下使用震源处的局部(北, 东, 向下)方向，
+        方位角从北顺时针量起，取值[0, 360)；入射角(离源角)从竖直向下量起，取值[0, 180]，单位均为度
+
+        :param         TT:    以接收点为源点计算的走时场
+        :param    srclocs:    形状为(nsrc, 3)的震源坐标数组
+        :param       xarr:    :math:`x` 或 :math:`r` 节点坐标数组，要求等距升序排列 
+        :param       yarr:    :math:`y` 或 :math:`\theta` 节点坐标数组，要求等距升序排列 
+        :param       zarr:    :math:`z` 或 :math:`\phi` 节点坐标数组，要求等距升序排列 
+        :param     maxodr:    使用的最大差分阶数, 1 or 2 or 3，应与计算走时场时相同
+        :param   sphcoord:    是否为球坐标系
+        :param      gradT:    已计算的梯度场，为None时由TT计算
+
+        :return:   
+            - **azimuth** -    形状为(nsrc,)的方位角
+            - **incidence** -  形状为(nsrc,)的入射角
+    '''
+    if gradT is None:
+        gradT = get_traveltime_gradient(TT, xarr, yarr, zarr, maxodr, sphcoord)
+
+    locs = np.asarray(srclocs, dtype='f8').reshape(-1, 3)
+    g = interpolate.interpn((xarr, yarr, zarr), gradT, locs)
+    norm = np.linalg.norm(g, axis=1)
+    norm[norm == 0.0] = 1.0
+    d = -g / norm[:, None]
+
+    # (北, 东, 向下)分量
+    if sphcoord:
+        dn, de, dd = -d[:,1], d[:,2], -d[:,0]
+    else:
+        dn, de, dd = d[:,0], d[:,1], d[:,2]
+
+    azimuth = np.rad2deg(np.arctan2(de, dn)) % 360.0
+    incidence = np.rad2deg(np.arccos(np.clip(dd, -1.0, 1.0)))
+
+    return azimuth, incidence
+
+
 def check_xyz_arr(
     xarr:np.ndarray, yarr:np.ndarray, zarr:np.ndarray, sphcoord:bool):
     r'''
@@ -338,4 +1186,18 @@ def check_slowness(xarr:np.ndarray, yarr:np.ndarray, zarr:np.ndarray, slw:np.nda
     shapexyz = (len(xarr), len(yarr), len(zarr))
     if slw.shape != shapexyz:
         raise ValueError(f"Shape of slowness should be {shapexyz}, but {slw.shape}.")
-    
\ No newline at end of file
+    
+
+def _layout_npts(shape:tuple, brick:bool=False):
+    r'''
+        计算C库中走时等数组的长度。内部数组四周各有一层幽灵节点，
+        分块排布时各维度再补齐到块边长的整数倍，长度不足一个块边长的维度不分块，
+        与C库 grid_layout_init 一致
+    '''
+    npts = 1
+    for n in shape:
+        n += 2
+        if brick and n >= 4:
+            n = (n + 3) // 4 * 4
+        npts *= n
+    return npts